@@ -60,7 +60,11 @@
 #include "nct_nfs.h"
 #include "nct_getattr.h"
 #include "nct_read.h"
+#include "nct_write.h"
 #include "nct_null.h"
+#include "nct_pace.h"
+#include "nct_win.h"
+#include "nct_sweep.h"
 
 char version[] = NCT_VERSION;
 char *progname;
@@ -69,33 +73,49 @@ int verbosity;
 FILE *dprint_fp;
 FILE *eprint_fp;
 
+unsigned int conns_max = 1;
 unsigned int jobs_max = 1;
 unsigned int tds_max = 1;
+unsigned int reqs_max = 0;
 in_port_t port = 2049;
 char *term = "png";         // Term type for gnuplot
 char *outdir = NULL;
 time_t duration = 60;
 char *command = NULL;
+char *engine = "threads";
 char *args = NULL;
 u_int mark = 0;
+bool sendq = false;
+bool zerocopy = false;
+char *rate = NULL;
+char *arrival = "const";
+u_int slo = 0;
 
 bool have_tsc __read_mostly;
 uint64_t tsc_freq __read_mostly;
 
 static struct clp_posparam posparamv[] = {
-    CLP_POSPARAM("command", string, command, NULL, NULL, "command to run [getattr,read,shell]"),
+    CLP_POSPARAM("command", string, command, NULL, NULL, "command to run [getattr,read,write,null,shell,sweep]"),
     CLP_POSPARAM("[args...]", string, args, NULL, NULL, "command arguments"),
     CLP_POSPARAM_END
 };
 
 static struct clp_option optionv[] = {
+    CLP_OPTION('a', string, arrival, NULL, "open-loop arrival process [const,poisson]"),
+    CLP_OPTION('c', u_int, conns_max, NULL, "number of connections to the NFS server"),
     CLP_OPTION('d', time_t, duration, NULL, "duration of the test (in seconds)"),
+    CLP_OPTION('e', string, engine, NULL, "reply engine [threads,epoll,uring]"),
     CLP_OPTION('j', u_int, jobs_max, NULL, "max number of NFS request threads"),
+    CLP_OPTION('L', u_int, slo, "r", "adapt the number of active jobs to keep p99 latency under slo usecs"),
     CLP_OPTION('m', u_int, mark, NULL, "print status every mark seconds"),
     CLP_OPTION('o', string, outdir, NULL, "directory in which to store results"),
     CLP_OPTION('p', uint16_t, port, NULL, "remote NFSd port"),
+    CLP_OPTION('r', string, rate, "L", "open-loop request rate (rate, lo:hi ramp, or r1,r2,... steps)"),
+    CLP_OPTION('R', u_int, reqs_max, NULL, "max number of NFS requests (grows on demand)"),
+    CLP_OPTION('S', bool, sendq, NULL, "send requests via a sender thread per connection"),
     CLP_OPTION('T', string, term, NULL, "terminal type for gnuplot"),
-    CLP_OPTION('t', u_int, tds_max, NULL, "max number of NFS reply threads"),
+    CLP_OPTION('t', u_int, tds_max, NULL, "max number of NFS reply threads per connection"),
+    CLP_OPTION('Z', bool, zerocopy, NULL, "send write payloads with MSG_ZEROCOPY"),
 
     CLP_OPTION_VERBOSITY(verbosity),
     CLP_OPTION_VERSION(version),
@@ -109,6 +129,36 @@ given(int c)
     return !!clp_given(c, optionv, NULL);
 }
 
+static struct {
+    const char     *name;
+    test_init_t    *init;
+    test_fini_t    *fini;
+} testv[] = {
+    { "getattr",    test_getattr_init,  test_getattr_fini },
+    { "read",       test_read_init,     test_read_fini },
+    { "write",      test_write_init,    test_write_fini },
+    { "null",       test_null_init,     test_null_fini },
+    { NULL,         NULL,               NULL }
+};
+
+/* Return the init function of the named test (or NULL if there's no
+ * such test), and its fini function via finip.
+ */
+test_init_t *
+test_lookup(const char *name, test_fini_t **finip)
+{
+    int i;
+
+    for (i = 0; testv[i].name; ++i) {
+        if (0 == strcmp(name, testv[i].name)) {
+            *finip = testv[i].fini;
+            return testv[i].init;
+        }
+    }
+
+    return NULL;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -217,33 +267,67 @@ main(int argc, char **argv)
     }
 
     char *rhostpath = NULL;
+    test_init_t *test_init;
+    test_fini_t *test_fini;
     start_t *start;
     nct_mnt_t *mnt;
     nct_req_t *req;
+    size_t msgsz = 0;
+    u_int flags = 0;
     void *priv;
 
-    if (0 == strcmp("getattr", argv[0])) {
-        priv = test_getattr_init(argc, argv, duration, &start, &rhostpath);
+    if (0 == strcmp("epoll", engine)) {
+        flags |= NCT_MNT_EPOLL;
     }
-    else if (0 == strcmp("read", argv[0])) {
-        priv = test_read_init(argc, argv, duration, &start, &rhostpath);
+    else if (0 == strcmp("uring", engine)) {
+        flags |= NCT_MNT_URING;
     }
-    else if (0 == strcmp("null", argv[0])) {
-        priv = test_null_init(argc, argv, duration, &start, &rhostpath);
+    else if (0 != strcmp("threads", engine)) {
+        eprint("invalid engine [%s], use -h for help\n", engine);
+        exit(EX_USAGE);
     }
-    else if (0 == strcmp("shell", argv[0])) {
+
+    if (sendq)
+        flags |= NCT_MNT_SENDQ;
+
+    if (zerocopy)
+        flags |= NCT_MNT_ZEROCOPY;
+
+    if (0 == strcmp("shell", argv[0])) {
         return nct_shell(argc, argv);
     }
-    else {
+    else if (0 == strcmp("sweep", argv[0])) {
+        if (rate || slo) {
+            eprint("-r and -L do not apply to sweep, which runs closed-loop\n");
+            exit(EX_USAGE);
+        }
+
+        nct_sweep_parms_t parms = {
+            .sp_port = port,
+            .sp_flags = flags,
+            .sp_reqs_max = reqs_max,
+            .sp_jobs = jobs_max,
+            .sp_tds = tds_max,
+            .sp_conns = conns_max,
+            .sp_duration = duration,
+        };
+
+        return nct_sweep(argc, argv, &parms);
+    }
+
+    test_init = test_lookup(argv[0], &test_fini);
+    if (!test_init) {
         eprint("invalid command [%s], use -h for help\n", argv[0]);
         exit(EX_USAGE);
     }
 
+    priv = test_init(argc, argv, duration, &start, &rhostpath, &msgsz);
+
     if (!priv || !start || !rhostpath) {
         abort();
     }
 
-    mnt = nct_mount(rhostpath, port, tds_max, jobs_max);
+    mnt = nct_mount(rhostpath, port, conns_max, tds_max, jobs_max, reqs_max, msgsz, flags);
     if (!mnt) {
         eprint("mount %s failed\n", rhostpath);
         abort();
@@ -262,11 +346,26 @@ main(int argc, char **argv)
             abort();
     }
 
+    /* In open-loop mode the jobs merely encode their requests, which
+     * the pacer then sends at the arrival times of the schedule.
+     */
+    if (rate) {
+        mnt->mnt_pace = nct_pace_create(mnt, rate, arrival, duration);
+        if (!mnt->mnt_pace)
+            exit(EX_USAGE);
+    }
+
+    if (slo > 0)
+        mnt->mnt_win = nct_win_create(mnt, slo, jobs_max, duration);
+
     for (i = 0; i < jobs_max; ++i) {
         __atomic_add_fetch(&mnt->mnt_jobs_cnt, 1, __ATOMIC_SEQ_CST);
 
         req = nct_req_alloc(mnt);
         req->req_priv = priv;
+        req->req_job = i;
+        req->req_jobs = jobs_max;
+        req->req_vn = mnt->mnt_vnv[i % mnt->mnt_vnc];
         req->req_argc = argc;
         req->req_argv = argv;
 
@@ -276,7 +375,14 @@ main(int argc, char **argv)
     nct_stats_loop(mnt, mark, sample_period, duration,
                    statsv, statsc, outdir, term);
 
+    nct_pace_destroy(mnt->mnt_pace);
+    mnt->mnt_pace = NULL;
+
+    nct_win_destroy(mnt->mnt_win);
+    mnt->mnt_win = NULL;
+
     nct_umount(mnt);
+    test_fini(priv);
 
     free(statsv);
 
@@ -23,6 +23,21 @@
 struct nct_req;
 typedef int start_t(struct nct_req *req);
 
+/* Each test has an init function that parses the test's arguments and
+ * returns the private data of its jobs, along with the function that
+ * starts a job, the [user@]rhost:path to mount, and the size of the
+ * message buffers required by the test (zero for the default).
+ */
+typedef void *test_init_t(int argc, char **argv, int duration, start_t **startp,
+                          char **rhostpathp, size_t *msgszp);
+
+/* Each test also has a fini function that releases the private data
+ * returned by its init function once all of its jobs have exited.
+ */
+typedef void test_fini_t(void *priv);
+
+extern test_init_t *test_lookup(const char *name, test_fini_t **finip);
+
 /* The command line parser set the following global variables:
  */
 extern char version[];
@@ -54,6 +54,8 @@
 #include "main.h"
 #include "nct.h"
 #include "nct_nfs.h"
+#include "nct_pace.h"
+#include "nct_win.h"
 
 static void
 nct_gplot(long nsamples, long sampersec, const char *term, const char *using,
@@ -148,6 +150,105 @@ nct_gplot(long nsamples, long sampersec, const char *term, const char *using,
     pclose(fp);
 }
 
+/* Per-procedure state of nct_stats_loop(), created for each procedure
+ * that completes a request during the run.  The histograms are those
+ * of the procedure as of the latest sample, the previous sample, the
+ * previous mark, and the start of the run.
+ */
+#define NCT_PS_CUR          (0)
+#define NCT_PS_SAMPLE       (1)
+#define NCT_PS_MARK         (2)
+#define NCT_PS_BASE         (3)
+
+typedef struct {
+    nct_hist_t          ps_histv[4];
+    struct nct_stats    ps_mark;            // Counters as of the previous mark
+    nct_statsrec_t     *ps_statsv;          // Samples (parallel to statsv)
+} nct_procstats_t;
+
+static nct_procstats_t *
+nct_procstats_create(const nct_hist_t *base, u_int statsc)
+{
+    nct_procstats_t *ps;
+
+    ps = calloc(1, sizeof(*ps));
+    if (!ps)
+        abort();
+
+    if (base)
+        ps->ps_histv[NCT_PS_BASE] = *base;
+
+    ps->ps_histv[NCT_PS_SAMPLE] = ps->ps_histv[NCT_PS_BASE];
+    ps->ps_histv[NCT_PS_MARK] = ps->ps_histv[NCT_PS_BASE];
+
+    if (statsc > 0) {
+        ps->ps_statsv = calloc(statsc, sizeof(*ps->ps_statsv));
+        if (!ps->ps_statsv)
+            abort();
+    }
+
+    return ps;
+}
+
+/* Write the samples of the given procedure to file raw-<proc>, and its
+ * latency histogram for the whole run to file latency-<proc>.hist.
+ */
+static void
+nct_procstats_write(nct_procstats_t *ps, const char *name,
+                    const nct_statsrec_t *statsv, long nsamples)
+{
+    const nct_statsrec_t *cur, *prev;
+    char file[128];
+    FILE *fp;
+    long i;
+
+    snprintf(file, sizeof(file), "latency-%s.hist", name);
+
+    fp = fopen(file, "w");
+    if (fp) {
+        nct_hist_dump(fp, ps->ps_histv + NCT_PS_CUR, ps->ps_histv + NCT_PS_BASE);
+        fclose(fp);
+    }
+
+    if (!ps->ps_statsv)
+        return;
+
+    snprintf(file, sizeof(file), "raw-%s", name);
+
+    fp = fopen(file, "w");
+    if (!fp) {
+        eprint("unable to open [%s]: %s\n", file, strerror(errno));
+        return;
+    }
+
+    fprintf(fp, "# %s requests\n", name);
+    fprintf(fp, "# time, duration, and latency in usecs\n");
+    fprintf(fp, "# send and recv in bytes\n");
+    fprintf(fp, "#\n");
+    fprintf(fp, "# %8s %10s %10s %8s %8s %10s %10s %8s %8s %8s\n",
+            "SAMPLE", "TIME", "DURATION", "LATENCY",
+            "OPS", "SEND", "RECV", "P50", "P99", "P999");
+
+    for (i = 1; i < nsamples; ++i) {
+        cur = ps->ps_statsv + i;
+        prev = cur - 1;
+
+        fprintf(fp, "  %8u %10lu %10lu %8lu %8lu %10lu %10lu %8lu %8lu %8lu\n",
+                statsv[i].xsr_sample,
+                (statsv[i].xsr_time * 1000000ul) / tsc_freq,
+                ((statsv[i].xsr_time - statsv[i - 1].xsr_time) * 1000000ul) / tsc_freq,
+                ((cur->xsr_latency - prev->xsr_latency) * 1000000ul) / tsc_freq,
+                cur->xsr_requests - prev->xsr_requests,
+                cur->xsr_throughput_send - prev->xsr_throughput_send,
+                cur->xsr_throughput_recv - prev->xsr_throughput_recv,
+                (cur->xsr_latency_p50 * 1000000ul) / tsc_freq,
+                (cur->xsr_latency_p99 * 1000000ul) / tsc_freq,
+                (cur->xsr_latency_p999 * 1000000ul) / tsc_freq);
+    }
+
+    fclose(fp);
+}
+
 /* Collect samples of throughput data (every 100ms).
  * Print a throughput data sample to stdout (every 1s).
  * Terminates once all worker count for the mnt object
@@ -165,10 +266,16 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
     uint64_t latency_cur, latency_prev;
     uint64_t tsc_cur, tsc_last, tsc_interval;
     nct_statsrec_t *cur, *prev, *end;
+    nct_hist_t *hist_cur, *hist_sample, *hist_mark, *hist_base;
+    struct nct_stats procstatsv[NCT_PROC_MAX];
+    nct_procstats_t *procv[NCT_PROC_MAX];
+    nct_pace_t *pace = mnt->mnt_pace;
+    nct_win_t *win = mnt->mnt_win;
     uint64_t reqs_cur, reqs_last;
     uint64_t tsc_start;
     long samples_tot;
     long loops;
+    int i;
 
     const long samples_per_sec = 1000000 / sample_period_usec;
     long print_period = mark * tsc_freq;
@@ -183,6 +290,31 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
 
     cur = end = NULL;
 
+    /* Latency percentiles are computed from the difference between the
+     * merged histograms of the recv threads at the start and end of
+     * each sample period, mark period, and of the whole run.
+     */
+    hist_cur = malloc(sizeof(*hist_cur) * 4);
+    if (!hist_cur)
+        abort();
+
+    hist_sample = hist_cur + 1;
+    hist_mark = hist_cur + 2;
+    hist_base = hist_cur + 3;
+
+    nct_mnt_hist(mnt, -1, hist_base);
+    *hist_sample = *hist_base;
+    *hist_mark = *hist_base;
+
+    /* Procedures that have already completed requests (e.g., those
+     * made by nct_mount()) need the baseline of their histograms.
+     */
+    for (i = 0; i < NCT_PROC_MAX; ++i) {
+        procv[i] = NULL;
+        if (nct_mnt_hist(mnt, i, hist_cur))
+            procv[i] = nct_procstats_create(hist_cur, statsv ? statsc : 0);
+    }
+
     if (statsv && statsc > 0) {
         bzero(statsv, sizeof(*statsv));
         end = statsv + duration * samples_per_sec;
@@ -199,8 +331,11 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
 
     while (1) {
         char lat_min_buf[32], lat_max_buf[32], lat_avg_buf[32];
+        char lat_p50_buf[32], lat_p99_buf[32], lat_p999_buf[32];
         uint64_t latency_min, latency_max;
+        struct nct_stats stats;
         long tgt, delta;
+        int nprocs;
 
         ++samples_tot;
 
@@ -216,18 +351,52 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
 
         tsc_cur = rdtsc();
 
-        pthread_spin_lock(&mnt->mnt_stats_spin);
-        latency_min = mnt->mnt_stats.latency_min;
-        latency_max = mnt->mnt_stats.latency_max;
+        nct_mnt_stats(mnt, &stats, true);
+        nct_mnt_proc_stats(mnt, procstatsv);
+        nct_mnt_hist(mnt, -1, hist_cur);
+
+        if (win)
+            nct_win_update(win, hist_cur);
 
-        mnt->mnt_stats.latency_min = UINT64_MAX;
-        mnt->mnt_stats.latency_max = 0;
+        for (i = nprocs = 0; i < NCT_PROC_MAX; ++i) {
+            nct_procstats_t *ps = procv[i];
 
-        latency_cur = mnt->mnt_stats.latency_cum;
-        reqs_cur = mnt->mnt_stats.requests;
-        throughput_send_cur = mnt->mnt_stats.thruput_send;
-        throughput_recv_cur = mnt->mnt_stats.thruput_recv;
-        pthread_spin_unlock(&mnt->mnt_stats_spin);
+            if (!ps) {
+                if (procstatsv[i].requests == 0)
+                    continue;
+
+                ps = procv[i] = nct_procstats_create(NULL, statsv ? statsc : 0);
+            }
+
+            nct_mnt_hist(mnt, i, ps->ps_histv + NCT_PS_CUR);
+
+            if (cur && ps->ps_statsv) {
+                nct_statsrec_t *rec = ps->ps_statsv + (cur - statsv);
+
+                rec->xsr_requests = procstatsv[i].requests;
+                rec->xsr_throughput_send = procstatsv[i].thruput_send;
+                rec->xsr_throughput_recv = procstatsv[i].thruput_recv;
+                rec->xsr_latency = procstatsv[i].latency_cum;
+                rec->xsr_latency_p50 = nct_hist_pct(ps->ps_histv + NCT_PS_CUR,
+                                                    ps->ps_histv + NCT_PS_SAMPLE, 50);
+                rec->xsr_latency_p99 = nct_hist_pct(ps->ps_histv + NCT_PS_CUR,
+                                                    ps->ps_histv + NCT_PS_SAMPLE, 99);
+                rec->xsr_latency_p999 = nct_hist_pct(ps->ps_histv + NCT_PS_CUR,
+                                                     ps->ps_histv + NCT_PS_SAMPLE, 99.9);
+            }
+
+            ps->ps_histv[NCT_PS_SAMPLE] = ps->ps_histv[NCT_PS_CUR];
+
+            if (procstatsv[i].requests > 0)
+                ++nprocs;
+        }
+
+        latency_min = stats.latency_min;
+        latency_max = stats.latency_max;
+        latency_cur = stats.latency_cum;
+        reqs_cur = stats.requests;
+        throughput_send_cur = stats.thruput_send;
+        throughput_recv_cur = stats.thruput_recv;
 
         if (cur) {
             cur->xsr_time = tsc_cur;
@@ -236,11 +405,18 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
             cur->xsr_throughput_send = throughput_send_cur;
             cur->xsr_throughput_recv = throughput_recv_cur;
             cur->xsr_latency = latency_cur;
+            cur->xsr_latency_p50 = nct_hist_pct(hist_cur, hist_sample, 50);
+            cur->xsr_latency_p99 = nct_hist_pct(hist_cur, hist_sample, 99);
+            cur->xsr_latency_p999 = nct_hist_pct(hist_cur, hist_sample, 99.9);
+            cur->xsr_backlog = pace ? __atomic_load_n(&pace->pace_backlog, __ATOMIC_RELAXED) : 0;
+            cur->xsr_window = win ? win->win_size : 0;
 
             if (++cur >= end)
                 cur = NULL;
         }
 
+        *hist_sample = *hist_cur;
+
         if (!mark) {
             if (__atomic_load_n(&mnt->mnt_jobs_cnt, __ATOMIC_SEQ_CST) < 1)
                 break;
@@ -264,6 +440,13 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
             snprintf(lat_avg_buf, sizeof(lat_avg_buf), "%6.1lf",
                      (lat * 1000000.0) / (tsc_cur - tsc_last));
 
+            snprintf(lat_p50_buf, sizeof(lat_p50_buf), "%6.1lf",
+                     (nct_hist_pct(hist_cur, hist_mark, 50) * 1000000.0) / tsc_freq);
+            snprintf(lat_p99_buf, sizeof(lat_p99_buf), "%6.1lf",
+                     (nct_hist_pct(hist_cur, hist_mark, 99) * 1000000.0) / tsc_freq);
+            snprintf(lat_p999_buf, sizeof(lat_p999_buf), "%6.1lf",
+                     (nct_hist_pct(hist_cur, hist_mark, 99.9) * 1000000.0) / tsc_freq);
+
             throughput_send_avg = throughput_send_cur - throughput_send_last;
             throughput_send_avg /= 1024 * 1024;
             throughput_recv_avg = throughput_recv_cur - throughput_recv_last;
@@ -274,20 +457,72 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
             }
 
             snprintf(lat_avg_buf, sizeof(lat_avg_buf), "%10s", "stalled");
+            snprintf(lat_p50_buf, sizeof(lat_p50_buf), "%7s", "-");
+            snprintf(lat_p99_buf, sizeof(lat_p99_buf), "%7s", "-");
+            snprintf(lat_p999_buf, sizeof(lat_p999_buf), "%7s", "-");
             throughput_send_avg = 0;
             throughput_recv_avg = 0;
         }
 
         if ((loops++ % 22) == 0) {
-            printf("\n%8s %9s %8s %7s %7s %7s %7s %7s\n",
+            printf("\n%8s %9s %8s %7s %7s %7s %7s %7s %7s %7s %7s",
                    "SAMPLES", "DURATION", "OPS", "TXMB", "RXMB",
-                   "LATMIN", "LATAVG", "LATMAX");
+                   "LATMIN", "LATAVG", "LATMAX", "LATP50", "LATP99", "LATP999");
+            if (pace)
+                printf(" %7s", "BACKLOG");
+            if (win)
+                printf(" %7s", "WINDOW");
+            printf("\n");
         }
 
-        printf("%8ld %9lu %8lu %7.2lf %7.2lf %7s %7s %7s\n",
+        printf("%8ld %9lu %8lu %7.2lf %7.2lf %7s %7s %7s %7s %7s %7s",
                samples_tot, tsc_interval, reqs_cur - reqs_last,
                throughput_send_avg, throughput_recv_avg,
-               lat_min_buf, lat_avg_buf, lat_max_buf);
+               lat_min_buf, lat_avg_buf, lat_max_buf,
+               lat_p50_buf, lat_p99_buf, lat_p999_buf);
+
+        /* In open-loop mode a nonzero backlog means that all the requests
+         * were in flight when their arrivals came due.
+         */
+        if (pace)
+            printf(" %7lu", __atomic_load_n(&pace->pace_backlog, __ATOMIC_RELAXED));
+        if (win)
+            printf(" %7u", win->win_size);
+        printf("\n");
+
+        /* Break the interval down by procedure if the workload is mixed.
+         */
+        for (i = 0; i < NCT_PROC_MAX; ++i) {
+            nct_procstats_t *ps = procv[i];
+            struct nct_stats *cs = procstatsv + i;
+            nct_hist_t *hcur, *hmark;
+            uint64_t reqs;
+
+            if (!ps)
+                continue;
+
+            hcur = ps->ps_histv + NCT_PS_CUR;
+            hmark = ps->ps_histv + NCT_PS_MARK;
+            reqs = cs->requests - ps->ps_mark.requests;
+
+            if (nprocs > 1 && cs->requests > 0) {
+                printf("%8.8s %9s %8lu %7.2lf %7.2lf %7s %7.1lf %7s %7.1lf %7.1lf %7.1lf\n",
+                       nct_nfs_procname(i), "", reqs,
+                       (cs->thruput_send - ps->ps_mark.thruput_send) / (1024.0 * 1024),
+                       (cs->thruput_recv - ps->ps_mark.thruput_recv) / (1024.0 * 1024),
+                       "-",
+                       reqs ? ((cs->latency_cum - ps->ps_mark.latency_cum) * 1000000.0) / (tsc_freq * reqs) : 0,
+                       "-",
+                       (nct_hist_pct(hcur, hmark, 50) * 1000000.0) / tsc_freq,
+                       (nct_hist_pct(hcur, hmark, 99) * 1000000.0) / tsc_freq,
+                       (nct_hist_pct(hcur, hmark, 99.9) * 1000000.0) / tsc_freq);
+            }
+
+            ps->ps_mark = *cs;
+            *hmark = *hcur;
+        }
+
+        *hist_mark = *hist_cur;
 
         throughput_send_last = throughput_send_cur;
         throughput_recv_last = throughput_recv_cur;
@@ -296,20 +531,30 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
         tsc_last = tsc_cur;
     }
 
+    if (win)
+        nct_win_report(win);
+
+    if (pace && pace->pace_late > 0) {
+        eprint("%lu of %lu open-loop arrivals were sent late because all %u requests were in flight (max backlog %lu), use -j to allow more\n",
+               pace->pace_late, pace->pace_sent, mnt->mnt_jobs_max, pace->pace_backlog_max);
+    }
+
     if (statsv && statsc > 0 && outdir) {
+        uint64_t backlog_min, backlog_max, backlog_tot;
         uint64_t throughput_send_min, throughput_send_max, throughput_send_tot, throughput_send;
         uint64_t throughput_recv_min, throughput_recv_max, throughput_recv_tot, throughput_recv;
         uint64_t requests_min, requests_max, requests_tot, requests;
         double latency_min, latency_max;
         uint64_t latency_tot, latency;
+        struct nct_stats stats;
         nct_statsrec_t *tail;
-        FILE *fpraw;
+        FILE *fpraw, *fphist;
         time_t now;
 
         fpraw = fopen("raw", "w");
         if (!fpraw) {
             eprint("unable to open [%s/raw]: %s\n", outdir, strerror(errno));
-            return;
+            goto out;
         }
 
         time(&now);
@@ -320,10 +565,11 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
         fprintf(fpraw, "# time, duration, and latency in usecs\n");
         fprintf(fpraw, "# send and recv in bytes\n");
         fprintf(fpraw, "#\n");
-        fprintf(fpraw, "# %8s %10s %10s %8s %8s %10s %10s %8s %10s %10s\n",
+        fprintf(fpraw, "# %8s %10s %10s %8s %8s %10s %10s %8s %10s %10s %8s %8s %8s %8s %8s\n",
                 "SAMPLE", "TIME", "DURATION", "LATENCY",
                 "OPS", "SEND", "RECV",
-                "OPSRA", "SENDRA", "RECVRA");
+                "OPSRA", "SENDRA", "RECVRA",
+                "P50", "P99", "P999", "BACKLOG", "WINDOW");
 
         if (cur)
             end = cur - 1;      // Ignore the last sample
@@ -335,6 +581,8 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
         requests_min = latency_min = throughput_send_min = throughput_recv_min = ULONG_MAX;
         requests_max = latency_max = throughput_send_max = throughput_recv_max = 0;
         requests_tot = latency_tot = throughput_send_tot = throughput_recv_tot = 0;
+        backlog_min = ULONG_MAX;
+        backlog_max = backlog_tot = 0;
 
         while (cur < end) {
             uint64_t requests_ra, thruput_send_ra, thruput_recv_ra;
@@ -351,6 +599,12 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
             latency = cur->xsr_latency - prev->xsr_latency;
             latency_tot += latency;
 
+            backlog_tot += cur->xsr_backlog;
+            if (cur->xsr_backlog > backlog_max)
+                backlog_max = cur->xsr_backlog;
+            if (cur->xsr_backlog < backlog_min)
+                backlog_min = cur->xsr_backlog;
+
             if (requests > 0) {
                 if (latency / requests > latency_max)
                     latency_max = latency / requests;
@@ -390,13 +644,17 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
 
             cur->xsr_time -= tsc_start;
 
-            fprintf(fpraw, "  %8u %10lu %10lu %8lu %8lu %10lu %10lu %8lu %10lu %10lu\n",
+            fprintf(fpraw, "  %8u %10lu %10lu %8lu %8lu %10lu %10lu %8lu %10lu %10lu %8lu %8lu %8lu %8u %8u\n",
                     cur->xsr_sample,
                     (cur->xsr_time * 1000000ul) / tsc_freq,
                     ((cur->xsr_time - prev->xsr_time) * 1000000ul) / tsc_freq,
                     (latency * 1000000ul) / tsc_freq,
                     requests, throughput_send, throughput_recv,
-                    requests_ra, thruput_send_ra, thruput_recv_ra);
+                    requests_ra, thruput_send_ra, thruput_recv_ra,
+                    (cur->xsr_latency_p50 * 1000000ul) / tsc_freq,
+                    (cur->xsr_latency_p99 * 1000000ul) / tsc_freq,
+                    (cur->xsr_latency_p999 * 1000000ul) / tsc_freq,
+                    cur->xsr_backlog, cur->xsr_window);
 
             prev = cur;
             ++cur;
@@ -406,6 +664,8 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
          */
         samples_tot = cur - statsv;
 
+        nct_mnt_stats(mnt, &stats, false);
+
         printf("\n%12s %12s %12s %15s  %s\n", "MIN", "AVG", "MAX", "TOTAL", "DESC");
 
         uint64_t requests_avg = (requests_tot * samples_per_sec) / samples_tot;
@@ -414,29 +674,75 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
                throughput_send_min,
                (throughput_send_tot * samples_per_sec) / samples_tot,
                throughput_send_max,
-               mnt->mnt_stats.thruput_send);
+               stats.thruput_send);
 
         printf("%12lu %12lu %12lu %15lu  bytes received per second\n",
                throughput_recv_min,
                (throughput_recv_tot * samples_per_sec) / samples_tot,
                throughput_recv_max,
-               mnt->mnt_stats.thruput_recv);
+               stats.thruput_recv);
 
         printf("%12.1lf %12.1lf %12.1lf %15lu  latency per request (usecs)\n",
                (latency_min * 1000000.0) / tsc_freq,
                ((latency_tot * 1000000.0 * samples_per_sec) / (tsc_freq * samples_tot)) / requests_avg,
                (latency_max * 1000000.0) / tsc_freq,
-               mnt->mnt_stats.latency_cum);
+               stats.latency_cum);
+
+        printf("%12.1lf %12.1lf %12.1lf %15s  latency p50 p90 p99 (usecs)\n",
+               (nct_hist_pct(hist_cur, hist_base, 50) * 1000000.0) / tsc_freq,
+               (nct_hist_pct(hist_cur, hist_base, 90) * 1000000.0) / tsc_freq,
+               (nct_hist_pct(hist_cur, hist_base, 99) * 1000000.0) / tsc_freq,
+               "-");
+
+        printf("%12.1lf %12.1lf %12.1lf %15s  latency p99.9 p99.99 p100 (usecs)\n",
+               (nct_hist_pct(hist_cur, hist_base, 99.9) * 1000000.0) / tsc_freq,
+               (nct_hist_pct(hist_cur, hist_base, 99.99) * 1000000.0) / tsc_freq,
+               (nct_hist_pct(hist_cur, hist_base, 100) * 1000000.0) / tsc_freq,
+               "-");
 
         printf("%12lu %12lu %12lu %15lu  requests per second\n",
                requests_min, requests_avg, requests_max,
-               mnt->mnt_stats.requests);
+               stats.requests);
+
+        if (pace) {
+            double rate_min = pace->pace_ratev[0];
+            double rate_max = pace->pace_ratev[0];
+
+            for (i = 1; i < pace->pace_ratec; ++i) {
+                if (pace->pace_ratev[i] < rate_min)
+                    rate_min = pace->pace_ratev[i];
+                if (pace->pace_ratev[i] > rate_max)
+                    rate_max = pace->pace_ratev[i];
+            }
+
+            printf("%12.1lf %12.1lf %12.1lf %15lu  open-loop arrivals per second (MIN/MAX: target)\n",
+                   rate_min,
+                   (pace->pace_sent * (double)tsc_freq) / (pace->pace_tsc_end - pace->pace_tsc_begin),
+                   rate_max, pace->pace_sent);
+
+            printf("%12lu %12lu %12lu %15lu  open-loop backlog (TOTAL: arrivals sent late)\n",
+                   backlog_min, backlog_tot / samples_tot, backlog_max,
+                   pace->pace_late);
+        }
 
         printf("%12s %12s %12s %15lu  updates\n",
-               "-", "-", "-", mnt->mnt_stats.updates);
+               "-", "-", "-", stats.updates);
+
+        printf("%12s %12s %12s %15lu  receives\n",
+               "-", "-", "-", stats.recvs);
 
-        printf("%12s %12s %12s %15lu  marks\n",
-               "-", "-", "-", mnt->mnt_stats.marks);
+        printf("%12s %12s %12s %15lu  stray replies\n",
+               "-", "-", "-", stats.strays);
+
+        printf("%12s %12s %12s %15lu  xid collisions\n",
+               "-", "-", "-", stats.collisions);
+
+        if (mnt->mnt_flags & NCT_MNT_ZEROCOPY) {
+            printf("%12s %12s %12s %15lu  zerocopy sends\n",
+                   "-", "-", "-", stats.zc_sends);
+            printf("%12s %12s %12s %15lu  zerocopy sends copied\n",
+                   "-", "-", "-", stats.zc_copied);
+        }
 
         printf("%12s %12s %12s %15u  threads\n",
                "-", "-", "-", mnt->mnt_tds_max);
@@ -444,9 +750,114 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
         printf("%12s %12s %12s %15u  jobs\n",
                "-", "-", "-", mnt->mnt_jobs_max);
 
+        printf("%12s %12s %12s %15u  connections\n",
+               "-", "-", "-", mnt->mnt_conns_max);
+
+        /* Print per-connection totals...
+         */
+        if (mnt->mnt_conns_max > 1) {
+            printf("\n%6s %15s %15s %15s %12s  %s\n",
+                   "CONN", "REQUESTS", "SEND", "RECV", "LATAVG", "RECVS");
+
+            for (i = 0; i < mnt->mnt_conns_max; ++i) {
+                nct_conn_t *conn = mnt->mnt_connv + i;
+                struct nct_stats cs;
+
+                nct_conn_stats(conn, &cs);
+
+                printf("%6u %15lu %15lu %15lu %12.1lf  %lu\n",
+                       conn->conn_idx, cs.requests,
+                       cs.thruput_send, cs.thruput_recv,
+                       cs.requests ? (cs.latency_cum * 1000000.0) / (tsc_freq * cs.requests) : 0,
+                       cs.recvs);
+            }
+        }
+
+        /* Print per-thread totals, and the imbalance of the load across
+         * the recv threads (i.e., the ratio of the busiest thread's
+         * requests to the mean)...
+         */
+        if (mnt->mnt_shards_cnt > 1) {
+            u_int shards_cnt = mnt->mnt_shards_cnt;
+            struct nct_stats *tsv;
+            uint64_t tsmax = 0;
+            nct_shard_t *shard;
+
+            tsv = calloc(shards_cnt, sizeof(*tsv));
+            if (!tsv)
+                abort();
+
+            for (shard = mnt->mnt_shard_head; shard; shard = shard->shard_next) {
+                if (shard->shard_idx < shards_cnt)
+                    nct_shard_stats(mnt, shard, tsv + shard->shard_idx);
+            }
+
+            printf("\n%6s %15s %15s %15s %12s  %s\n",
+                   "THREAD", "REQUESTS", "SEND", "RECV", "LATAVG", "RECVS");
+
+            for (i = 0; i < shards_cnt; ++i) {
+                struct nct_stats *ts = tsv + i;
+
+                if (ts->requests > tsmax)
+                    tsmax = ts->requests;
+
+                printf("%6u %15lu %15lu %15lu %12.1lf  %lu\n",
+                       i, ts->requests,
+                       ts->thruput_send, ts->thruput_recv,
+                       ts->requests ? (ts->latency_cum * 1000000.0) / (tsc_freq * ts->requests) : 0,
+                       ts->recvs);
+            }
+
+            printf("%6s %15.2lf  recv thread imbalance (max/mean requests)\n", "",
+                   stats.requests ? (tsmax * (double)shards_cnt) / stats.requests : 0);
+
+            free(tsv);
+        }
+
+        /* Print per-procedure totals, and write out the per-procedure
+         * samples and histograms...
+         */
+        nct_mnt_proc_stats(mnt, procstatsv);
+
+        printf("\n%11s %12s %15s %15s %12s %9s %9s %9s\n",
+               "PROC", "REQUESTS", "SEND", "RECV", "LATAVG", "P50", "P99", "P999");
+
+        for (i = 0; i < NCT_PROC_MAX; ++i) {
+            nct_procstats_t *ps = procv[i];
+            struct nct_stats *cs = procstatsv + i;
+            nct_hist_t *hcur, *hbase;
+
+            if (!ps || cs->requests == 0)
+                continue;
+
+            hcur = ps->ps_histv + NCT_PS_CUR;
+            hbase = ps->ps_histv + NCT_PS_BASE;
+
+            printf("%11s %12lu %15lu %15lu %12.1lf %9.1lf %9.1lf %9.1lf\n",
+                   nct_nfs_procname(i), cs->requests,
+                   cs->thruput_send, cs->thruput_recv,
+                   (cs->latency_cum * 1000000.0) / (tsc_freq * cs->requests),
+                   (nct_hist_pct(hcur, hbase, 50) * 1000000.0) / tsc_freq,
+                   (nct_hist_pct(hcur, hbase, 99) * 1000000.0) / tsc_freq,
+                   (nct_hist_pct(hcur, hbase, 99.9) * 1000000.0) / tsc_freq);
+
+            nct_procstats_write(ps, nct_nfs_procname(i), statsv, samples_tot);
+        }
+
 
         fclose(fpraw);
 
+        /* Dump the latency histogram of the entire run...
+         */
+        fphist = fopen("latency.hist", "w");
+        if (fphist) {
+            fprintf(fphist, "# Created on %s", ctime(&now));
+            nct_hist_dump(fphist, hist_cur, hist_base);
+            fclose(fphist);
+        } else {
+            eprint("unable to open [%s/latency.hist]: %s\n", outdir, strerror(errno));
+        }
+
         char ylabel[128], using[128];
 
         /* Create the gnuplot files...
@@ -476,5 +887,21 @@ nct_stats_loop(nct_mnt_t *mnt, u_int mark,
                  1000000, 1);
         nct_gplot(samples_tot, samples_per_sec, term, using,
                   "requests", "seconds", ylabel, "blue");
+
+        snprintf(using, sizeof(using),
+                 "($2 / %d):12",
+                 1000000);
+        nct_gplot(samples_tot, samples_per_sec, term, using,
+                  "latency-p99", "seconds", "usecs", "black");
     }
+
+  out:
+    for (i = 0; i < NCT_PROC_MAX; ++i) {
+        if (procv[i]) {
+            free(procv[i]->ps_statsv);
+            free(procv[i]);
+        }
+    }
+
+    free(hist_cur);
 }
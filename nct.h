@@ -35,21 +35,29 @@
  */
 typedef struct {
     uint32_t           xsr_sample;              // Sample interval number
-    uint32_t           xsr_rsvd;                // Available for use
+    uint32_t           xsr_backlog;             // Open-loop arrivals due but not sent
     uint64_t           xsr_time;                // Time when sample was taken (in cycles)
     uint64_t           xsr_duration;            // Duration of sampling period
     uint64_t           xsr_requests;            // Toal number of requests completed
     uint64_t           xsr_throughput_send;     // Total bytes sent in the sample period
     uint64_t           xsr_throughput_recv;     // Total bytes rcvd in the sample period
     uint64_t           xsr_latency;             // Total latency of all ops in the sample
+    uint64_t           xsr_latency_p50;         // Latency percentiles of the sample
+    uint64_t           xsr_latency_p99;
+    uint64_t           xsr_latency_p999;
+    uint32_t           xsr_window;              // Adaptive window size
+    uint32_t           xsr_rsvd;                // Available for use
 } nct_statsrec_t;
 
 extern void nct_req_send(nct_req_t *req);
+extern void nct_req_issue(nct_req_t *req);
+extern void nct_req_exit(nct_req_t *req);
 extern int nct_req_recv(nct_mnt_t *mnt);
 extern void nct_req_wait(nct_req_t *req);
 
 extern nct_req_t *nct_req_alloc(nct_mnt_t *mnt);
 extern void nct_req_free(nct_req_t *req);
+extern void nct_req_mag_flush(nct_mnt_t *mnt);
 
 extern void nct_stats_loop(nct_mnt_t *mnt, uint mark,
                            long sample_period, long duration,
@@ -74,7 +74,8 @@ given(int c)
 }
 
 void *
-test_getattr_init(int argc, char **argv, int duration, start_t **startp, char **rhostpathp)
+test_getattr_init(int argc, char **argv, int duration, start_t **startp,
+                  char **rhostpathp, size_t *msgszp)
 {
     test_getattr_priv_t *priv;
     int rc;
@@ -103,41 +104,52 @@ test_getattr_init(int argc, char **argv, int duration, start_t **startp, char **
     return priv;
 }
 
+void
+test_getattr_fini(void *priv)
+{
+    free(priv);
+}
+
 static int
 test_getattr_cb(struct nct_req *req)
 {
+    nct_msg_t *msg = req->req_msg;
     enum clnt_stat stat;
     getattr3_res res;
+    nct_xbuf_t xb;
     bool_t ok;
 
-    stat = req->req_msg->msg_stat;
+    stat = msg->msg_stat;
     if (stat != RPC_SUCCESS) {
         eprint("getattr rpc failed: clnt_stat=%d %s\n",
-               req->req_msg->msg_stat, clnt_sperrno(req->req_msg->msg_stat));
-        XDR_DESTROY(&req->req_msg->msg_xdr);
+               msg->msg_stat, clnt_sperrno(msg->msg_stat));
         nct_req_free(req);
         return stat;
     }
 
-    ok = nct_xdr_getattr3_decode(&req->req_msg->msg_xdr, &res);
+    nct_msg_results(msg, &xb, NULL, 0);
+
+    ok = nct_xdr_decode_getattr3_res(&xb, &res);
     if (!ok) {
+        eprint("getattr reply truncated: len=%zu\n", msg->msg_len);
+        nct_req_free(req);
+        return EPROTO;
+    }
+
+    if (res.status != NFS3_OK) {
         eprint("getattr nfs failed: nfsstat3=%d %s\n",
-               res.status, strerror(res.status));
-        XDR_DESTROY(&req->req_msg->msg_xdr);
+               res.status, strerror_nfsstat3(res.status));
         nct_req_free(req);
         return res.status;
     }
 
-    XDR_DESTROY(&req->req_msg->msg_xdr);
-
     if (req->req_tsc_stop >= req->req_tsc_finish) {
         nct_req_free(req);
         return ETIMEDOUT;
     }
 
-    req->req_tsc_start = rdtsc();
     nct_nfs_getattr3_encode(req);
-    nct_req_send(req);
+    nct_req_issue(req);
 
     return 0;
 }
@@ -150,9 +162,8 @@ test_getattr_start(struct nct_req *req)
     req->req_tsc_finish = rdtsc() + (tsc_freq * priv->pr_duration);
     req->req_cb = test_getattr_cb;
 
-    req->req_tsc_start = rdtsc();
     nct_nfs_getattr3_encode(req);
-    nct_req_send(req);
+    nct_req_issue(req);
 
     return 0;
 }
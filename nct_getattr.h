@@ -4,6 +4,8 @@
 #ifndef NCT_GETATTR_H
 #define NCT_GETATTR_H
 
-extern void *test_getattr_init(int argc, char **argv, int duration, start_t **startp, char **rhostpathp);
+extern void *test_getattr_init(int argc, char **argv, int duration, start_t **startp,
+                               char **rhostpathp, size_t *msgszp);
+extern void test_getattr_fini(void *priv);
 
 #endif // NCT_GETATTR_H
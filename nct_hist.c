@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "main.h"
+#include "nct_hist.h"
+
+/* Return the smallest value that maps to the given bucket.
+ */
+uint64_t
+nct_hist_lo(u_int idx)
+{
+    u_int shift;
+
+    if (idx < NCT_HIST_HALF * 2)
+        return idx;
+
+    shift = idx / NCT_HIST_HALF - 1;
+
+    return (uint64_t)(idx - shift * NCT_HIST_HALF) << shift;
+}
+
+/* Return the largest value that maps to the given bucket.
+ */
+uint64_t
+nct_hist_hi(u_int idx)
+{
+    if (idx + 1 >= NCT_HIST_BKTS)
+        return UINT64_MAX;
+
+    return nct_hist_lo(idx + 1) - 1;
+}
+
+/* Add a snapshot of the given histogram into dst.  The source may be
+ * concurrently updated by its owner.
+ */
+void
+nct_hist_merge(nct_hist_t *dst, const nct_hist_t *src)
+{
+    u_int i;
+
+    for (i = 0; i < NCT_HIST_BKTS; ++i)
+        dst->hist_bktv[i] += __atomic_load_n(&src->hist_bktv[i], __ATOMIC_RELAXED);
+}
+
+/* Return the number of values recorded in cur since the snapshot prev
+ * was taken (prev may be nil).
+ */
+uint64_t
+nct_hist_count(const nct_hist_t *cur, const nct_hist_t *prev)
+{
+    uint64_t cnt = 0;
+    u_int i;
+
+    for (i = 0; i < NCT_HIST_BKTS; ++i)
+        cnt += cur->hist_bktv[i] - (prev ? prev->hist_bktv[i] : 0);
+
+    return cnt;
+}
+
+/* Return the value at the given percentile (0 to 100) of the values
+ * recorded in cur since the snapshot prev was taken (prev may be nil).
+ * As with HdrHistogram, the value returned is the highest value that
+ * is equivalent to the value at that percentile.  Returns zero if no
+ * values were recorded.
+ */
+uint64_t
+nct_hist_pct(const nct_hist_t *cur, const nct_hist_t *prev, double pct)
+{
+    uint64_t cnt, tgt, sum;
+    u_int i;
+
+    cnt = nct_hist_count(cur, prev);
+    if (cnt == 0)
+        return 0;
+
+    tgt = (cnt * pct) / 100.0 + 0.5;
+    if (tgt < 1)
+        tgt = 1;
+
+    for (i = sum = 0; i < NCT_HIST_BKTS; ++i) {
+        sum += cur->hist_bktv[i] - (prev ? prev->hist_bktv[i] : 0);
+        if (sum >= tgt)
+            break;
+    }
+
+    return nct_hist_hi(i);
+}
+
+/* Print the distribution of values recorded in cur since the snapshot
+ * prev was taken (prev may be nil), one line per non-empty bucket, with
+ * values converted from rdtsc() ticks to microseconds.
+ */
+void
+nct_hist_dump(FILE *fp, const nct_hist_t *cur, const nct_hist_t *prev)
+{
+    const double pctv[] = { 50, 90, 99, 99.9, 99.99, 100 };
+    uint64_t cnt, sum, n;
+    u_int i;
+
+    cnt = nct_hist_count(cur, prev);
+
+    fprintf(fp, "# %lu samples\n", cnt);
+    fprintf(fp, "# values in usecs, each within %.2lf%% of the true value\n",
+            100.0 / NCT_HIST_HALF);
+    fprintf(fp, "#\n");
+
+    for (i = 0; i < NELEM(pctv); ++i)
+        fprintf(fp, "# p%-6g %12.1lf\n",
+                pctv[i], (nct_hist_pct(cur, prev, pctv[i]) * 1000000.0) / tsc_freq);
+
+    fprintf(fp, "#\n");
+    fprintf(fp, "# %10s %12s %12s %10s\n", "LO", "HI", "COUNT", "PERCENTILE");
+
+    for (i = sum = 0; i < NCT_HIST_BKTS && sum < cnt; ++i) {
+        n = cur->hist_bktv[i] - (prev ? prev->hist_bktv[i] : 0);
+        if (n == 0)
+            continue;
+
+        sum += n;
+
+        fprintf(fp, "  %10.1lf %12.1lf %12lu %10.5lf\n",
+                (nct_hist_lo(i) * 1000000.0) / tsc_freq,
+                (nct_hist_hi(i) * 1000000.0) / tsc_freq,
+                n, (sum * 100.0) / cnt);
+    }
+}
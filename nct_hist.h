@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NCT_HIST_H
+#define NCT_HIST_H
+
+/* Log-linear latency histogram in the manner of HdrHistogram.  Values
+ * below 2 * NCT_HIST_HALF each have their own bucket, after which each
+ * power of two is divided into NCT_HIST_HALF buckets of equal width,
+ * such that the recorded value of a sample is within 1/NCT_HIST_HALF
+ * of its true value.  Values are recorded in rdtsc() ticks.
+ */
+#define NCT_HIST_SUBBITS    (7)
+#define NCT_HIST_HALF       (1u << (NCT_HIST_SUBBITS - 1))
+#define NCT_HIST_BKTS       ((66 - NCT_HIST_SUBBITS) * NCT_HIST_HALF)
+
+/* A histogram that is recorded into by exactly one thread needs
+ * neither locks nor atomic read-modify-write operations, the writer
+ * need only store each count in one piece so that it can be merged
+ * by another thread at any time.
+ */
+typedef struct nct_hist_s {
+    uint64_t            hist_bktv[NCT_HIST_BKTS];
+} nct_hist_t;
+
+static inline u_int
+nct_hist_idx(uint64_t val)
+{
+    u_int shift;
+
+    if (val < NCT_HIST_HALF * 2)
+        return val;
+
+    shift = (63 - __builtin_clzll(val)) - NCT_HIST_SUBBITS + 1;
+
+    return shift * NCT_HIST_HALF + (val >> shift);
+}
+
+static inline void
+nct_hist_record(nct_hist_t *hist, uint64_t val)
+{
+    uint64_t *bkt = hist->hist_bktv + nct_hist_idx(val);
+
+    __atomic_store_n(bkt, *bkt + 1, __ATOMIC_RELAXED);
+}
+
+extern uint64_t nct_hist_lo(u_int idx);
+extern uint64_t nct_hist_hi(u_int idx);
+
+extern void nct_hist_merge(nct_hist_t *dst, const nct_hist_t *src);
+extern uint64_t nct_hist_count(const nct_hist_t *cur, const nct_hist_t *prev);
+extern uint64_t nct_hist_pct(const nct_hist_t *cur, const nct_hist_t *prev, double pct);
+extern void nct_hist_dump(FILE *fp, const nct_hist_t *cur, const nct_hist_t *prev);
+
+#endif // NCT_HIST_H
@@ -37,6 +37,12 @@
 #include <time.h>
 #include <sysexits.h>
 #include <sys/select.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#if __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 #include <limits.h>
 #include <unistd.h>
@@ -57,45 +63,633 @@
 #include "nct_xdr.h"
 
 int
-nct_connect(nct_mnt_t *mnt)
+nct_connect(nct_conn_t *conn)
 {
+    nct_mnt_t *mnt = conn->conn_mnt;
     int rc;
 
-    dprint(1, "connecting to %s...\n", mnt->mnt_server);
+    dprint(1, "connecting to %s (conn %u)...\n", mnt->mnt_server, conn->conn_idx);
 
-    if (mnt->mnt_fd != -1) {
-        close(mnt->mnt_fd);
+    if (conn->conn_fd != -1) {
+        close(conn->conn_fd);
     }
 
-    mnt->mnt_fd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (mnt->mnt_fd == -1) {
+    conn->conn_fd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (conn->conn_fd == -1) {
         return errno;
     }
 
-    rc = connect(mnt->mnt_fd, (struct sockaddr *)&mnt->mnt_faddr, sizeof(mnt->mnt_faddr));
+    rc = connect(conn->conn_fd, (struct sockaddr *)&mnt->mnt_faddr, sizeof(mnt->mnt_faddr));
     if (rc) {
-        close(mnt->mnt_fd);
-        mnt->mnt_fd = -1;
+        close(conn->conn_fd);
+        conn->conn_fd = -1;
         return errno;
     }
 
-    dprint(1, "connected to %s fd=%d\n", mnt->mnt_server, mnt->mnt_fd);
+    /* The epoll engine receives with MSG_DONTWAIT, but the socket is
+     * made nonblocking as well so that a full socket buffer never
+     * blocks a sender while it holds the send lock (nct_rpc_send()
+     * polls for writability instead).
+     */
+    if (mnt->mnt_flags & NCT_MNT_EPOLL) {
+        rc = fcntl(conn->conn_fd, F_SETFL, fcntl(conn->conn_fd, F_GETFL) | O_NONBLOCK);
+        if (rc) {
+            close(conn->conn_fd);
+            conn->conn_fd = -1;
+            return errno;
+        }
+    }
+
+    /* Zerocopy is merely an optimization, so carry on without it if
+     * the kernel does not support it.
+     */
+    conn->conn_zerocopy = false;
+
+    if (mnt->mnt_flags & NCT_MNT_ZEROCOPY) {
+#ifdef SO_ZEROCOPY
+        int one = 1;
+
+        rc = setsockopt(conn->conn_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+        if (rc)
+            eprint("setsockopt(SO_ZEROCOPY) failed: %s\n", strerror(errno));
+        conn->conn_zerocopy = !rc;
+#else
+        eprint("MSG_ZEROCOPY is not supported on this platform\n");
+#endif
+    }
+
+    dprint(1, "connected to %s fd=%d\n", mnt->mnt_server, conn->conn_fd);
 
     return 0;
 }
 
+static void
+nct_stats_add(struct nct_stats *dst, const struct nct_stats *src)
+{
+    dst->latency_cum += src->latency_cum;
+    dst->requests += src->requests;
+    dst->thruput_send += src->thruput_send;
+    dst->thruput_recv += src->thruput_recv;
+    dst->updates += src->updates;
+    dst->recvs += src->recvs;
+    dst->strays += src->strays;
+    dst->collisions += src->collisions;
+    dst->zc_sends += src->zc_sends;
+    dst->zc_copied += src->zc_copied;
+}
+
+static void
+nct_stats_sub(struct nct_stats *dst, const struct nct_stats *src)
+{
+    dst->latency_cum -= src->latency_cum;
+    dst->requests -= src->requests;
+    dst->thruput_send -= src->thruput_send;
+    dst->thruput_recv -= src->thruput_recv;
+    dst->updates -= src->updates;
+    dst->recvs -= src->recvs;
+    dst->strays -= src->strays;
+    dst->collisions -= src->collisions;
+    dst->zc_sends -= src->zc_sends;
+    dst->zc_copied -= src->zc_copied;
+}
+
+/* Take a consistent snapshot of the counters of the given shard for
+ * element idx of the given vector of the shard (e.g., shard_connv), or
+ * for all cnt elements if idx is -1, retrying if the owner updated the
+ * shard while we were reading it.  The min and max latencies are
+ * returned only if they belong to the given epoch.
+ */
+static void
+nct_shard_read(nct_shard_t *shard, const struct nct_stats *vec, int cnt,
+               int idx, u_int epoch, struct nct_stats *stats)
+{
+    u_int seq;
+    int i;
+
+    while (1) {
+        seq = __atomic_load_n(&shard->shard_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        memset(stats, 0, sizeof(*stats));
+        stats->latency_min = UINT64_MAX;
+
+        for (i = 0; i < cnt; ++i) {
+            if (idx == -1 || idx == i)
+                nct_stats_add(stats, vec + i);
+        }
+
+        if (shard->shard_epoch == epoch) {
+            stats->latency_min = shard->shard_latency_min;
+            stats->latency_max = shard->shard_latency_max;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&shard->shard_seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+}
+
+/* Sum the stats shards of all the recv threads into *stats.  If reset
+ * is true then the min/max latency of each shard is reset (lazily, by
+ * its owner, upon noticing that the stats epoch has changed).
+ */
+void
+nct_mnt_stats(nct_mnt_t *mnt, struct nct_stats *stats, bool reset)
+{
+    struct nct_stats ss;
+    nct_shard_t *shard;
+    nct_conn_t *conn;
+    u_int epoch;
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->latency_min = UINT64_MAX;
+
+    epoch = __atomic_load_n(&mnt->mnt_stats_epoch, __ATOMIC_ACQUIRE);
+
+    shard = __atomic_load_n(&mnt->mnt_shard_head, __ATOMIC_ACQUIRE);
+
+    for (; shard; shard = shard->shard_next) {
+        nct_shard_read(shard, shard->shard_connv, mnt->mnt_conns_max, -1, epoch, &ss);
+        nct_stats_sub(&ss, &shard->shard_base);
+        nct_stats_add(stats, &ss);
+
+        if (ss.latency_min < stats->latency_min)
+            stats->latency_min = ss.latency_min;
+        if (ss.latency_max > stats->latency_max)
+            stats->latency_max = ss.latency_max;
+    }
+
+    if (reset)
+        __atomic_store_n(&mnt->mnt_stats_epoch, epoch + 1, __ATOMIC_RELEASE);
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i) {
+        conn = mnt->mnt_connv + i;
+
+        stats->collisions += __atomic_load_n(&conn->conn_send_collisions, __ATOMIC_RELAXED);
+        stats->collisions -= conn->conn_stats_base.collisions;
+        stats->zc_sends += __atomic_load_n(&conn->conn_zc_sends, __ATOMIC_RELAXED);
+        stats->zc_sends -= conn->conn_stats_base.zc_sends;
+        stats->zc_copied += __atomic_load_n(&conn->conn_zc_copied, __ATOMIC_RELAXED);
+        stats->zc_copied -= conn->conn_stats_base.zc_copied;
+    }
+}
+
+/* Sum the stats of the given connection from all the stats shards.
+ */
+void
+nct_conn_stats(nct_conn_t *conn, struct nct_stats *stats)
+{
+    nct_mnt_t *mnt = conn->conn_mnt;
+    struct nct_stats ss;
+    nct_shard_t *shard;
+
+    memset(stats, 0, sizeof(*stats));
+
+    shard = __atomic_load_n(&mnt->mnt_shard_head, __ATOMIC_ACQUIRE);
+
+    for (; shard; shard = shard->shard_next) {
+        nct_shard_read(shard, shard->shard_connv, mnt->mnt_conns_max,
+                       conn->conn_idx, ~0u, &ss);
+        nct_stats_add(stats, &ss);
+    }
+
+    stats->collisions = __atomic_load_n(&conn->conn_send_collisions, __ATOMIC_RELAXED);
+    stats->zc_sends = __atomic_load_n(&conn->conn_zc_sends, __ATOMIC_RELAXED);
+    stats->zc_copied = __atomic_load_n(&conn->conn_zc_copied, __ATOMIC_RELAXED);
+    nct_stats_sub(stats, &conn->conn_stats_base);
+}
+
+/* Return the stats of the given shard (i.e., of a single recv thread).
+ */
+void
+nct_shard_stats(nct_mnt_t *mnt, nct_shard_t *shard, struct nct_stats *stats)
+{
+    nct_shard_read(shard, shard->shard_connv, mnt->mnt_conns_max, -1, ~0u, stats);
+    nct_stats_sub(stats, &shard->shard_base);
+}
+
+/* Exclude all the stats accumulated thus far (e.g., by the requests
+ * made by nct_mount()) from all subsequent reports.
+ */
+void
+nct_mnt_stats_zero(nct_mnt_t *mnt)
+{
+    struct nct_stats procv[NCT_PROC_MAX];
+    struct nct_stats cs;
+    nct_shard_t *shard;
+    nct_conn_t *conn;
+    int i;
+
+    shard = __atomic_load_n(&mnt->mnt_shard_head, __ATOMIC_ACQUIRE);
+
+    for (; shard; shard = shard->shard_next)
+        nct_shard_read(shard, shard->shard_connv, mnt->mnt_conns_max,
+                       -1, ~0u, &shard->shard_base);
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i) {
+        conn = mnt->mnt_connv + i;
+
+        memset(&conn->conn_stats_base, 0, sizeof(conn->conn_stats_base));
+        nct_conn_stats(conn, &cs);
+        conn->conn_stats_base = cs;
+    }
+
+    memset(mnt->mnt_procbase, 0, sizeof(mnt->mnt_procbase));
+    nct_mnt_proc_stats(mnt, procv);
+    memcpy(mnt->mnt_procbase, procv, sizeof(procv));
+
+    __atomic_add_fetch(&mnt->mnt_stats_epoch, 1, __ATOMIC_RELEASE);
+}
+
+/* Sum the stats of each procedure from all the stats shards into
+ * statsv[NCT_PROC_MAX].
+ */
+void
+nct_mnt_proc_stats(nct_mnt_t *mnt, struct nct_stats *statsv)
+{
+    struct nct_stats ss;
+    nct_shard_t *shard;
+    int i;
+
+    memset(statsv, 0, sizeof(*statsv) * NCT_PROC_MAX);
+
+    shard = __atomic_load_n(&mnt->mnt_shard_head, __ATOMIC_ACQUIRE);
+
+    for (; shard; shard = shard->shard_next) {
+        for (i = 0; i < NCT_PROC_MAX; ++i) {
+            nct_shard_read(shard, shard->shard_procv, NCT_PROC_MAX, i, ~0u, &ss);
+            nct_stats_add(statsv + i, &ss);
+        }
+    }
+
+    for (i = 0; i < NCT_PROC_MAX; ++i)
+        nct_stats_sub(statsv + i, mnt->mnt_procbase + i);
+}
+
+/* Merge the latency histograms of the given procedure (or of all
+ * procedures if proc is -1) from all the recv threads into *hist.
+ * Returns false if no request of the procedure has yet completed.
+ */
+bool
+nct_mnt_hist(nct_mnt_t *mnt, int proc, nct_hist_t *hist)
+{
+    nct_shard_t *shard;
+    nct_hist_t *src;
+    bool found = false;
+    int i;
+
+    memset(hist, 0, sizeof(*hist));
+
+    shard = __atomic_load_n(&mnt->mnt_shard_head, __ATOMIC_ACQUIRE);
+
+    for (; shard; shard = shard->shard_next) {
+        for (i = 0; i < NCT_PROC_MAX; ++i) {
+            if (proc != -1 && proc != i)
+                continue;
+
+            src = __atomic_load_n(&shard->shard_histv[i], __ATOMIC_ACQUIRE);
+            if (src) {
+                nct_hist_merge(hist, src);
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+/* Issue the given call and wait for its reply.  Returns false if the
+ * call failed at the RPC level.
+ */
+static bool
+nct_mnt_call(nct_req_t *req)
+{
+    enum clnt_stat stat;
+
+    req->req_tsc_start = rdtsc();
+    nct_req_send(req);
+    nct_req_wait(req);
+
+    stat = req->req_msg->msg_stat;
+    if (stat != RPC_SUCCESS) {
+        eprint("%s failed: %d %s\n",
+               nct_nfs_procname(req->req_proc), stat, clnt_sperrno(stat));
+        return false;
+    }
+
+    return true;
+}
+
+/* Append vn to the targets of the jobs.
+ */
+static void
+nct_mnt_target(nct_mnt_t *mnt, nct_vn_t *vn)
+{
+    nct_vn_t **vnv;
+
+    vnv = realloc(mnt->mnt_vnv, sizeof(*vnv) * (mnt->mnt_vnc + 1));
+    if (!vnv)
+        abort();
+
+    vnv[mnt->mnt_vnc++] = vn;
+    mnt->mnt_vnv = vnv;
+
+    dprint(2, "target %u: %s  size %lu\n", mnt->mnt_vnc - 1,
+           vn->xvn_name, vn->xvn_size);
+}
+
+/* Look up name in directory dvn, going to the server only if the name
+ * is not cached (or its type is unknown).  Returns NULL if the lookup
+ * failed.
+ */
+static nct_vn_t *
+nct_mnt_lookup(nct_mnt_t *mnt, nct_vn_t *dvn, const char *name)
+{
+    lookup3_res res;
+    nct_req_t *req;
+    nct_xbuf_t xb;
+    nct_vn_t *vn;
+    fhandle3 fh;
+
+    vn = nct_vn_lookup(mnt->mnt_vncache, dvn, name);
+    if (vn && vn->xvn_type)
+        return vn;
+
+    vn = NULL;
+    req = nct_req_alloc(mnt);
+    nct_nfs_lookup3_encode(req, dvn, name);
+
+    if (!nct_mnt_call(req))
+        goto out;
+
+    nct_msg_results(req->req_msg, &xb, NULL, 0);
+
+    if (!nct_xdr_decode_lookup3_res(&xb, &res)) {
+        eprint("lookup3 of %s reply truncated\n", name);
+        goto out;
+    }
+
+    if (res.status != NFS3_OK) {
+        eprint("lookup3 of %s in %s failed: %s\n",
+               name, dvn->xvn_name, strerror_nfsstat3(res.status));
+        goto out;
+    }
+
+    fh.fhandle3_len = res.u.resok.object.data.data_len;
+    fh.fhandle3_val = res.u.resok.object.data.data_val;
+
+    vn = nct_vn_insert(mnt->mnt_vncache, dvn, name, &fh,
+                       res.u.resok.obj_attributes.attributes_follow ?
+                       &res.u.resok.obj_attributes.u.attributes : NULL);
+    if (!vn)
+        eprint("unable to cache vnode for %s\n", name);
+
+  out:
+    nct_req_free(req);
+
+    return vn;
+}
+
+/* Append the regular files in directory dvn whose names match pattern
+ * to the targets of the jobs, in the order in which the server lists
+ * them.  Entries that come without a handle or attributes are looked
+ * up.  Returns false if the directory could not be read in full.
+ */
+static bool
+nct_mnt_readdir(nct_mnt_t *mnt, nct_vn_t *dvn, const char *pattern)
+{
+    readdirplus3_res res;
+    cookieverf3 verf;
+    cookie3 cookie;
+    entryplus3 *ent;
+    nct_req_t *req;
+    nct_xbuf_t xb;
+    nct_vn_t *vn;
+    size_t heapsz;
+    char *heap;
+    fhandle3 fh;
+    bool eof;
+
+    /* Decoded entries (with their names) take more room than they
+     * do on the wire.
+     */
+    heapsz = mnt->mnt_msgsz * 2;
+    heap = malloc(heapsz);
+    if (!heap)
+        abort();
+
+    memset(verf, 0, sizeof(verf));
+    cookie = 0;
+    eof = false;
+
+    while (!eof) {
+        req = nct_req_alloc(mnt);
+        nct_nfs_readdirplus3_encode(req, dvn, cookie, verf);
+
+        if (!nct_mnt_call(req)) {
+            nct_req_free(req);
+            break;
+        }
+
+        nct_msg_results(req->req_msg, &xb, heap, heapsz);
+
+        if (!nct_xdr_decode_readdirplus3_res(&xb, &res)) {
+            eprint("readdirplus3 of %s reply truncated\n", dvn->xvn_name);
+            nct_req_free(req);
+            break;
+        }
+
+        if (res.status != NFS3_OK) {
+            eprint("readdirplus3 of %s failed: %s\n",
+                   dvn->xvn_name, strerror_nfsstat3(res.status));
+            nct_req_free(req);
+            break;
+        }
+
+        memcpy(verf, res.u.resok.cookieverf, sizeof(verf));
+        eof = res.u.resok.reply.eof;
+
+        if (!res.u.resok.reply.entries && !eof) {
+            eprint("readdirplus3 of %s returned no entries\n", dvn->xvn_name);
+            nct_req_free(req);
+            break;
+        }
+
+        for (ent = res.u.resok.reply.entries; ent; ent = ent->nextentry) {
+            cookie = ent->cookie;
+
+            if (fnmatch(pattern, ent->name, FNM_PERIOD))
+                continue;
+
+            if (ent->name_handle.handle_follows &&
+                ent->name_attributes.attributes_follow) {
+                fh.fhandle3_len = ent->name_handle.u.handle.data.data_len;
+                fh.fhandle3_val = ent->name_handle.u.handle.data.data_val;
+
+                vn = nct_vn_insert(mnt->mnt_vncache, dvn, ent->name, &fh,
+                                   &ent->name_attributes.u.attributes);
+                if (!vn)
+                    continue;
+            }
+            else {
+                vn = nct_mnt_lookup(mnt, dvn, ent->name);
+                if (!vn)
+                    continue;
+            }
+
+            if (vn->xvn_type != NF3REG)
+                continue;
+
+            nct_mnt_target(mnt, vn);
+        }
+
+        nct_req_free(req);
+    }
+
+    free(heap);
+
+    return eof;
+}
+
+/* Resolve mnt_path into the targets of the jobs.  MOUNT is tried on the
+ * full path first and then on successively shorter prefixes of it, the
+ * components below the mounted prefix then being looked up one at a
+ * time.  If the final component contains shell wildcards the targets
+ * are the regular files of its directory that match it, and if the path
+ * ends in a slash they are all the regular files of the directory it
+ * names.  Otherwise the node named by the path is the sole target.
+ * mnt_vn is left referring to the last node resolved.  All the nodes
+ * resolved along the way remain in the mount's vnode cache.
+ */
+static void
+nct_mnt_resolve(nct_mnt_t *mnt)
+{
+    enum mountstat3 stat, first;
+    char *path, *pattern;
+    char *name, *save;
+    bool expand;
+    nct_vn_t *vn;
+    size_t len;
+    char *pc;
+
+    path = strdup(mnt->mnt_path);
+    if (!path)
+        abort();
+
+    len = strlen(path);
+    expand = (len > 1 && path[len - 1] == '/');
+    while (len > 1 && path[len - 1] == '/')
+        path[--len] = '\000';
+
+    pattern = NULL;
+    pc = strrchr(path, '/');
+    if (pc && strpbrk(pc + 1, "*?[")) {
+        pattern = strdup(pc + 1);
+        if (!pattern)
+            abort();
+
+        if (pc == path)
+            ++pc;
+        *pc = '\000';
+        expand = true;
+    }
+
+    /* MOUNT modifies nothing but mnt_vn, so the path is truncated in
+     * place and restored a component at a time for the lookups.
+     */
+    len = strlen(path);
+    first = MNT3_OK;
+
+    while ((stat = nct_nfs_mount(mnt, path)) != MNT3_OK) {
+        if (first == MNT3_OK)
+            first = stat;
+
+        pc = strrchr(path, '/');
+        if (!pc)
+            nct_nfs_mount_exit(mnt, first);
+
+        /* Try the root of the server's namespace last (e.g., for a
+         * server that exports only its root), in which case the whole
+         * path is looked up.
+         */
+        if (pc == path) {
+            if (path[1] == '\000' || nct_nfs_mount(mnt, "/") != MNT3_OK)
+                nct_nfs_mount_exit(mnt, first);
+
+            *pc = '\000';
+            break;
+        }
+
+        *pc = '\000';
+    }
+
+    name = path + strlen(path);
+    for (pc = name; pc < path + len; ++pc) {
+        if (*pc == '\000')
+            *pc = '/';
+    }
+
+    vn = mnt->mnt_vn;
+
+    for (name = strtok_r(name, "/", &save); name; name = strtok_r(NULL, "/", &save)) {
+        vn = nct_mnt_lookup(mnt, vn, name);
+        if (!vn)
+            exit(EX_DATAERR);
+
+        mnt->mnt_vn = vn;
+    }
+
+    if (expand) {
+        if (!nct_mnt_readdir(mnt, vn, pattern ? pattern : "*"))
+            exit(EX_IOERR);
+
+        if (mnt->mnt_vnc == 0) {
+            eprint("no regular files match %s:%s\n", mnt->mnt_server, mnt->mnt_path);
+            exit(EX_DATAERR);
+        }
+    }
+    else {
+        nct_mnt_target(mnt, vn);
+    }
+
+    free(pattern);
+    free(path);
+}
+
+/* Return the size of the smallest target file.
+ */
+uint64_t
+nct_mnt_size(nct_mnt_t *mnt)
+{
+    uint64_t size = UINT64_MAX;
+    u_int i;
+
+    for (i = 0; i < mnt->mnt_vnc; ++i) {
+        if (mnt->mnt_vnv[i]->xvn_size < size)
+            size = mnt->mnt_vnv[i]->xvn_size;
+    }
+
+    return (size == UINT64_MAX) ? 0 : size;
+}
+
 /* 1) Create a mount object
- * 2) Connect to the specified filer
+ * 2) Open conns_max connections to the specified filer
  * 3) Start the send/recv request loops
- * 4) Retrieve the file handle of the last component in the specified path
- * 5) Retrieve the attributes for the file handle from (4)
+ * 4) Resolve the specified path into the target files of the jobs
+ * 5) Retrieve the attributes of the node named by the path
  *
  * Where path is:  [user@]host[:/export...]
  */
 nct_mnt_t *
-nct_mount(const char *path, in_port_t port, u_int tds_max, u_int jobs_max)
+nct_mount(const char *path, in_port_t port, u_int conns_max,
+          u_int tds_max, u_int jobs_max, u_int reqs_max,
+          size_t msgsz, u_int flags)
 {
     struct hostent *hent;
+    nct_conn_t *conn;
     nct_mnt_t *mnt;
     nct_req_t *req;
     size_t mntsz;
@@ -124,7 +718,31 @@ nct_mount(const char *path, in_port_t port, u_int tds_max, u_int jobs_max)
     mnt->mnt_user = "root";
     mnt->mnt_port = port;
     mnt->mnt_path = "/";
-    mnt->mnt_fd = -1;
+    mnt->mnt_flags = flags;
+    mnt->mnt_epfd = -1;
+    mnt->mnt_efd = -1;
+
+#if !__linux__
+    if (flags & NCT_MNT_EPOLL) {
+        eprint("the epoll engine is not supported on this platform\n");
+        free(mnt);
+        return NULL;
+    }
+#endif
+
+    /* The io_uring engine always coalesces the requests queued on
+     * a connection into a single sendmsg, so it has no sender thread.
+     */
+    if (flags & NCT_MNT_URING)
+        mnt->mnt_flags &= ~NCT_MNT_SENDQ;
+
+#if !HAVE_IO_URING
+    if (flags & NCT_MNT_URING) {
+        eprint("the io_uring engine is not supported by this build\n");
+        free(mnt);
+        return NULL;
+    }
+#endif
 
     pc = strchr(mnt->mnt_args, '@');
     if (pc) {
@@ -181,19 +799,44 @@ nct_mount(const char *path, in_port_t port, u_int tds_max, u_int jobs_max)
         return NULL;
     }
 
-    rc = nct_connect(mnt);
-    if (rc) {
-        eprint("nct_connect() failed: %s\n", strerror(rc));
+    if (conns_max < 1)
+        conns_max = 1;
+
+    mnt->mnt_connv = aligned_alloc(__alignof(*conn), sizeof(*conn) * conns_max);
+    if (!mnt->mnt_connv) {
+        eprint("aligned_alloc(%zu) failed\n", sizeof(*conn) * conns_max);
         auth_destroy(mnt->mnt_auth);
         free(mnt);
         return NULL;
     }
 
-    rc = pthread_mutex_init(&mnt->mnt_send_mtx, NULL);
-    rc = pthread_cond_init(&mnt->mnt_send_cv, NULL);
+    memset(mnt->mnt_connv, 0, sizeof(*conn) * conns_max);
+    mnt->mnt_conns_max = conns_max;
+    mnt->mnt_conns_used = conns_max;
+    mnt->mnt_conns_live = conns_max;
+
+    for (i = 0; i < conns_max; ++i) {
+        conn = mnt->mnt_connv + i;
+
+        conn->conn_mnt = mnt;
+        conn->conn_idx = i;
+        conn->conn_fd = -1;
+        conn->conn_sinkpipe[0] = conn->conn_sinkpipe[1] = -1;
 
-    rc = pthread_mutex_init(&mnt->mnt_recv_mtx, NULL);
-    rc = pthread_spin_init(&mnt->mnt_stats_spin, PTHREAD_PROCESS_PRIVATE);
+        rc = nct_connect(conn);
+        if (rc) {
+            eprint("nct_connect() failed: %s\n", strerror(rc));
+            while (i-- > 0)
+                close(mnt->mnt_connv[i].conn_fd);
+            auth_destroy(mnt->mnt_auth);
+            free(mnt->mnt_connv);
+            free(mnt);
+            return NULL;
+        }
+
+        rc = pthread_mutex_init(&conn->conn_send_mtx, NULL);
+        rc = pthread_mutex_init(&conn->conn_recv_mtx, NULL);
+    }
 
     rc = pthread_mutex_init(&mnt->mnt_wait_mtx, NULL);
     rc = pthread_cond_init(&mnt->mnt_wait_cv, NULL);
@@ -201,23 +844,122 @@ nct_mount(const char *path, in_port_t port, u_int tds_max, u_int jobs_max)
     rc = pthread_mutex_init(&mnt->mnt_req_mtx, NULL);
     rc = pthread_cond_init(&mnt->mnt_req_cv, NULL);
 
-    if (tds_max > NELEM(mnt->mnt_recv_tdv))
-        tds_max = NELEM(mnt->mnt_recv_tdv);
+    if (tds_max < 1)
+        tds_max = 1;
+
+    mnt->mnt_tdv = calloc(tds_max, sizeof(*mnt->mnt_tdv));
+    if (!mnt->mnt_tdv)
+        abort();
+
+    for (i = 0; i < conns_max; ++i) {
+        conn = mnt->mnt_connv + i;
+
+        conn->conn_recv_tdv = calloc(tds_max, sizeof(*conn->conn_recv_tdv));
+        if (!conn->conn_recv_tdv)
+            abort();
+    }
+
+    /* Every job needs a request, and the pool should be able to grow
+     * well beyond that when requests are issued asynchronously.
+     */
+    if (reqs_max < NCT_REQ_MAX)
+        reqs_max = NCT_REQ_MAX;
+    if (reqs_max < jobs_max + NCT_REQ_CHUNK)
+        reqs_max = jobs_max + NCT_REQ_CHUNK;
 
     mnt->mnt_jobs_max = jobs_max;
     mnt->mnt_tds_max = tds_max;
+    mnt->mnt_reqs_max = reqs_max;
+
+    if (msgsz < NCT_MSGSZ_MIN)
+        msgsz = NCT_MSGSZ_MIN;
+    mnt->mnt_msgsz = msgsz;
+
+    mnt->mnt_vncache = nct_vncache_create();
+    if (!mnt->mnt_vncache) {
+        eprint("nct_vncache_create() failed\n");
+        abort();
+    }
 
     nct_req_create(mnt);
 
-    for (i = 0; i < tds_max; ++i) {
-        rc = pthread_create(&mnt->mnt_recv_tdv[i], NULL, nct_req_recv_loop, mnt);
+    if (mnt->mnt_flags & NCT_MNT_SENDQ) {
+        for (i = 0; i < conns_max; ++i) {
+            conn = mnt->mnt_connv + i;
+
+            rc = pthread_mutex_init(&conn->conn_sq_mtx, NULL);
+            rc = pthread_cond_init(&conn->conn_sq_cv, NULL);
+
+            rc = pthread_create(&conn->conn_send_td, NULL, nct_req_send_loop, conn);
+            if (rc) {
+                eprint("pthread_create() failed: %s\n", strerror(errno));
+                abort();
+            }
+        }
+    }
+
+#if __linux__
+    if (flags & NCT_MNT_EPOLL) {
+        struct epoll_event event;
+
+        mnt->mnt_epfd = epoll_create1(EPOLL_CLOEXEC);
+        mnt->mnt_efd = eventfd(0, EFD_CLOEXEC);
+        if (mnt->mnt_epfd == -1 || mnt->mnt_efd == -1) {
+            eprint("epoll_create1/eventfd failed: %s\n", strerror(errno));
+            abort();
+        }
+
+        /* The eventfd is signaled once all connections have been
+         * closed in order to terminate the epoll threads.
+         */
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+
+        rc = epoll_ctl(mnt->mnt_epfd, EPOLL_CTL_ADD, mnt->mnt_efd, &event);
+        if (rc) {
+            eprint("epoll_ctl() failed: %s\n", strerror(errno));
+            abort();
+        }
+
+        for (i = 0; i < conns_max; ++i)
+            nct_req_epoll_add(mnt->mnt_connv + i);
+
+        for (i = 0; i < tds_max; ++i) {
+            rc = pthread_create(&mnt->mnt_tdv[i], NULL, nct_req_epoll_loop, mnt);
+            if (rc) {
+                eprint("pthread_create() failed: %s\n", strerror(errno));
+                abort();
+            }
+        }
+
+        tds_max = 0;
+    }
+#endif
+
+#if HAVE_IO_URING
+    if (flags & NCT_MNT_URING) {
+        rc = nct_req_uring_start(mnt);
+        if (rc) {
+            eprint("unable to start the io_uring engine: %s\n", strerror(rc));
+            abort();
+        }
+
+        tds_max = 0;
+    }
+#endif
+
+    for (i = 0; i < conns_max * tds_max; ++i) {
+        conn = mnt->mnt_connv + (i % conns_max);
+
+        rc = pthread_create(&conn->conn_recv_tdv[i / conns_max], NULL,
+                            nct_req_recv_loop, conn);
         if (rc) {
             eprint("pthread_create() failed: %s\n", strerror(errno));
             abort();
         }
     }
 
-    nct_nfs_mount(mnt);
+    nct_mnt_resolve(mnt);
     nct_mnt_print(mnt);
 
     /* Get the attributes
@@ -236,39 +978,71 @@ nct_mount(const char *path, in_port_t port, u_int tds_max, u_int jobs_max)
     }
 
     getattr3_res res;
+    nct_xbuf_t xb;
     bool_t ok;
 
-    ok = nct_xdr_getattr3_decode(&req->req_msg->msg_xdr, &res);
-    if (ok) {
-        mnt->mnt_vn->xvn_fattr = res.u.resok.obj_attributes;
+    nct_msg_results(req->req_msg, &xb, NULL, 0);
+
+    ok = nct_xdr_decode_getattr3_res(&xb, &res);
+    if (ok && res.status == NFS3_OK) {
+        fattr3 *attr = &res.u.resok.obj_attributes;
+
+        nct_vn_setattr(mnt->mnt_vn, attr);
 
         dprint(1, "  File: \"%s\"\n",
                mnt->mnt_vn->xvn_name);
 
         dprint(1, "  Size: %lu    FileType: %u\n",
-               mnt->mnt_vn->xvn_fattr.size,
-               mnt->mnt_vn->xvn_fattr.type);
+               attr->size, attr->type);
 
-        dprint(1, "  Mode: (%03lo/%s): (%lu/%s)  Gid: (%lu/%s)\n",
-               mnt->mnt_vn->xvn_fattr.mode, "?",
-               mnt->mnt_vn->xvn_fattr.uid, "?",
-               mnt->mnt_vn->xvn_fattr.gid, "?");
+        dprint(1, "  Mode: (%03o/%s): (%u/%s)  Gid: (%u/%s)\n",
+               attr->mode, "?", attr->uid, "?", attr->gid, "?");
 
         dprint(1, "  Device: %u,%u  Inode: %lu  Links: %u\n",
-               0, 0,
-               mnt->mnt_vn->xvn_fattr.fileid,
-               (uint)mnt->mnt_vn->xvn_fattr.nlink);
+               0, 0, attr->fileid, (uint)attr->nlink);
 
     } else {
-        eprint("getattr3 decode of %s:%s failed: %d\n",
-               mnt->mnt_server, mnt->mnt_path, res.status);
+        eprint("getattr3 of %s:%s failed: %s\n",
+               mnt->mnt_server, mnt->mnt_path,
+               ok ? strerror_nfsstat3(res.status) : "reply truncated");
         abort();
     }
 
     nct_req_free(req);
 
-    memset(&mnt->mnt_stats, 0, sizeof(mnt->mnt_stats));
-    mnt->mnt_stats.latency_min = UINT64_MAX;
+    /* Get the server's preferred and max transfer sizes.
+     */
+    req = nct_req_alloc(mnt);
+    req->req_tsc_start = rdtsc();
+    nct_nfs_fsinfo3_encode(req);
+    nct_req_send(req);
+    nct_req_wait(req);
+
+    if (req->req_msg->msg_stat == RPC_SUCCESS) {
+        fsinfo3_res fsres;
+        nct_xbuf_t xb;
+
+        nct_msg_results(req->req_msg, &xb, NULL, 0);
+
+        if (nct_xdr_decode_fsinfo3_res(&xb, &fsres) && fsres.status == NFS3_OK) {
+            mnt->mnt_rtmax = fsres.u.resok.rtmax;
+            mnt->mnt_rtpref = fsres.u.resok.rtpref;
+            mnt->mnt_wtmax = fsres.u.resok.wtmax;
+            mnt->mnt_wtpref = fsres.u.resok.wtpref;
+
+            dprint(1, "  rtmax %u  rtpref %u  wtmax %u  wtpref %u\n",
+                   mnt->mnt_rtmax, mnt->mnt_rtpref,
+                   mnt->mnt_wtmax, mnt->mnt_wtpref);
+        }
+    }
+
+    if (mnt->mnt_rtmax == 0)
+        dprint(1, "fsinfo of %s:%s failed, transfer sizes unknown\n",
+               mnt->mnt_server, mnt->mnt_path);
+
+    nct_req_free(req);
+
+    nct_mnt_stats_zero(mnt);
 
     return mnt;
 }
@@ -276,49 +1050,129 @@ nct_mount(const char *path, in_port_t port, u_int tds_max, u_int jobs_max)
 void
 nct_umount(nct_mnt_t *mnt)
 {
+    nct_conn_t *conn;
     void *val;
-    int i, rc;
+    int i, j, rc;
 
-    shutdown(mnt->mnt_fd, SHUT_RDWR);
+    for (i = 0; i < mnt->mnt_conns_max; ++i)
+        shutdown(mnt->mnt_connv[i].conn_fd, SHUT_RDWR);
 
-    pthread_cond_broadcast(&mnt->mnt_send_cv);
     pthread_cond_broadcast(&mnt->mnt_wait_cv);
 
-    for (i = 0; i < NELEM(mnt->mnt_recv_tdv); ++i) {
-        if (mnt->mnt_recv_tdv[i]) {
-            rc = pthread_join(mnt->mnt_recv_tdv[i], &val);
+    if (mnt->mnt_efd != -1) {
+        uint64_t one = 1;
+
+        if (write(mnt->mnt_efd, &one, sizeof(one)) != sizeof(one))
+            eprint("eventfd write failed: %s\n", strerror(errno));
+    }
+
+    for (i = 0; i < mnt->mnt_tds_max; ++i) {
+        if (mnt->mnt_tdv[i]) {
+            rc = pthread_join(mnt->mnt_tdv[i], &val);
             if (rc) {
                 eprint("pthread_join: %d\n", rc);
             }
         }
     }
 
+    if (mnt->mnt_epfd != -1)
+        close(mnt->mnt_epfd);
+    if (mnt->mnt_efd != -1)
+        close(mnt->mnt_efd);
+
+#if HAVE_IO_URING
+    nct_req_uring_destroy(mnt);
+#endif
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i) {
+        conn = mnt->mnt_connv + i;
+
+        if (mnt->mnt_flags & NCT_MNT_SENDQ) {
+            pthread_mutex_lock(&conn->conn_sq_mtx);
+            conn->conn_sq_stop = true;
+            pthread_cond_signal(&conn->conn_sq_cv);
+            pthread_mutex_unlock(&conn->conn_sq_mtx);
+
+            rc = pthread_join(conn->conn_send_td, &val);
+            if (rc) {
+                eprint("pthread_join: %d\n", rc);
+            }
+
+            pthread_cond_destroy(&conn->conn_sq_cv);
+            pthread_mutex_destroy(&conn->conn_sq_mtx);
+        }
+
+        for (j = 0; j < mnt->mnt_tds_max; ++j) {
+            if (conn->conn_recv_tdv[j]) {
+                rc = pthread_join(conn->conn_recv_tdv[j], &val);
+                if (rc) {
+                    eprint("pthread_join: %d\n", rc);
+                }
+            }
+        }
+
+        free(conn->conn_recv_tdv);
+        close(conn->conn_fd);
+
+        if (conn->conn_sinkpipe[0] != -1) {
+            close(conn->conn_sinkpipe[0]);
+            close(conn->conn_sinkpipe[1]);
+        }
+
+        pthread_mutex_destroy(&conn->conn_recv_mtx);
+        pthread_mutex_destroy(&conn->conn_send_mtx);
+    }
+
+    nct_req_mag_flush(mnt);
+    nct_req_destroy(mnt);
+
+    while (mnt->mnt_shard_head) {
+        nct_shard_t *shard = mnt->mnt_shard_head;
+
+        mnt->mnt_shard_head = shard->shard_next;
+
+        for (i = 0; i < NCT_PROC_MAX; ++i)
+            free(shard->shard_histv[i]);
+        free(shard);
+    }
+
     auth_destroy(mnt->mnt_auth);
-    close(mnt->mnt_fd);
 
-    nct_vn_free(mnt->mnt_vn);
+    free(mnt->mnt_vnv);
+    nct_vncache_destroy(mnt->mnt_vncache);
 
     pthread_mutex_destroy(&mnt->mnt_req_mtx);
     pthread_mutex_destroy(&mnt->mnt_wait_mtx);
-    pthread_spin_destroy(&mnt->mnt_stats_spin);
-    pthread_mutex_destroy(&mnt->mnt_recv_mtx);
-    pthread_mutex_destroy(&mnt->mnt_send_mtx);
 
+    free(mnt->mnt_connv);
+    free(mnt->mnt_tdv);
     free(mnt);
 }
 
 void
 nct_mnt_print(nct_mnt_t *mnt)
 {
+    int i;
+
     dprint(1, "hostname %s\n", mnt->mnt_hostname);
     dprint(1, "server   %s\n", mnt->mnt_server);
     dprint(1, "path     %s\n", mnt->mnt_path);
     dprint(1, "user     %s\n", mnt->mnt_user);
     dprint(1, "port     %u\n", mnt->mnt_port);
-    dprint(1, "fd       %d\n", mnt->mnt_fd);
     dprint(1, "auth     %p\n", mnt->mnt_auth);
     dprint(1, "jobs_max %d\n", mnt->mnt_jobs_max);
+    dprint(1, "reqs_max %u\n", mnt->mnt_reqs_max);
     dprint(1, "jobs_cnt %d\n", mnt->mnt_jobs_cnt);
-    dprint(1, "xid      %u\n", mnt->mnt_send_xid);
-    dprint(1, "mark     %u\n", mnt->mnt_recv_mark);
+    dprint(1, "conns    %u\n", mnt->mnt_conns_max);
+    dprint(1, "msgsz    %zu\n", mnt->mnt_msgsz);
+    dprint(1, "targets  %u\n", mnt->mnt_vnc);
+    dprint(1, "vnodes   %zu (%zu bytes)\n",
+           mnt->mnt_vncache->vc_namecnt, mnt->mnt_vncache->vc_bytes);
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i) {
+        nct_conn_t *conn = mnt->mnt_connv + i;
+
+        dprint(1, "conn %-3u fd %d  xid %u\n",
+               conn->conn_idx, conn->conn_fd, conn->conn_send_xid);
+    }
 }
@@ -29,6 +29,7 @@
 #include "nct_nfstypes.h"
 #include "nct_vnode.h"
 #include "nct_req.h"
+#include "nct_hist.h"
 
 struct nct_stats {
     uint64_t            latency_min;  // Min latency of completed requests
@@ -38,18 +39,171 @@ struct nct_stats {
     uint64_t            thruput_send;
     uint64_t            thruput_recv;
     uint64_t            updates;
-    uint64_t            marks;
+    uint64_t            recvs;        // Number of receives (i.e., recv syscalls)
+    uint64_t            strays;       // Replies that matched no request
+    uint64_t            collisions;   // xids skipped due to a busy table slot
+    uint64_t            zc_sends;     // Sends completed with MSG_ZEROCOPY
+    uint64_t            zc_copied;    // ... for which the kernel copied anyway
 };
 
-typedef struct nct_mnt_s {
-    pthread_mutex_t     mnt_send_mtx;
-    uint32_t            mnt_send_xid;
-    pthread_cond_t      mnt_send_cv;
+/* Stats are kept per NFSv3 procedure (indexed by procedure number),
+ * with requests of all other programs lumped into NCT_PROC_OTHER.
+ */
+#define NCT_PROC_OTHER      (NFS3_COMMIT + 1)
+#define NCT_PROC_MAX        (NCT_PROC_OTHER + 1)
+
+/* Each thread that completes requests accumulates its stats into its
+ * own shard, which it creates upon its first completion and links
+ * onto its mount's list of shards.  Only the owner updates a shard,
+ * so it needs neither locks nor atomics, but it bumps shard_seq before
+ * and after each update so that the stats thread can take consistent
+ * snapshots (seqlock style).  Counters are kept per connection and per
+ * procedure, while the min and max latencies cover only the completions
+ * made since the stats thread last advanced the mount's stats epoch.
+ * The latency histogram of each procedure is allocated (and published)
+ * by the owner upon the first completion of that procedure.
+ */
+typedef struct nct_shard_s {
+    u_int               shard_seq;              // Odd while an update is in progress
+    u_int               shard_epoch;            // Epoch of latency min/max
+    uint64_t            shard_latency_min;
+    uint64_t            shard_latency_max;
+    struct nct_shard_s *shard_next;
+    u_int               shard_idx;
+    struct nct_stats    shard_base;             // Stats excluded from reports
+    nct_hist_t         *shard_histv[NCT_PROC_MAX]; // Latencies by procedure
+    struct nct_stats    shard_procv[NCT_PROC_MAX];
+    struct nct_stats    shard_connv[];          // Indexed by conn_idx
+} nct_shard_t;
+
+static inline void
+nct_shard_enter(nct_shard_t *shard)
+{
+    __atomic_store_n(&shard->shard_seq, shard->shard_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void
+nct_shard_leave(nct_shard_t *shard)
+{
+    __atomic_store_n(&shard->shard_seq, shard->shard_seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Each region of memory mapped for a mount (request pool chunks,
+ * in-flight request tables, and receive buffers) is recorded on the
+ * mount's list of regions so that nct_umount() can unmap it.
+ */
+typedef struct nct_region_s {
+    struct nct_region_s *rgn_next;
+    void               *rgn_base;
+    size_t              rgn_sz;
+} nct_region_t;
+
+/* Each connection to the server has its own socket, xid space,
+ * in-flight request table, and recv threads.
+ */
+typedef struct nct_conn_s {
+    pthread_mutex_t     conn_send_mtx;
+    uint32_t            conn_send_xid;          // Next xid (atomic)
+    uint64_t            conn_send_collisions;   // Busy table slots skipped (atomic)
+    bool                conn_zerocopy;          // SO_ZEROCOPY is enabled
+    uint64_t            conn_zc_sends;          // Zerocopy sends reaped (atomic)
+    uint64_t            conn_zc_copied;         // ... that were copied (atomic)
 
     __aligned(64)
-    pthread_mutex_t     mnt_recv_mtx;
-    uint32_t            mnt_recv_mark;
+    pthread_mutex_t     conn_recv_mtx;
 
+    struct nct_stats    conn_stats_base;        // Stats excluded from reports
+
+    /* Receive state, protected by conn_recv_mtx in the threads engine
+     * and private to the thread that owns the connection otherwise.
+     * Replies are read in large chunks into conn_rxbuf, from which
+     * they are assembled into conn_rxmsg.
+     */
+    __aligned(64)
+    char               *conn_rxbuf;             // Receive buffer (NCT_RXBUF_SZ)
+    size_t              conn_rxhead;            // Next byte to parse in conn_rxbuf
+    size_t              conn_rxtail;            // End of data in conn_rxbuf
+    u_int               conn_rxmode;            // Target of the next receive
+    bool                conn_rxsplice;          // Sink by splicing into conn_rxsinkfd
+    bool                conn_rxlast;            // Current fragment is the last
+    nct_msg_t          *conn_rxmsg;             // Reply being assembled
+    size_t              conn_rxlen;             // Bytes assembled into conn_rxmsg
+    size_t              conn_rxfrag;            // Bytes remaining in fragment
+    struct nct_stats    conn_rxstats;           // Not yet folded into a shard
+
+    /* Payload sink state of the reply being assembled (see req_sink).
+     */
+    u_int               conn_rxsinkst;          // NCT_RX_SINK_*
+    size_t              conn_rxsink;            // Payload bytes (incl. pad) left to sink
+    size_t              conn_rxsinkdata;        // Payload data bytes left to sink
+    size_t              conn_rxskip;            // Payload bytes sunk from this reply
+    int                 conn_rxsinkfd;          // File into which to write the payload
+    off_t               conn_rxsinkoff;         // Offset in conn_rxsinkfd
+    int                 conn_sinkpipe[2];       // For splicing into conn_rxsinkfd
+    size_t              conn_sinkpipesz;
+
+    /* Send state used by the io_uring engine and the sender thread.
+     * conn_txhead is protected by conn_send_mtx, the rest is private
+     * to the thread that owns the connection (conn_uring) or to the
+     * sender thread.
+     */
+    __aligned(64)
+    nct_req_t          *conn_txhead;            // Requests waiting to be sent
+    nct_req_t          *conn_txtail;
+    void               *conn_uring;             // Owning io_uring engine thread
+    bool                conn_txbusy;            // A sendmsg is in progress
+    int                 conn_txflags;           // Flags of the sendmsg in progress
+    u_int               conn_txgen;             // conn_gen of the sendmsg in progress
+    bool                conn_eof;
+    struct msghdr       conn_txhdr;
+    struct iovec        conn_txiov[64];
+
+    /* Send queue of the sender thread (NCT_MNT_SENDQ).  Requests are
+     * pushed onto conn_sq_head without a lock and taken off all at
+     * once by the sender thread, which sleeps on conn_sq_cv only when
+     * the queue is empty.
+     */
+    __aligned(64)
+    nct_req_t          *conn_sq_head;           // Requests to send, newest first
+    bool                conn_sq_sleeping;       // Sender is waiting on conn_sq_cv
+    bool                conn_sq_stop;           // Sender thread should exit
+    pthread_mutex_t     conn_sq_mtx;
+    pthread_cond_t      conn_sq_cv;
+    pthread_t           conn_send_td;
+
+    __aligned(64)
+    int                 conn_fd;
+    u_int               conn_gen;               // Incremented by each reconnect
+    bool                conn_broken;            // Shut down after a failed send
+    u_int               conn_idx;
+    nct_slot_t         *conn_req_tbl;           // Indexed by xid & conn_req_mask
+    uint32_t            conn_req_mask;
+    struct nct_mnt_s   *conn_mnt;
+    pthread_t          *conn_recv_tdv;          // Recv threads (mnt_tds_max)
+} nct_conn_t;
+
+/* conn_rxmode values
+ */
+#define NCT_RX_BUF          (0)                 // Receive into conn_rxbuf
+#define NCT_RX_DIRECT       (1)                 // Receive into conn_rxmsg
+#define NCT_RX_SINK         (2)                 // Discard or splice the payload
+
+/* conn_rxsinkst values
+ */
+#define NCT_RX_SINK_UNKNOWN (0)                 // Reply header not yet parsed
+#define NCT_RX_SINK_ACTIVE  (1)                 // Payload is being sunk
+#define NCT_RX_SINK_NONE    (2)                 // Reply has no payload to sink
+
+/* nct_mount() flags
+ */
+#define NCT_MNT_EPOLL       (0x0001u)           // Use the epoll engine
+#define NCT_MNT_URING       (0x0002u)           // Use the io_uring engine
+#define NCT_MNT_SENDQ       (0x0004u)           // Send via a sender thread per conn
+#define NCT_MNT_REUSE       (0x0008u)           // Keep conns open when all jobs finish
+#define NCT_MNT_ZEROCOPY    (0x0010u)           // Send payloads with MSG_ZEROCOPY
+
+typedef struct nct_mnt_s {
     __aligned(64)
     pthread_mutex_t     mnt_wait_mtx;
     int                 mnt_wait_waiters;
@@ -58,22 +212,43 @@ typedef struct nct_mnt_s {
     __aligned(64)
     pthread_mutex_t     mnt_req_mtx;
     nct_req_t          *mnt_req_head;           // List of free reqs
-    nct_req_t         **mnt_req_tbl;            // Indexed by req_idx
     int                 mnt_req_waiters;
     pthread_cond_t      mnt_req_cv;
-
-    __aligned(64)
-    pthread_spinlock_t  mnt_stats_spin;
-    struct nct_stats    mnt_stats;
+    u_int               mnt_conn_next;          // Next conn for nct_req_alloc() (atomic)
+    u_int               mnt_reqs_cnt;           // Number of reqs in the pool
+    u_int               mnt_reqs_max;           // Max size of the pool
+    bool                mnt_req_growing;        // nct_req_grow() is mapping a chunk
 
     __aligned(64)
     u_int               mnt_jobs_max;
     u_int               mnt_jobs_cnt;
-    u_int               mnt_tds_max;
+    u_int               mnt_tds_max;            // Recv threads per connection
+    u_int               mnt_conns_max;
+    u_int               mnt_conns_used;         // Conns used by nct_req_alloc()
+    u_int               mnt_conns_live;         // Open conns (epoll engine)
+    u_int               mnt_flags;
+    nct_conn_t         *mnt_connv;
+    int                 mnt_epfd;               // epoll fd (epoll engine)
+    int                 mnt_efd;                // eventfd (epoll engine)
+    void               *mnt_uringv;             // Per-thread rings (io_uring engine)
+    size_t              mnt_msgsz;              // Size of each msg_data[]
+    void               *mnt_msgbase;            // Message buffers from nct_req_create()
+    size_t              mnt_msgbasesz;
+    void               *mnt_rxbase;             // Receive buffers of all conns
+    size_t              mnt_rxbasesz;
+    nct_region_t       *mnt_region_head;        // Regions mapped by nct_req.c
+    nct_shard_t        *mnt_shard_head;         // Stats shards of recv threads
+    u_int               mnt_shards_cnt;
+    u_int               mnt_stats_epoch;        // Epoch of shard latency min/max
+    struct nct_stats    mnt_procbase[NCT_PROC_MAX]; // Stats excluded from reports
+    struct nct_pace_s  *mnt_pace;               // Open-loop pacer (or NULL)
+    struct nct_win_s   *mnt_win;                // Window controller (or NULL)
 
     __aligned(64)
-    int                 mnt_fd;
-    nct_vn_t           *mnt_vn;
+    nct_vncache_t      *mnt_vncache;
+    nct_vn_t           *mnt_vn;                 // Node named by mnt_path
+    nct_vn_t          **mnt_vnv;                // Target files of the jobs
+    u_int               mnt_vnc;
     AUTH               *mnt_auth;
     char               *mnt_server;             // NFS server host name
     char                mnt_serverip[INET_ADDRSTRLEN + 1];
@@ -81,16 +256,29 @@ typedef struct nct_mnt_s {
     char               *mnt_user;               // NFS server user name
     in_port_t           mnt_port;
     struct sockaddr_in  mnt_faddr;              // Foriegn/filer address
+    uint32_t            mnt_rtmax;              // Max READ size (from FSINFO)
+    uint32_t            mnt_rtpref;             // Preferred READ size
+    uint32_t            mnt_wtmax;              // Max WRITE size
+    uint32_t            mnt_wtpref;             // Preferred WRITE size
 
     char                mnt_hostname[_POSIX_HOST_NAME_MAX + 1];
-    pthread_t           mnt_recv_tdv[128];
+    pthread_t          *mnt_tdv;                // epoll/io_uring engine threads
     char                mnt_args[];
 } nct_mnt_t;
 
-extern nct_mnt_t *nct_mount(const char *path, in_port_t port, u_int tds_max, u_int jobs_max);
+extern nct_mnt_t *nct_mount(const char *path, in_port_t port, u_int conns_max,
+                            u_int tds_max, u_int jobs_max, u_int reqs_max,
+                            size_t msgsz, u_int flags);
 extern void nct_umount(nct_mnt_t *mnt);
 extern void nct_mnt_print(nct_mnt_t *mnt);
+extern uint64_t nct_mnt_size(nct_mnt_t *mnt);
 
-extern int nct_connect(nct_mnt_t *mnt);
+extern int nct_connect(nct_conn_t *conn);
+extern void nct_mnt_stats(nct_mnt_t *mnt, struct nct_stats *stats, bool reset);
+extern void nct_mnt_stats_zero(nct_mnt_t *mnt);
+extern void nct_conn_stats(nct_conn_t *conn, struct nct_stats *stats);
+extern void nct_shard_stats(nct_mnt_t *mnt, nct_shard_t *shard, struct nct_stats *stats);
+extern void nct_mnt_proc_stats(nct_mnt_t *mnt, struct nct_stats *statsv);
+extern bool nct_mnt_hist(nct_mnt_t *mnt, int proc, nct_hist_t *hist);
 
 #endif // NCT_MOUNT_H
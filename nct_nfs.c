@@ -74,8 +74,131 @@ strerror_mountstat3(enum mountstat3 stat)
     return "invalid mountstat3 value";
 }
 
-void
-nct_nfs_mount(struct nct_mnt_s *mnt)
+/* Return the name of the given NFSv3 status.  Note that the values of
+ * many nfsstat3 codes differ from those of the errnos of the same name
+ * (and some have no such errno), so they cannot be given to strerror().
+ */
+const char *
+strerror_nfsstat3(nfsstat3 stat)
+{
+    switch (stat) {
+    case NFS3_OK:
+        return "nfs3_ok";
+
+    case NFS3ERR_PERM:
+        return "nfs3err_perm";
+
+    case NFS3ERR_NOENT:
+        return "nfs3err_noent";
+
+    case NFS3ERR_IO:
+        return "nfs3err_io";
+
+    case NFS3ERR_NXIO:
+        return "nfs3err_nxio";
+
+    case NFS3ERR_ACCES:
+        return "nfs3err_acces";
+
+    case NFS3ERR_EXIST:
+        return "nfs3err_exist";
+
+    case NFS3ERR_XDEV:
+        return "nfs3err_xdev";
+
+    case NFS3ERR_NODEV:
+        return "nfs3err_nodev";
+
+    case NFS3ERR_NOTDIR:
+        return "nfs3err_notdir";
+
+    case NFS3ERR_ISDIR:
+        return "nfs3err_isdir";
+
+    case NFS3ERR_INVAL:
+        return "nfs3err_inval";
+
+    case NFS3ERR_FBIG:
+        return "nfs3err_fbig";
+
+    case NFS3ERR_NOSPC:
+        return "nfs3err_nospc";
+
+    case NFS3ERR_ROFS:
+        return "nfs3err_rofs";
+
+    case NFS3ERR_MLINK:
+        return "nfs3err_mlink";
+
+    case NFS3ERR_NAMETOOLONG:
+        return "nfs3err_nametoolong";
+
+    case NFS3ERR_NOTEMPTY:
+        return "nfs3err_notempty";
+
+    case NFS3ERR_DQUOT:
+        return "nfs3err_dquot";
+
+    case NFS3ERR_STALE:
+        return "nfs3err_stale";
+
+    case NFS3ERR_REMOTE:
+        return "nfs3err_remote";
+
+    case NFS3ERR_BADHANDLE:
+        return "nfs3err_badhandle";
+
+    case NFS3ERR_NOT_SYNC:
+        return "nfs3err_not_sync";
+
+    case NFS3ERR_BAD_COOKIE:
+        return "nfs3err_bad_cookie";
+
+    case NFS3ERR_NOTSUPP:
+        return "nfs3err_notsupp";
+
+    case NFS3ERR_TOOSMALL:
+        return "nfs3err_toosmall";
+
+    case NFS3ERR_SERVERFAULT:
+        return "nfs3err_serverfault";
+
+    case NFS3ERR_BADTYPE:
+        return "nfs3err_badtype";
+
+    case NFS3ERR_JUKEBOX:
+        return "nfs3err_jukebox";
+
+    default:
+        break;
+    }
+
+    return "invalid nfsstat3 value";
+}
+
+/* Return the name of the given procedure stats key (see NCT_PROC_MAX).
+ */
+const char *
+nct_nfs_procname(u_int proc)
+{
+    static const char *namev[] = {
+        "null", "getattr", "setattr", "lookup", "access", "readlink",
+        "read", "write", "create", "mkdir", "symlink", "mknod",
+        "remove", "rmdir", "rename", "link", "readdir", "readdirplus",
+        "fsstat", "fsinfo", "pathconf", "commit",
+    };
+
+    if (proc < NELEM(namev))
+        return namev[proc];
+
+    return "other";
+}
+
+/* Mount the given path of the export, setting mnt_vn to the root vnode
+ * of the mount if successful.  Returns the server's mount status.
+ */
+enum mountstat3
+nct_nfs_mount(struct nct_mnt_s *mnt, const char *path)
 {
     const size_t rpcmin = BYTES_PER_XDR_UNIT * 6;
     char txbuf[1024], rxbuf[1024];
@@ -83,10 +206,11 @@ nct_nfs_mount(struct nct_mnt_s *mnt)
     struct rpc_msg msg;
     struct rpc_err err;
     enum clnt_stat stat;
+    char heap[256];
     mountres3 mntres;
+    nct_xbuf_t xb;
     in_port_t port;
     ssize_t cc;
-    char *path;
     int txlen;
     XDR xdr;
     int fd;
@@ -131,11 +255,21 @@ nct_nfs_mount(struct nct_mnt_s *mnt)
     msg.rm_call.cb_vers = MOUNT_V3;
     msg.rm_call.cb_proc = MOUNT3_MNT;
 
-    path = mnt->mnt_path;
+    txlen = nct_rpc_encode(&msg, mnt->mnt_auth, txbuf, sizeof(txbuf));
+    if (txlen == -1) {
+        eprint("nct_rpc_encode() failed\n");
+        abort();
+    }
+
+    nct_xbuf_init(&xb, txbuf, sizeof(txbuf), NULL, 0);
+    xb.xb_cur += txlen;
 
-    txlen = nct_rpc_encode(&msg, mnt->mnt_auth,
-                           (xdrproc_t)nct_xdr_dirpath, &path,
-                           txbuf, sizeof(txbuf));
+    if (!nct_xdr_encode_dirpath(&xb, (char **)&path)) {
+        eprint("mount path %s too long\n", path);
+        exit(EX_DATAERR);
+    }
+
+    txlen = nct_xbuf_len(&xb);
 
     cc = nct_rpc_send(fd, txbuf, txlen);
     if (cc != txlen) {
@@ -159,65 +293,134 @@ nct_nfs_mount(struct nct_mnt_s *mnt)
         abort();
     }
 
-    if (!nct_xdr_mountres3_decode(xdr.x_private, xdr.x_handy, &mntres)) {
-        eprint("nct_xdr_mountres3_decode() failed\n");
+    /* The file handle refers to rxbuf, while the auth flavors are
+     * decoded into heap.
+     */
+    nct_xbuf_init(&xb, rxbuf + XDR_GETPOS(&xdr), cc - XDR_GETPOS(&xdr),
+                  heap, sizeof(heap));
+
+    if (!nct_xdr_decode_mountres3(&xb, &mntres)) {
+        eprint("nct_xdr_decode_mountres3() failed\n");
         abort();
     }
 
     if (mntres.fhs_status != MNT3_OK) {
-        eprint("mount %s:%s failed: %d %s\n",
-               mnt->mnt_server, mnt->mnt_path,
+        dprint(1, "mount %s:%s failed: %d %s\n",
+               mnt->mnt_server, path,
                mntres.fhs_status, strerror_mountstat3(mntres.fhs_status));
+        XDR_DESTROY(&xdr);
+        close(fd);
 
-        switch (mntres.fhs_status) {
-        case MNT3ERR_PERM:
-        case MNT3ERR_ACCES:
-            exit(EX_NOPERM);
-
-        case MNT3ERR_IO:
-            exit(EX_IOERR);
-
-        case MNT3ERR_NOENT:
-        case MNT3ERR_NOTDIR:
-        case MNT3ERR_INVAL:
-        case MNT3ERR_NAMETOOLONG:
-            exit(EX_DATAERR);
-
-        default:
-            exit(EX_PROTOCOL);
-            break;
-        }
-
-        exit(EX_OSERR);
+        return mntres.fhs_status;
     }
 
     XDR_DESTROY(&xdr);
 
-    mnt->mnt_vn = nct_vn_alloc(&mntres.mountres3_u.mountinfo.fhandle, "/", 1);
+    mnt->mnt_vn = nct_vn_insert(mnt->mnt_vncache, NULL, "/",
+                                &mntres.u.mountinfo.fhandle, NULL);
     if (!mnt->mnt_vn) {
-        eprint("nct_vn_alloc() failed\n");
+        eprint("nct_vn_insert() failed\n");
         abort();
     }
 
     if (verbosity > 0) {
+        fhandle3 *fh = &mntres.u.mountinfo.fhandle;
         char buf[136];
         int i;
 
-        for (i = 0; i < mnt->mnt_vn->xvn_fh.fhandle3_len; ++i) {
-            snprintf(buf + i*2, 3, "%02x", mnt->mnt_vn->xvn_fh.fhandle3_val[i] & 0xff);
+        for (i = 0; i < fh->fhandle3_len; ++i) {
+            snprintf(buf + i*2, 3, "%02x", fh->fhandle3_val[i] & 0xff);
         }
 
         dprint(1, "rx cc=%ld len=%u %s\n",
-               cc, mntres.mountres3_u.mountinfo.fhandle.fhandle3_len, buf);
+               cc, mntres.u.mountinfo.fhandle.fhandle3_len, buf);
     }
 
     close(fd);
+
+    return MNT3_OK;
 }
 
+/* Report a failed mount and exit with a status that reflects the
+ * server's mount status.
+ */
 void
-nct_nfs_null_encode(nct_req_t *req)
+nct_nfs_mount_exit(struct nct_mnt_s *mnt, enum mountstat3 stat)
+{
+    eprint("mount %s:%s failed: %d %s\n",
+           mnt->mnt_server, mnt->mnt_path, stat, strerror_mountstat3(stat));
+
+    switch (stat) {
+    case MNT3ERR_PERM:
+    case MNT3ERR_ACCES:
+        exit(EX_NOPERM);
+
+    case MNT3ERR_IO:
+        exit(EX_IOERR);
+
+    case MNT3ERR_NOENT:
+    case MNT3ERR_NOTDIR:
+    case MNT3ERR_INVAL:
+    case MNT3ERR_NAMETOOLONG:
+        exit(EX_DATAERR);
+
+    default:
+        exit(EX_PROTOCOL);
+        break;
+    }
+
+    exit(EX_OSERR);
+}
+
+
+/* Copy the request's template into its message buffer if the template
+ * was encoded for the given procedure and arguments.  Returns false if
+ * the call must be encoded in full.
+ */
+static inline bool
+nct_nfs_tmpl_copy(nct_req_t *req, u_int proc, const void *key, uint32_t count)
+{
+    if (req->req_tmpl_len == 0 || req->req_tmpl_proc != proc ||
+        req->req_tmpl_key != key || req->req_tmpl_count != count)
+        return false;
+
+    memcpy(req->req_msg->msg_data, req->req_tmpl, req->req_tmpl_len);
+    req->req_msg->msg_len = req->req_tmpl_len;
+    req->req_proc = proc;
+    req->req_paylen = 0;
+
+    return true;
+}
+
+/* Save the first len bytes of the call just encoded into the request's
+ * message buffer as the request's template.  The xid is patched by
+ * nct_req_send(), and the record mark by nct_rpc_send(), so they need
+ * no special treatment.
+ */
+static void
+nct_nfs_tmpl_save(nct_req_t *req, u_int proc, const void *key, uint32_t count,
+                  size_t offset, size_t len)
 {
-    //nct_mnt_t *mnt = req->req_mnt;
+    if (len > sizeof(req->req_tmpl)) {
+        req->req_tmpl_len = 0;
+        return;
+    }
+
+    memcpy(req->req_tmpl, req->req_msg->msg_data, len);
+    req->req_tmpl_proc = proc;
+    req->req_tmpl_key = key;
+    req->req_tmpl_count = count;
+    req->req_tmpl_len = len;
+    req->req_tmpl_offset = offset;
+}
+
+/* Encode the header of an NFSv3 call into the request's message buffer,
+ * and set up xb to encode the call's arguments immediately after it.
+ */
+static void
+nct_nfs_call(nct_req_t *req, u_int proc, AUTH *auth, nct_xbuf_t *xb)
+{
+    nct_mnt_t *mnt = req->req_mnt;
     struct rpc_msg msg;
     int len;
 
@@ -226,59 +429,270 @@ nct_nfs_null_encode(nct_req_t *req)
     msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
     msg.rm_call.cb_prog = NFS_PROGRAM;
     msg.rm_call.cb_vers = NFS_V3;
-    msg.rm_call.cb_proc = NFS3_NULL;
+    msg.rm_call.cb_proc = proc;
 
-    len = nct_rpc_encode(&msg, NULL,
-                         (xdrproc_t)xdr_void, NULL,
-                         req->req_msg->msg_data, NCT_MSGSZ_MAX);
+    req->req_proc = proc;
+    req->req_paylen = 0;
 
-    req->req_msg->msg_len = len;
+    len = nct_rpc_encode(&msg, auth, req->req_msg->msg_data, mnt->mnt_msgsz);
+    if (len == -1) {
+        eprint("unable to encode call header for proc %u\n", proc);
+        abort();
+    }
+
+    nct_xbuf_init(xb, req->req_msg->msg_data, mnt->mnt_msgsz, NULL, 0);
+    xb->xb_cur += len;
+}
+
+/* Finish a call whose arguments were encoded via xb (where ok is the
+ * result of the arguments' encoder).
+ */
+static void
+nct_nfs_call_done(nct_req_t *req, nct_xbuf_t *xb, bool ok)
+{
+    if (!ok) {
+        eprint("unable to encode arguments for proc %u (msgsz %zu)\n",
+               req->req_proc, ((nct_mnt_t *)req->req_mnt)->mnt_msgsz);
+        abort();
+    }
+
+    req->req_msg->msg_len = nct_xbuf_len(xb);
+}
+
+static void
+nct_nfs_fh3(nfs_fh3 *fh, const nct_vn_t *vn)
+{
+    fhandle3 fhandle;
+
+    nct_vn_fh(vn, &fhandle);
+    fh->data.data_len = fhandle.fhandle3_len;
+    fh->data.data_val = fhandle.fhandle3_val;
+}
+
+void
+nct_nfs_null_encode(nct_req_t *req)
+{
+    nct_xbuf_t xb;
+
+    if (nct_nfs_tmpl_copy(req, NFS3_NULL, NULL, 0))
+        return;
+
+    nct_nfs_call(req, NFS3_NULL, NULL, &xb);
+    nct_nfs_call_done(req, &xb, true);
+
+    nct_nfs_tmpl_save(req, NFS3_NULL, NULL, 0, 0, req->req_msg->msg_len);
 }
 
 void
 nct_nfs_getattr3_encode(nct_req_t *req)
 {
     nct_mnt_t *mnt = req->req_mnt;
-    struct rpc_msg msg;
-    int len;
+    getattr3_args args;
+    nct_xbuf_t xb;
 
-    msg.rm_xid = 0;
-    msg.rm_direction = CALL;
-    msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
-    msg.rm_call.cb_prog = NFS_PROGRAM;
-    msg.rm_call.cb_vers = NFS_V3;
-    msg.rm_call.cb_proc = NFS3_GETATTR;
+    if (nct_nfs_tmpl_copy(req, NFS3_GETATTR, req->req_vn, 0))
+        return;
+
+    nct_nfs_fh3(&args.object, req->req_vn);
 
-    len = nct_rpc_encode(&msg, mnt->mnt_auth,
-                         (xdrproc_t)nct_xdr_getattr3_encode, &mnt->mnt_vn->xvn_fh,
-                         req->req_msg->msg_data, NCT_MSGSZ_MAX);
+    nct_nfs_call(req, NFS3_GETATTR, mnt->mnt_auth, &xb);
+    nct_nfs_call_done(req, &xb, nct_xdr_encode_getattr3_args(&xb, &args));
 
-    req->req_msg->msg_len = len;
+    nct_nfs_tmpl_save(req, NFS3_GETATTR, req->req_vn, 0, 0,
+                      req->req_msg->msg_len);
 }
 
 void
 nct_nfs_read3_encode(nct_req_t *req, off_t offset, size_t length)
 {
     nct_mnt_t *mnt = req->req_mnt;
-    struct rpc_msg msg;
     read3_args args;
-    int len;
+    nct_xbuf_t xb;
+    size_t argoff;
+
+    /* Only the offset differs from the template, so patch it in place.
+     */
+    if (nct_nfs_tmpl_copy(req, NFS3_READ, req->req_vn, length)) {
+        nct_xdr_st64(req->req_msg->msg_data + req->req_tmpl_offset, offset);
+        return;
+    }
 
-    msg.rm_xid = 0;
-    msg.rm_direction = CALL;
-    msg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
-    msg.rm_call.cb_prog = NFS_PROGRAM;
-    msg.rm_call.cb_vers = NFS_V3;
-    msg.rm_call.cb_proc = NFS3_READ;
+    nct_nfs_fh3(&args.file, req->req_vn);
+    args.offset = offset;
+    args.count = length;
 
-    args.file.data.data_len = mnt->mnt_vn->xvn_fh.fhandle3_len;
-    args.file.data.data_val = mnt->mnt_vn->xvn_fh.fhandle3_val;
+    nct_nfs_call(req, NFS3_READ, mnt->mnt_auth, &xb);
+    argoff = nct_xbuf_len(&xb);
+    nct_nfs_call_done(req, &xb, nct_xdr_encode_read3_args(&xb, &args));
+
+    nct_nfs_tmpl_save(req, NFS3_READ, req->req_vn, length,
+                      argoff + nct_xdr_sizeof_nfs_fh3(&args.file),
+                      req->req_msg->msg_len);
+}
+
+/* Encode a WRITE3 call of length bytes from data, which must be
+ * followed by zeroes up to the next XDR unit (see nct_req_pattern()).
+ * Only the arguments up to and including the length of the opaque data
+ * are encoded into the message buffer (and thus into the template, in
+ * which only the offset and stable fields then need be patched), while
+ * the data itself is sent in place.
+ */
+void
+nct_nfs_write3_encode(nct_req_t *req, off_t offset, size_t length,
+                      stable_how stable, const char *data)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+    nct_msg_t *msg = req->req_msg;
+    write3_args args;
+    nct_xbuf_t xb;
+    size_t argoff;
+    char *p;
+
+    if (nct_nfs_tmpl_copy(req, NFS3_WRITE, req->req_vn, length)) {
+        p = msg->msg_data + req->req_tmpl_offset;
+
+        nct_xdr_st64(p, offset);
+        nct_xdr_st32(p + 12, stable);
+        goto payload;
+    }
+
+    nct_nfs_fh3(&args.file, req->req_vn);
     args.offset = offset;
     args.count = length;
+    args.stable = stable;
+    args.data.data_len = 0;
+    args.data.data_val = NULL;
+
+    nct_nfs_call(req, NFS3_WRITE, mnt->mnt_auth, &xb);
+    argoff = nct_xbuf_len(&xb);
+    nct_nfs_call_done(req, &xb, nct_xdr_encode_write3_args(&xb, &args));
+
+    nct_xdr_st32(msg->msg_data + msg->msg_len - BYTES_PER_XDR_UNIT, length);
+
+    nct_nfs_tmpl_save(req, NFS3_WRITE, req->req_vn, length,
+                      argoff + nct_xdr_sizeof_nfs_fh3(&args.file),
+                      msg->msg_len);
+
+  payload:
+    req->req_payload = data;
+    req->req_paylen = nct_xdr_pad(length);
+}
+
+/* Encode a COMMIT3 call for the whole file.
+ */
+void
+nct_nfs_commit3_encode(nct_req_t *req)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+    commit3_args args;
+    nct_xbuf_t xb;
+
+    nct_nfs_fh3(&args.file, req->req_vn);
+    args.offset = 0;
+    args.count = 0;
+
+    nct_nfs_call(req, NFS3_COMMIT, mnt->mnt_auth, &xb);
+    nct_nfs_call_done(req, &xb, nct_xdr_encode_commit3_args(&xb, &args));
+}
+
+/* Encode a LOOKUP3 call for the given name in directory dvn.
+ */
+void
+nct_nfs_lookup3_encode(nct_req_t *req, const nct_vn_t *dvn, const char *name)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+    lookup3_args args;
+    nct_xbuf_t xb;
+
+    nct_nfs_fh3(&args.what.dir, dvn);
+    args.what.name = (char *)name;
+
+    nct_nfs_call(req, NFS3_LOOKUP, mnt->mnt_auth, &xb);
+    nct_nfs_call_done(req, &xb, nct_xdr_encode_lookup3_args(&xb, &args));
+}
+
+/* Encode a READDIRPLUS3 call to list directory dvn from the given
+ * cookie, asking for no more entries than fit in half a message buffer
+ * (which leaves ample room for the reply header).
+ */
+void
+nct_nfs_readdirplus3_encode(nct_req_t *req, const nct_vn_t *dvn,
+                            cookie3 cookie, const cookieverf3 verf)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+    readdirplus3_args args;
+    nct_xbuf_t xb;
+
+    nct_nfs_fh3(&args.dir, dvn);
+    args.cookie = cookie;
+    memcpy(args.cookieverf, verf, sizeof(args.cookieverf));
+    args.maxcount = mnt->mnt_msgsz / 2;
+    args.dircount = args.maxcount;
+
+    nct_nfs_call(req, NFS3_READDIRPLUS, mnt->mnt_auth, &xb);
+    nct_nfs_call_done(req, &xb, nct_xdr_encode_readdirplus3_args(&xb, &args));
+}
+
+void
+nct_nfs_fsinfo3_encode(nct_req_t *req)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+    fsinfo3_args args;
+    nct_xbuf_t xb;
+
+    nct_nfs_fh3(&args.fsroot, req->req_vn);
+
+    nct_nfs_call(req, NFS3_FSINFO, mnt->mnt_auth, &xb);
+    nct_nfs_call_done(req, &xb, nct_xdr_encode_fsinfo3_args(&xb, &args));
+}
+
+/* READ3 reply sink function (see nct_req_sink_t).  Parses just enough
+ * of the RPC reply header and READ3res to find the opaque read data,
+ * i.e.: xid, direction, reply_stat, verifier, accept_stat, status,
+ * post_op_attr, count, eof, and the data length.
+ */
+ssize_t
+nct_nfs_read3_sink(const void *buf, size_t len, size_t *payloadp)
+{
+    const uint32_t *p = buf;
+    size_t n = len / BYTES_PER_XDR_UNIT;
+    u_int verflen;
+    size_t i;
+
+    if (n < 5)
+        return 0;
+
+    if (ntohl(p[1]) != REPLY || ntohl(p[2]) != MSG_ACCEPTED)
+        return -1;
+
+    /* Skip the verifier body, which can be no larger than in any
+     * other reply (see nct_rpc_decode()).
+     */
+    verflen = ntohl(p[4]);
+    if (verflen > MAX_AUTH_BYTES)
+        return -1;
+
+    i = 5 + (verflen + BYTES_PER_XDR_UNIT - 1) / BYTES_PER_XDR_UNIT;
+
+    if (n < i + 3)
+        return 0;
+
+    if (ntohl(p[i]) != SUCCESS || ntohl(p[i + 1]) != NFS3_OK)
+        return -1;
+
+    /* Skip the fattr3 if the attributes follow.
+     */
+    i += 3;
+    if (ntohl(p[i - 1]))
+        i += NCT_XDR_FATTR3_SIZE / BYTES_PER_XDR_UNIT;
+
+    /* Skip count and eof to get to the data length.
+     */
+    i += 2;
+    if (n < i + 1)
+        return 0;
 
-    len = nct_rpc_encode(&msg, mnt->mnt_auth,
-                         (xdrproc_t)nct_xdr_read3_encode, &args,
-                         req->req_msg->msg_data, NCT_MSGSZ_MAX);
+    *payloadp = ntohl(p[i]);
 
-    req->req_msg->msg_len = len;
+    return (i + 1) * BYTES_PER_XDR_UNIT;
 }
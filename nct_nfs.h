@@ -31,10 +31,23 @@
 #include "nct_req.h"
 
 struct nct_mnt_s;
+struct nct_vn_s;
 
-extern void nct_nfs_mount(struct nct_mnt_s *mnt);
+extern enum mountstat3 nct_nfs_mount(struct nct_mnt_s *mnt, const char *path);
+extern void nct_nfs_mount_exit(struct nct_mnt_s *mnt, enum mountstat3 stat);
+extern const char *nct_nfs_procname(u_int proc);
+extern const char *strerror_nfsstat3(nfsstat3 stat);
 extern void nct_nfs_null_encode(nct_req_t *req);
 extern void nct_nfs_getattr3_encode(nct_req_t *req);
 extern void nct_nfs_read3_encode(nct_req_t *req, off_t offset, size_t length);
+extern void nct_nfs_write3_encode(nct_req_t *req, off_t offset, size_t length,
+                                  stable_how stable, const char *data);
+extern void nct_nfs_commit3_encode(nct_req_t *req);
+extern void nct_nfs_lookup3_encode(nct_req_t *req, const struct nct_vn_s *dvn,
+                                   const char *name);
+extern void nct_nfs_readdirplus3_encode(nct_req_t *req, const struct nct_vn_s *dvn,
+                                        cookie3 cookie, const cookieverf3 verf);
+extern void nct_nfs_fsinfo3_encode(nct_req_t *req);
+extern ssize_t nct_nfs_read3_sink(const void *buf, size_t len, size_t *payloadp);
 
 #endif /* NCT_NFS_H */
@@ -71,7 +71,8 @@ given(int c)
 }
 
 void *
-test_null_init(int argc, char **argv, int duration, start_t **startp, char **rhostpathp)
+test_null_init(int argc, char **argv, int duration, start_t **startp,
+               char **rhostpathp, size_t *msgszp)
 {
     test_null_priv_t *priv;
     int rc;
@@ -100,6 +101,12 @@ test_null_init(int argc, char **argv, int duration, start_t **startp, char **rho
     return priv;
 }
 
+void
+test_null_fini(void *priv)
+{
+    free(priv);
+}
+
 static int
 test_null_cb(struct nct_req *req)
 {
@@ -109,21 +116,17 @@ test_null_cb(struct nct_req *req)
     if (stat != RPC_SUCCESS) {
         eprint("null rpc failed: clnt_stat=%d %s\n",
                req->req_msg->msg_stat, clnt_sperrno(req->req_msg->msg_stat));
-        XDR_DESTROY(&req->req_msg->msg_xdr);
         nct_req_free(req);
         return stat;
     }
 
-    XDR_DESTROY(&req->req_msg->msg_xdr);
-
     if (req->req_tsc_stop >= req->req_tsc_finish) {
         nct_req_free(req);
         return ETIMEDOUT;
     }
 
-    req->req_tsc_start = rdtsc();
     nct_nfs_null_encode(req);
-    nct_req_send(req);
+    nct_req_issue(req);
 
     return 0;
 }
@@ -136,9 +139,8 @@ test_null_start(struct nct_req *req)
     req->req_tsc_finish = rdtsc() + (tsc_freq * priv->pr_duration);
     req->req_cb = test_null_cb;
 
-    req->req_tsc_start = rdtsc();
     nct_nfs_null_encode(req);
-    nct_req_send(req);
+    nct_req_issue(req);
 
     return 0;
 }
@@ -4,6 +4,8 @@
 #ifndef NCT_NULL_H
 #define NCT_NULL_H
 
-extern void *test_null_init(int argc, char **argv, int duration, start_t **startp, char **rhostpathp);
+extern void *test_null_init(int argc, char **argv, int duration, start_t **startp,
+                            char **rhostpathp, size_t *msgszp);
+extern void test_null_fini(void *priv);
 
 #endif // NCT_NULL_H
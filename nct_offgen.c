@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "main.h"
+#include "nct_offgen.h"
+
+/* Terms of the zeta function summed exactly, beyond which the sum is
+ * approximated by an integral (which is accurate to well within the
+ * precision that matters here, and keeps setup quick for huge files).
+ */
+#define NCT_OG_ZETA_EXACT   (1u << 24)
+
+static uint64_t
+nct_offgen_rand(nct_offgen_job_t *job)
+{
+    uint64_t x = job->oj_rng;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    job->oj_rng = x;
+
+    return x * 0x2545f4914f6cdd1dull;
+}
+
+/* Uniform on [0, 1).
+ */
+static double
+nct_offgen_rand01(nct_offgen_job_t *job)
+{
+    return (nct_offgen_rand(job) >> 11) * 0x1.0p-53;
+}
+
+/* Uniform on [0, n).
+ */
+static uint64_t
+nct_offgen_randn(nct_offgen_job_t *job, uint64_t n)
+{
+    return (uint64_t)(nct_offgen_rand01(job) * n) % n;
+}
+
+static double
+nct_offgen_zeta(uint64_t n, double theta)
+{
+    uint64_t m = (n < NCT_OG_ZETA_EXACT) ? n : NCT_OG_ZETA_EXACT;
+    double sum = 0;
+    uint64_t i;
+
+    for (i = 1; i <= m; ++i)
+        sum += pow(i, -theta);
+
+    if (n > m)
+        sum += (pow(n + 0.5, 1 - theta) - pow(m + 0.5, 1 - theta)) / (1 - theta);
+
+    return sum;
+}
+
+/* Return the rank of a zipfian variate on [0, n), after Gray et al.,
+ * "Quickly Generating Billion-Record Synthetic Databases" (SIGMOD '94).
+ */
+static uint64_t
+nct_offgen_zipf(nct_offgen_t *og, nct_offgen_job_t *job)
+{
+    double u = nct_offgen_rand01(job);
+    double uz = u * og->og_zetan;
+    uint64_t rank;
+
+    if (uz < 1)
+        return 0;
+
+    if (uz < 1 + pow(0.5, og->og_theta))
+        return 1;
+
+    rank = og->og_partblocks * pow(og->og_eta * u - og->og_eta + 1, og->og_alpha);
+
+    return (rank < og->og_partblocks) ? rank : og->og_partblocks - 1;
+}
+
+static uint64_t
+nct_offgen_gcd(uint64_t a, uint64_t b)
+{
+    while (b) {
+        uint64_t t = a % b;
+
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/* Create an offset generator for the given access pattern, which is one
+ * of "seq", "uniform", "zipf[:theta]", "hotspot[:frac[:prob]]",
+ * "stride:bytes", or "streams:n", and the given layout, which is one
+ * of "shared", "region", or "stripe".  Returns NULL if either is
+ * invalid.
+ */
+nct_offgen_t *
+nct_offgen_create(const char *pattern, const char *layout, uint64_t seed, bool unaligned)
+{
+    const char *args;
+    nct_offgen_t *og;
+    char *end;
+    size_t len;
+
+    og = aligned_alloc(64, sizeof(*og));
+    if (!og)
+        abort();
+
+    memset(og, 0, sizeof(*og));
+    og->og_seed = seed;
+    og->og_unaligned = unaligned;
+    og->og_theta = 0.99;
+    og->og_hotfrac = 0.2;
+    og->og_hotprob = 0.8;
+
+    args = strchr(pattern, ':');
+    len = args ? args - pattern : strlen(pattern);
+    end = (char *)(args ? args + 1 : pattern + len);
+    errno = 0;
+
+    if (len == 3 && 0 == strncmp(pattern, "seq", len)) {
+        og->og_pattern = NCT_OG_SEQ;
+    }
+    else if (len == 7 && 0 == strncmp(pattern, "uniform", len)) {
+        og->og_pattern = NCT_OG_UNIFORM;
+    }
+    else if (len == 4 && 0 == strncmp(pattern, "zipf", len)) {
+        og->og_pattern = NCT_OG_ZIPF;
+        if (args)
+            og->og_theta = strtod(args + 1, &end);
+        if (og->og_theta <= 0 || og->og_theta >= 1)
+            errno = EINVAL;
+    }
+    else if (len == 7 && 0 == strncmp(pattern, "hotspot", len)) {
+        og->og_pattern = NCT_OG_HOTSPOT;
+        if (args) {
+            og->og_hotfrac = strtod(args + 1, &end);
+            if (*end == ':')
+                og->og_hotprob = strtod(end + 1, &end);
+        }
+        if (og->og_hotfrac <= 0 || og->og_hotfrac >= 1 ||
+            og->og_hotprob < 0 || og->og_hotprob > 1)
+            errno = EINVAL;
+    }
+    else if (len == 6 && 0 == strncmp(pattern, "stride", len) && args) {
+        og->og_pattern = NCT_OG_STRIDE;
+        og->og_stride = strtoull(args + 1, &end, 0);
+        if (og->og_stride == 0)
+            errno = EINVAL;
+    }
+    else if (len == 7 && 0 == strncmp(pattern, "streams", len) && args) {
+        og->og_pattern = NCT_OG_STREAMS;
+        og->og_streams = strtoul(args + 1, &end, 0);
+        if (og->og_streams == 0)
+            errno = EINVAL;
+    }
+    else {
+        errno = EINVAL;
+    }
+
+    if (errno || *end) {
+        eprint("invalid access pattern [%s], use -h for help\n", pattern);
+        free(og);
+        return NULL;
+    }
+
+    if (0 == strcmp(layout, "region")) {
+        og->og_layout = NCT_OG_REGION;
+    }
+    else if (0 == strcmp(layout, "stripe")) {
+        og->og_layout = NCT_OG_STRIPE;
+    }
+    else if (0 != strcmp(layout, "shared")) {
+        eprint("invalid layout [%s], use -h for help\n", layout);
+        free(og);
+        return NULL;
+    }
+
+    return og;
+}
+
+/* Size the given generator for a working set of wss bytes accessed by
+ * requests of the given length by up to the given number of jobs.
+ */
+int
+nct_offgen_setup(nct_offgen_t *og, uint64_t wss, size_t length, u_int jobs)
+{
+    uint64_t seed;
+    u_int i;
+
+    og->og_length = length;
+    og->og_nblocks = wss / length;
+
+    /* Leave room to displace the last block.
+     */
+    if (og->og_unaligned)
+        og->og_nblocks = (wss < length) ? 0 : (wss - length + 1) / length;
+
+    og->og_partblocks = og->og_nblocks;
+    if (og->og_layout != NCT_OG_SHARED)
+        og->og_partblocks /= jobs;
+
+    if (og->og_partblocks == 0) {
+        eprint("working set of %lu bytes too small for length %zu and %u partitions\n",
+               wss, length, (og->og_layout != NCT_OG_SHARED) ? jobs : 1);
+        return EINVAL;
+    }
+
+    og->og_jobv = aligned_alloc(64, sizeof(*og->og_jobv) * jobs);
+    if (!og->og_jobv)
+        abort();
+
+    og->og_jobc = jobs;
+
+    for (i = 0; i < jobs; ++i) {
+        seed = og->og_seed + (i + 1) * 0x9e3779b97f4a7c15ull;
+        seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ull;
+        seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebull;
+        seed ^= seed >> 31;
+
+        og->og_jobv[i].oj_rng = seed ? seed : 1;
+        og->og_jobv[i].oj_next = 0;
+    }
+
+    switch (og->og_pattern) {
+    case NCT_OG_ZIPF:
+        og->og_zetan = nct_offgen_zeta(og->og_partblocks, og->og_theta);
+        og->og_alpha = 1 / (1 - og->og_theta);
+        og->og_eta = (1 - pow(2.0 / og->og_partblocks, 1 - og->og_theta)) /
+            (1 - nct_offgen_zeta(2, og->og_theta) / og->og_zetan);
+
+        /* Scatter the ranks across the working set with a multiplier
+         * coprime to the number of blocks, so that the hottest blocks
+         * are not all adjacent.
+         */
+        og->og_stride = 0x9e3779b97f4a7c15ull % og->og_partblocks;
+        while (og->og_partblocks > 1 && nct_offgen_gcd(og->og_stride, og->og_partblocks) != 1)
+            ++og->og_stride;
+        break;
+
+    case NCT_OG_STRIDE:
+        og->og_stride /= length;
+        if (og->og_stride == 0)
+            og->og_stride = 1;
+        break;
+
+    case NCT_OG_STREAMS:
+        if (og->og_streams > og->og_partblocks)
+            og->og_streams = og->og_partblocks;
+        break;
+    }
+
+    return 0;
+}
+
+/* Advance the cursor of the given job, which is its own if the working
+ * set is partitioned and shared by all jobs otherwise.
+ */
+static inline uint64_t
+nct_offgen_cursor(nct_offgen_t *og, nct_offgen_job_t *oj)
+{
+    if (og->og_layout != NCT_OG_SHARED)
+        return oj->oj_next++;
+
+    return __atomic_fetch_add(&og->og_next, 1, __ATOMIC_RELAXED);
+}
+
+/* Return the offset of the next request of the given job.
+ */
+off_t
+nct_offgen_next(nct_offgen_t *og, u_int job)
+{
+    nct_offgen_job_t *oj;
+    uint64_t blk, k, hot, per, n;
+    off_t offset;
+
+    job %= og->og_jobc;
+    oj = og->og_jobv + job;
+    n = og->og_partblocks;
+
+    switch (og->og_pattern) {
+    case NCT_OG_UNIFORM:
+        blk = nct_offgen_randn(oj, n);
+        break;
+
+    case NCT_OG_ZIPF:
+        blk = nct_offgen_zipf(og, oj);
+        blk = (unsigned __int128)blk * og->og_stride % n;
+        break;
+
+    case NCT_OG_HOTSPOT:
+        hot = n * og->og_hotfrac;
+        if (hot == 0)
+            hot = 1;
+
+        if (hot < n && nct_offgen_rand01(oj) >= og->og_hotprob)
+            blk = hot + nct_offgen_randn(oj, n - hot);
+        else
+            blk = nct_offgen_randn(oj, hot);
+        break;
+
+    case NCT_OG_STRIDE:
+        /* Shift by one block on each pass so that every block is
+         * eventually visited.
+         */
+        k = nct_offgen_cursor(og, oj) * og->og_stride;
+        blk = (k + k / n) % n;
+        break;
+
+    case NCT_OG_STREAMS:
+        k = nct_offgen_cursor(og, oj);
+        per = n / og->og_streams;
+        blk = (k % og->og_streams) * per + (k / og->og_streams) % per;
+        break;
+
+    default:
+        blk = nct_offgen_cursor(og, oj) % n;
+        break;
+    }
+
+    /* Map the block of the job's partition into the working set.
+     */
+    if (og->og_layout == NCT_OG_REGION)
+        blk += job * og->og_partblocks;
+    else if (og->og_layout == NCT_OG_STRIPE)
+        blk = blk * og->og_jobc + job;
+
+    offset = blk * og->og_length;
+
+    if (og->og_unaligned)
+        offset += nct_offgen_randn(oj, og->og_length);
+
+    return offset;
+}
+
+void
+nct_offgen_destroy(nct_offgen_t *og)
+{
+    if (!og)
+        return;
+
+    free(og->og_jobv);
+    free(og);
+}
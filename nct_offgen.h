@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NCT_OFFGEN_H
+#define NCT_OFFGEN_H
+
+/* Access patterns (og_pattern)
+ */
+#define NCT_OG_SEQ          (0)                 // Sequential
+#define NCT_OG_UNIFORM      (1)                 // Uniform random
+#define NCT_OG_ZIPF         (2)                 // Zipfian with skew og_theta
+#define NCT_OG_HOTSPOT      (3)                 // Hot and cold sets
+#define NCT_OG_STRIDE       (4)                 // Every og_stride'th block
+#define NCT_OG_STREAMS      (5)                 // og_streams interleaved streams
+
+/* Partitioning of the working set among the jobs (og_layout)
+ */
+#define NCT_OG_SHARED       (0)                 // All jobs share the working set
+#define NCT_OG_REGION       (1)                 // Each job has a contiguous region
+#define NCT_OG_STRIPE       (2)                 // ... or every og_jobc'th block
+
+/* Per-job state of an offset generator.  Each job has its own random
+ * number generator seeded from the generator's seed and the job index,
+ * so each job's sequence of random offsets is reproducible.  Given a
+ * partitioned working set, each job also has its own cursor, so that
+ * the jobs share nothing at all.
+ */
+typedef struct {
+    __aligned(64)
+    uint64_t            oj_rng;                 // xorshift64* state
+    uint64_t            oj_next;                // Private cursor
+} nct_offgen_job_t;
+
+/* An offset generator yields the offsets of the requests of a test, all
+ * of which have the same length.  The working set is divided into
+ * og_nblocks blocks of that length, a block is chosen according to the
+ * access pattern, and its offset is displaced by a random amount less
+ * than the length if unaligned offsets were requested.  If the working
+ * set is partitioned, the pattern instead applies to each job's own
+ * partition of og_partblocks blocks.
+ */
+typedef struct {
+    __aligned(64)
+    volatile uint64_t   og_next;                // Shared cursor (atomic)
+
+    __aligned(64)
+    u_int               og_pattern;             // NCT_OG_*
+    u_int               og_layout;              // NCT_OG_SHARED, ...
+    bool                og_unaligned;
+    uint64_t            og_seed;
+    size_t              og_length;              // Request length
+    uint64_t            og_nblocks;             // Blocks in the working set
+    uint64_t            og_partblocks;          // Blocks per partition
+    double              og_theta;               // Zipf skew (0 < theta < 1)
+    double              og_zetan;
+    double              og_alpha;
+    double              og_eta;
+    double              og_hotfrac;             // Fraction of blocks that are hot
+    double              og_hotprob;             // Fraction of requests to them
+    uint64_t            og_stride;              // Stride (in bytes, then blocks)
+    u_int               og_streams;
+    nct_offgen_job_t   *og_jobv;
+    u_int               og_jobc;
+} nct_offgen_t;
+
+extern nct_offgen_t *nct_offgen_create(const char *pattern, const char *layout,
+                                       uint64_t seed, bool unaligned);
+extern int nct_offgen_setup(nct_offgen_t *og, uint64_t wss, size_t length, u_int jobs);
+extern off_t nct_offgen_next(nct_offgen_t *og, u_int job);
+extern void nct_offgen_destroy(nct_offgen_t *og);
+
+#endif // NCT_OFFGEN_H
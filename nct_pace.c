@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <rpc/types.h>
+#include <rpc/auth.h>
+#include <rpc/rpc.h>
+
+#include "main.h"
+#include "nct.h"
+#include "nct_pace.h"
+
+/* Return the target arrival rate (requests/sec) at the given time,
+ * which is either that of the current step of the schedule, or an
+ * interpolation between the first and last rates of a ramp.
+ */
+double
+nct_pace_rate(nct_pace_t *pace, uint64_t tsc)
+{
+    double frac;
+    u_int idx;
+
+    if (tsc <= pace->pace_tsc_begin)
+        frac = 0;
+    else if (tsc >= pace->pace_tsc_end)
+        frac = 1;
+    else
+        frac = (double)(tsc - pace->pace_tsc_begin) /
+            (pace->pace_tsc_end - pace->pace_tsc_begin);
+
+    if (pace->pace_ramp)
+        return pace->pace_ratev[0] + (pace->pace_ratev[1] - pace->pace_ratev[0]) * frac;
+
+    idx = frac * pace->pace_ratec;
+    if (idx >= pace->pace_ratec)
+        idx = pace->pace_ratec - 1;
+
+    return pace->pace_ratev[idx];
+}
+
+/* Advance the given generator to its next arrival.
+ */
+static void
+nct_pace_step(nct_pace_t *pace, nct_pace_gen_t *gen)
+{
+    double gap;
+
+    gap = tsc_freq / nct_pace_rate(pace, gen->gen_next);
+
+    if (pace->pace_poisson) {
+        uint64_t x = gen->gen_rng;
+        double u;
+
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        gen->gen_rng = x;
+
+        /* Uniform on (0, 1], so that the log is finite.
+         */
+        u = (((x * 0x2545f4914f6cdd1dull) >> 11) + 1) * 0x1.0p-53;
+        gap *= -log(u);
+    }
+
+    gen->gen_next += gap;
+}
+
+/* Take a request that is waiting to be sent, or return NULL if there
+ * are none.
+ */
+static nct_req_t *
+nct_pace_take(nct_pace_t *pace)
+{
+    nct_req_t *req;
+
+    if (!pace->pace_idle)
+        pace->pace_idle = __atomic_exchange_n(&pace->pace_head, NULL, __ATOMIC_ACQUIRE);
+
+    req = pace->pace_idle;
+    if (req)
+        pace->pace_idle = req->req_next;
+
+    return req;
+}
+
+/* Wait up to usecs for a request to be parked.
+ */
+static void
+nct_pace_wait(nct_pace_t *pace, long usecs)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += usecs * 1000;
+    ts.tv_sec += ts.tv_nsec / 1000000000;
+    ts.tv_nsec %= 1000000000;
+
+    pthread_mutex_lock(&pace->pace_mtx);
+    __atomic_store_n(&pace->pace_sleeping, true, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&pace->pace_head, __ATOMIC_SEQ_CST))
+        pthread_cond_timedwait(&pace->pace_cv, &pace->pace_mtx, &ts);
+    __atomic_store_n(&pace->pace_sleeping, false, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pace->pace_mtx);
+}
+
+/* Park the given (encoded) request until the pacer sends it.
+ */
+void
+nct_pace_park(nct_pace_t *pace, nct_req_t *req)
+{
+    nct_req_t *head;
+
+    head = __atomic_load_n(&pace->pace_head, __ATOMIC_RELAXED);
+    do {
+        req->req_next = head;
+    } while (!__atomic_compare_exchange_n(&pace->pace_head, &head, req, true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    if (__atomic_load_n(&pace->pace_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&pace->pace_mtx);
+        pthread_cond_signal(&pace->pace_cv);
+        pthread_mutex_unlock(&pace->pace_mtx);
+    }
+}
+
+/* The pacer sends a parked request at each arrival time of the schedule
+ * until the end of the run, after which it retires the jobs of all the
+ * requests that are parked.  It sleeps between arrivals that are far
+ * enough apart, and spins otherwise.
+ */
+static void *
+nct_pace_loop(void *arg)
+{
+    nct_pace_t *pace = arg;
+    nct_mnt_t *mnt = pace->pace_mnt;
+    bool waited = false;
+    uint64_t backlog;
+    nct_req_t *req;
+    uint64_t now;
+    long usecs;
+
+    while (1) {
+        now = rdtsc();
+
+        while (pace->pace_due.gen_next <= now && pace->pace_due.gen_next < pace->pace_tsc_end) {
+            nct_pace_step(pace, &pace->pace_due);
+            ++pace->pace_due_cnt;
+        }
+
+        backlog = pace->pace_due_cnt - pace->pace_sent;
+        __atomic_store_n(&pace->pace_backlog, backlog, __ATOMIC_RELAXED);
+        if (backlog > pace->pace_backlog_max)
+            __atomic_store_n(&pace->pace_backlog_max, backlog, __ATOMIC_RELAXED);
+
+        /* Arrivals still owed at the end of the run are dropped
+         * rather than sent after it.
+         */
+        if (pace->pace_send.gen_next >= pace->pace_tsc_end || now >= pace->pace_tsc_end) {
+            while (( req = nct_pace_take(pace) ))
+                nct_req_exit(req);
+
+            if (__atomic_load_n(&mnt->mnt_jobs_cnt, __ATOMIC_SEQ_CST) < 1)
+                break;
+
+            nct_pace_wait(pace, 10000);
+            continue;
+        }
+
+        if (pace->pace_send.gen_next > now) {
+            usecs = ((pace->pace_send.gen_next - now) * 1000000) / tsc_freq;
+            if (usecs > 200)
+                usleep(usecs - 100);
+            continue;
+        }
+
+        /* The arrival is due, so send it if a request is available.
+         * Otherwise all the requests are in flight, in which case we
+         * wait for a completion (but no longer than a millisecond so
+         * as to keep the backlog current).
+         */
+        req = nct_pace_take(pace);
+        if (!req) {
+            nct_pace_wait(pace, 1000);
+            waited = true;
+            continue;
+        }
+
+        if (waited)
+            __atomic_store_n(&pace->pace_late, pace->pace_late + 1, __ATOMIC_RELAXED);
+
+        req->req_tsc_start = pace->pace_send.gen_next;
+        nct_pace_step(pace, &pace->pace_send);
+        __atomic_store_n(&pace->pace_sent, pace->pace_sent + 1, __ATOMIC_RELAXED);
+
+        if (pace->pace_due_cnt <= pace->pace_sent)
+            waited = false;
+
+        nct_req_send(req);
+    }
+
+    pthread_exit(NULL);
+}
+
+/* Create a pacer for the given mount and start its thread.  The rate
+ * is given either as a single rate, as "lo:hi" to ramp linearly from
+ * lo to hi over the duration of the run, or as "r1,r2,..." to step
+ * through the given rates in equal intervals.  Arrivals are either
+ * evenly spaced ("const") or form a Poisson process ("poisson").
+ */
+nct_pace_t *
+nct_pace_create(nct_mnt_t *mnt, const char *rate, const char *arrival, long duration)
+{
+    char *end = (char *)rate;
+    nct_pace_t *pace;
+    const char *pc;
+    int rc;
+
+    pace = aligned_alloc(64, sizeof(*pace));
+    if (!pace)
+        abort();
+
+    memset(pace, 0, sizeof(*pace));
+    pace->pace_mnt = mnt;
+
+    if (0 == strcmp(arrival, "poisson")) {
+        pace->pace_poisson = true;
+    }
+    else if (0 != strcmp(arrival, "const")) {
+        eprint("invalid arrival process [%s], use -h for help\n", arrival);
+        free(pace);
+        return NULL;
+    }
+
+    for (pc = rate; *pc; pc = end + 1) {
+        if (pace->pace_ratec >= NELEM(pace->pace_ratev))
+            break;
+
+        errno = 0;
+        pace->pace_ratev[pace->pace_ratec] = strtod(pc, &end);
+        if (errno || end == pc || pace->pace_ratev[pace->pace_ratec] <= 0)
+            break;
+
+        ++pace->pace_ratec;
+
+        if (*end == ':' && pace->pace_ratec == 1)
+            pace->pace_ramp = true;
+        else if (*end != ',' || pace->pace_ramp)
+            break;
+    }
+
+    if (*end || pace->pace_ratec == 0 || (pace->pace_ramp && pace->pace_ratec != 2)) {
+        eprint("invalid rate [%s], use -h for help\n", rate);
+        free(pace);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pace->pace_mtx, NULL);
+    pthread_cond_init(&pace->pace_cv, NULL);
+
+    pace->pace_tsc_begin = rdtsc();
+    pace->pace_tsc_end = pace->pace_tsc_begin + tsc_freq * duration;
+    pace->pace_send.gen_next = pace->pace_tsc_begin;
+    pace->pace_send.gen_rng = 0x9e3779b97f4a7c15ull;
+    pace->pace_due = pace->pace_send;
+
+    rc = pthread_create(&pace->pace_td, NULL, nct_pace_loop, pace);
+    if (rc) {
+        eprint("pthread_create() failed: %s\n", strerror(rc));
+        abort();
+    }
+
+    return pace;
+}
+
+/* Wait for the pacer to exit (i.e., for all the jobs to finish), and
+ * free it.
+ */
+void
+nct_pace_destroy(nct_pace_t *pace)
+{
+    void *val;
+
+    if (!pace)
+        return;
+
+    pthread_join(pace->pace_td, &val);
+
+    pthread_mutex_destroy(&pace->pace_mtx);
+    pthread_cond_destroy(&pace->pace_cv);
+
+    free(pace);
+}
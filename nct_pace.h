@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NCT_PACE_H
+#define NCT_PACE_H
+
+struct nct_mnt_s;
+struct nct_req;
+
+/* A pacer issues the requests of an open-loop workload at the arrival
+ * times of a schedule rather than as soon as the previous request of
+ * a job completes.  Each arrival generator walks the schedule from
+ * the same seed, so the arrival times are reproducible and the number
+ * of arrivals due by any given time is known exactly.
+ */
+typedef struct nct_pace_gen_s {
+    double              gen_next;               // Next arrival time (in cycles)
+    uint64_t            gen_rng;                // xorshift64* state
+} nct_pace_gen_t;
+
+/* A request that has been encoded waits on pace_head until the pacer
+ * assigns it the next arrival time, which becomes its start time such
+ * that its latency includes any time it spent waiting to be sent (i.e.,
+ * the measurements do not suffer from coordinated omission).  Arrivals
+ * that come due while all the requests are in flight make up the
+ * backlog, which is sent as soon as requests become available.
+ */
+typedef struct nct_pace_s {
+    __aligned(64)
+    struct nct_req     *pace_head;              // Parked requests, newest first
+    bool                pace_sleeping;          // Pacer is waiting on pace_cv
+    pthread_mutex_t     pace_mtx;
+    pthread_cond_t      pace_cv;
+
+    __aligned(64)
+    uint64_t            pace_sent;              // Arrivals sent (atomic)
+    uint64_t            pace_late;              // ... after waiting for a request
+    uint64_t            pace_backlog;           // Arrivals due but not yet sent
+    uint64_t            pace_backlog_max;
+
+    __aligned(64)
+    struct nct_mnt_s   *pace_mnt;
+    struct nct_req     *pace_idle;              // Requests taken off pace_head
+    nct_pace_gen_t      pace_send;              // Arrival of the next request sent
+    nct_pace_gen_t      pace_due;               // Arrival of the next request due
+    uint64_t            pace_due_cnt;
+    uint64_t            pace_tsc_begin;
+    uint64_t            pace_tsc_end;
+    bool                pace_poisson;           // Exponential interarrival times
+    bool                pace_ramp;              // Ramp between pace_ratev[0] and [1]
+    u_int               pace_ratec;
+    double              pace_ratev[32];         // Requests/sec (of each step)
+    pthread_t           pace_td;
+} nct_pace_t;
+
+extern nct_pace_t *nct_pace_create(struct nct_mnt_s *mnt, const char *rate,
+                                   const char *arrival, long duration);
+extern void nct_pace_destroy(nct_pace_t *pace);
+extern void nct_pace_park(nct_pace_t *pace, struct nct_req *req);
+extern double nct_pace_rate(nct_pace_t *pace, uint64_t tsc);
+
+#endif // NCT_PACE_H
@@ -0,0 +1,892 @@
+/*
+ * NFSv3 and MOUNTv3 protocol definitions (RFC 1813), from which xdrgen
+ * generates nct_prot.h.
+ *
+ * The procedure argument and result types are named in the style of
+ * nct (e.g., getattr3_args and getattr3_res rather than GETATTR3args
+ * and GETATTR3res), and the MOUNTv3 name type is named mntname3 so as
+ * not to collide with the many variables named "name".
+ */
+
+const NFS3_FHSIZE           = 64;
+const NFS3_COOKIEVERFSIZE   = 8;
+const NFS3_CREATEVERFSIZE   = 8;
+const NFS3_WRITEVERFSIZE    = 8;
+
+typedef unsigned hyper  uint64;
+typedef hyper           int64;
+typedef unsigned int    uint32;
+typedef int             int32;
+typedef string          filename3<>;
+typedef string          nfspath3<>;
+typedef uint64          fileid3;
+typedef uint64          cookie3;
+typedef opaque          cookieverf3[NFS3_COOKIEVERFSIZE];
+typedef opaque          createverf3[NFS3_CREATEVERFSIZE];
+typedef opaque          writeverf3[NFS3_WRITEVERFSIZE];
+typedef uint32          uid3;
+typedef uint32          gid3;
+typedef uint64          size3;
+typedef uint64          offset3;
+typedef uint32          mode3;
+typedef uint32          count3;
+
+enum nfsstat3 {
+    NFS3_OK             = 0,
+    NFS3ERR_PERM        = 1,
+    NFS3ERR_NOENT       = 2,
+    NFS3ERR_IO          = 5,
+    NFS3ERR_NXIO        = 6,
+    NFS3ERR_ACCES       = 13,
+    NFS3ERR_EXIST       = 17,
+    NFS3ERR_XDEV        = 18,
+    NFS3ERR_NODEV       = 19,
+    NFS3ERR_NOTDIR      = 20,
+    NFS3ERR_ISDIR       = 21,
+    NFS3ERR_INVAL       = 22,
+    NFS3ERR_FBIG        = 27,
+    NFS3ERR_NOSPC       = 28,
+    NFS3ERR_ROFS        = 30,
+    NFS3ERR_MLINK       = 31,
+    NFS3ERR_NAMETOOLONG = 63,
+    NFS3ERR_NOTEMPTY    = 66,
+    NFS3ERR_DQUOT       = 69,
+    NFS3ERR_STALE       = 70,
+    NFS3ERR_REMOTE      = 71,
+    NFS3ERR_BADHANDLE   = 10001,
+    NFS3ERR_NOT_SYNC    = 10002,
+    NFS3ERR_BAD_COOKIE  = 10003,
+    NFS3ERR_NOTSUPP     = 10004,
+    NFS3ERR_TOOSMALL    = 10005,
+    NFS3ERR_SERVERFAULT = 10006,
+    NFS3ERR_BADTYPE     = 10007,
+    NFS3ERR_JUKEBOX     = 10008
+};
+
+enum ftype3 {
+    NF3REG      = 1,
+    NF3DIR      = 2,
+    NF3BLK      = 3,
+    NF3CHR      = 4,
+    NF3LNK      = 5,
+    NF3SOCK     = 6,
+    NF3FIFO     = 7
+};
+
+struct specdata3 {
+    uint32      specdata1;
+    uint32      specdata2;
+};
+
+struct nfs_fh3 {
+    opaque      data<NFS3_FHSIZE>;
+};
+
+struct nfstime3 {
+    uint32      seconds;
+    uint32      nseconds;
+};
+
+struct fattr3 {
+    ftype3      type;
+    mode3       mode;
+    uint32      nlink;
+    uid3        uid;
+    gid3        gid;
+    size3       size;
+    size3       used;
+    specdata3   rdev;
+    uint64      fsid;
+    fileid3     fileid;
+    nfstime3    atime;
+    nfstime3    mtime;
+    nfstime3    ctime;
+};
+
+union post_op_attr switch (bool attributes_follow) {
+case TRUE:
+    fattr3      attributes;
+case FALSE:
+    void;
+};
+
+struct wcc_attr {
+    size3       size;
+    nfstime3    mtime;
+    nfstime3    ctime;
+};
+
+union pre_op_attr switch (bool attributes_follow) {
+case TRUE:
+    wcc_attr    attributes;
+case FALSE:
+    void;
+};
+
+struct wcc_data {
+    pre_op_attr before;
+    post_op_attr after;
+};
+
+union post_op_fh3 switch (bool handle_follows) {
+case TRUE:
+    nfs_fh3     handle;
+case FALSE:
+    void;
+};
+
+enum time_how {
+    DONT_CHANGE         = 0,
+    SET_TO_SERVER_TIME  = 1,
+    SET_TO_CLIENT_TIME  = 2
+};
+
+union set_mode3 switch (bool set_it) {
+case TRUE:
+    mode3       mode;
+default:
+    void;
+};
+
+union set_uid3 switch (bool set_it) {
+case TRUE:
+    uid3        uid;
+default:
+    void;
+};
+
+union set_gid3 switch (bool set_it) {
+case TRUE:
+    gid3        gid;
+default:
+    void;
+};
+
+union set_size3 switch (bool set_it) {
+case TRUE:
+    size3       size;
+default:
+    void;
+};
+
+union set_atime switch (time_how set_it) {
+case SET_TO_CLIENT_TIME:
+    nfstime3    atime;
+default:
+    void;
+};
+
+union set_mtime switch (time_how set_it) {
+case SET_TO_CLIENT_TIME:
+    nfstime3    mtime;
+default:
+    void;
+};
+
+struct sattr3 {
+    set_mode3   mode;
+    set_uid3    uid;
+    set_gid3    gid;
+    set_size3   size;
+    set_atime   atime;
+    set_mtime   mtime;
+};
+
+struct diropargs3 {
+    nfs_fh3     dir;
+    filename3   name;
+};
+
+/* GETATTR
+ */
+struct getattr3_args {
+    nfs_fh3     object;
+};
+
+struct getattr3_resok {
+    fattr3      obj_attributes;
+};
+
+union getattr3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    getattr3_resok resok;
+default:
+    void;
+};
+
+/* SETATTR
+ */
+union sattrguard3 switch (bool check) {
+case TRUE:
+    nfstime3    obj_ctime;
+case FALSE:
+    void;
+};
+
+struct setattr3_args {
+    nfs_fh3     object;
+    sattr3      new_attributes;
+    sattrguard3 guard;
+};
+
+struct setattr3_resok {
+    wcc_data    obj_wcc;
+};
+
+struct setattr3_resfail {
+    wcc_data    obj_wcc;
+};
+
+union setattr3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    setattr3_resok resok;
+default:
+    setattr3_resfail resfail;
+};
+
+/* LOOKUP
+ */
+struct lookup3_args {
+    diropargs3  what;
+};
+
+struct lookup3_resok {
+    nfs_fh3     object;
+    post_op_attr obj_attributes;
+    post_op_attr dir_attributes;
+};
+
+struct lookup3_resfail {
+    post_op_attr dir_attributes;
+};
+
+union lookup3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    lookup3_resok resok;
+default:
+    lookup3_resfail resfail;
+};
+
+/* ACCESS
+ */
+const ACCESS3_READ      = 0x0001;
+const ACCESS3_LOOKUP    = 0x0002;
+const ACCESS3_MODIFY    = 0x0004;
+const ACCESS3_EXTEND    = 0x0008;
+const ACCESS3_DELETE    = 0x0010;
+const ACCESS3_EXECUTE   = 0x0020;
+
+struct access3_args {
+    nfs_fh3     object;
+    uint32      access;
+};
+
+struct access3_resok {
+    post_op_attr obj_attributes;
+    uint32      access;
+};
+
+struct access3_resfail {
+    post_op_attr obj_attributes;
+};
+
+union access3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    access3_resok resok;
+default:
+    access3_resfail resfail;
+};
+
+/* READLINK
+ */
+struct readlink3_args {
+    nfs_fh3     symlink;
+};
+
+struct readlink3_resok {
+    post_op_attr symlink_attributes;
+    nfspath3    data;
+};
+
+struct readlink3_resfail {
+    post_op_attr symlink_attributes;
+};
+
+union readlink3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    readlink3_resok resok;
+default:
+    readlink3_resfail resfail;
+};
+
+/* READ
+ */
+struct read3_args {
+    nfs_fh3     file;
+    offset3     offset;
+    count3      count;
+};
+
+struct read3_resok {
+    post_op_attr file_attributes;
+    count3      count;
+    bool        eof;
+    opaque      data<>;
+};
+
+struct read3_resfail {
+    post_op_attr file_attributes;
+};
+
+union read3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    read3_resok resok;
+default:
+    read3_resfail resfail;
+};
+
+/* WRITE
+ */
+enum stable_how {
+    UNSTABLE    = 0,
+    DATA_SYNC   = 1,
+    FILE_SYNC   = 2
+};
+
+struct write3_args {
+    nfs_fh3     file;
+    offset3     offset;
+    count3      count;
+    stable_how  stable;
+    opaque      data<>;
+};
+
+struct write3_resok {
+    wcc_data    file_wcc;
+    count3      count;
+    stable_how  committed;
+    writeverf3  verf;
+};
+
+struct write3_resfail {
+    wcc_data    file_wcc;
+};
+
+union write3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    write3_resok resok;
+default:
+    write3_resfail resfail;
+};
+
+/* CREATE
+ */
+enum createmode3 {
+    UNCHECKED   = 0,
+    GUARDED     = 1,
+    EXCLUSIVE   = 2
+};
+
+union createhow3 switch (createmode3 mode) {
+case UNCHECKED:
+case GUARDED:
+    sattr3      obj_attributes;
+case EXCLUSIVE:
+    createverf3 verf;
+};
+
+struct create3_args {
+    diropargs3  where;
+    createhow3  how;
+};
+
+struct create3_resok {
+    post_op_fh3 obj;
+    post_op_attr obj_attributes;
+    wcc_data    dir_wcc;
+};
+
+struct create3_resfail {
+    wcc_data    dir_wcc;
+};
+
+union create3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    create3_resok resok;
+default:
+    create3_resfail resfail;
+};
+
+/* MKDIR
+ */
+struct mkdir3_args {
+    diropargs3  where;
+    sattr3      attributes;
+};
+
+struct mkdir3_resok {
+    post_op_fh3 obj;
+    post_op_attr obj_attributes;
+    wcc_data    dir_wcc;
+};
+
+struct mkdir3_resfail {
+    wcc_data    dir_wcc;
+};
+
+union mkdir3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    mkdir3_resok resok;
+default:
+    mkdir3_resfail resfail;
+};
+
+/* SYMLINK
+ */
+struct symlinkdata3 {
+    sattr3      symlink_attributes;
+    nfspath3    symlink_data;
+};
+
+struct symlink3_args {
+    diropargs3  where;
+    symlinkdata3 symlink;
+};
+
+struct symlink3_resok {
+    post_op_fh3 obj;
+    post_op_attr obj_attributes;
+    wcc_data    dir_wcc;
+};
+
+struct symlink3_resfail {
+    wcc_data    dir_wcc;
+};
+
+union symlink3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    symlink3_resok resok;
+default:
+    symlink3_resfail resfail;
+};
+
+/* MKNOD
+ */
+struct devicedata3 {
+    sattr3      dev_attributes;
+    specdata3   spec;
+};
+
+union mknoddata3 switch (ftype3 type) {
+case NF3CHR:
+case NF3BLK:
+    devicedata3 device;
+case NF3SOCK:
+case NF3FIFO:
+    sattr3      pipe_attributes;
+default:
+    void;
+};
+
+struct mknod3_args {
+    diropargs3  where;
+    mknoddata3  what;
+};
+
+struct mknod3_resok {
+    post_op_fh3 obj;
+    post_op_attr obj_attributes;
+    wcc_data    dir_wcc;
+};
+
+struct mknod3_resfail {
+    wcc_data    dir_wcc;
+};
+
+union mknod3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    mknod3_resok resok;
+default:
+    mknod3_resfail resfail;
+};
+
+/* REMOVE
+ */
+struct remove3_args {
+    diropargs3  object;
+};
+
+struct remove3_resok {
+    wcc_data    dir_wcc;
+};
+
+struct remove3_resfail {
+    wcc_data    dir_wcc;
+};
+
+union remove3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    remove3_resok resok;
+default:
+    remove3_resfail resfail;
+};
+
+/* RMDIR
+ */
+struct rmdir3_args {
+    diropargs3  object;
+};
+
+struct rmdir3_resok {
+    wcc_data    dir_wcc;
+};
+
+struct rmdir3_resfail {
+    wcc_data    dir_wcc;
+};
+
+union rmdir3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    rmdir3_resok resok;
+default:
+    rmdir3_resfail resfail;
+};
+
+/* RENAME
+ */
+struct rename3_args {
+    diropargs3  from;
+    diropargs3  to;
+};
+
+struct rename3_resok {
+    wcc_data    fromdir_wcc;
+    wcc_data    todir_wcc;
+};
+
+struct rename3_resfail {
+    wcc_data    fromdir_wcc;
+    wcc_data    todir_wcc;
+};
+
+union rename3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    rename3_resok resok;
+default:
+    rename3_resfail resfail;
+};
+
+/* LINK
+ */
+struct link3_args {
+    nfs_fh3     file;
+    diropargs3  link;
+};
+
+struct link3_resok {
+    post_op_attr file_attributes;
+    wcc_data    linkdir_wcc;
+};
+
+struct link3_resfail {
+    post_op_attr file_attributes;
+    wcc_data    linkdir_wcc;
+};
+
+union link3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    link3_resok resok;
+default:
+    link3_resfail resfail;
+};
+
+/* READDIR
+ */
+struct readdir3_args {
+    nfs_fh3     dir;
+    cookie3     cookie;
+    cookieverf3 cookieverf;
+    count3      count;
+};
+
+struct entry3 {
+    fileid3     fileid;
+    filename3   name;
+    cookie3     cookie;
+    entry3     *nextentry;
+};
+
+struct dirlist3 {
+    entry3     *entries;
+    bool        eof;
+};
+
+struct readdir3_resok {
+    post_op_attr dir_attributes;
+    cookieverf3 cookieverf;
+    dirlist3    reply;
+};
+
+struct readdir3_resfail {
+    post_op_attr dir_attributes;
+};
+
+union readdir3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    readdir3_resok resok;
+default:
+    readdir3_resfail resfail;
+};
+
+/* READDIRPLUS
+ */
+struct readdirplus3_args {
+    nfs_fh3     dir;
+    cookie3     cookie;
+    cookieverf3 cookieverf;
+    count3      dircount;
+    count3      maxcount;
+};
+
+struct entryplus3 {
+    fileid3     fileid;
+    filename3   name;
+    cookie3     cookie;
+    post_op_attr name_attributes;
+    post_op_fh3 name_handle;
+    entryplus3 *nextentry;
+};
+
+struct dirlistplus3 {
+    entryplus3 *entries;
+    bool        eof;
+};
+
+struct readdirplus3_resok {
+    post_op_attr dir_attributes;
+    cookieverf3 cookieverf;
+    dirlistplus3 reply;
+};
+
+struct readdirplus3_resfail {
+    post_op_attr dir_attributes;
+};
+
+union readdirplus3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    readdirplus3_resok resok;
+default:
+    readdirplus3_resfail resfail;
+};
+
+/* FSSTAT
+ */
+struct fsstat3_args {
+    nfs_fh3     fsroot;
+};
+
+struct fsstat3_resok {
+    post_op_attr obj_attributes;
+    size3       tbytes;
+    size3       fbytes;
+    size3       abytes;
+    size3       tfiles;
+    size3       ffiles;
+    size3       afiles;
+    uint32      invarsec;
+};
+
+struct fsstat3_resfail {
+    post_op_attr obj_attributes;
+};
+
+union fsstat3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    fsstat3_resok resok;
+default:
+    fsstat3_resfail resfail;
+};
+
+/* FSINFO
+ */
+const FSF3_LINK         = 0x0001;
+const FSF3_SYMLINK      = 0x0002;
+const FSF3_HOMOGENEOUS  = 0x0008;
+const FSF3_CANSETTIME   = 0x0010;
+
+struct fsinfo3_args {
+    nfs_fh3     fsroot;
+};
+
+struct fsinfo3_resok {
+    post_op_attr obj_attributes;
+    uint32      rtmax;
+    uint32      rtpref;
+    uint32      rtmult;
+    uint32      wtmax;
+    uint32      wtpref;
+    uint32      wtmult;
+    uint32      dtpref;
+    size3       maxfilesize;
+    nfstime3    time_delta;
+    uint32      properties;
+};
+
+struct fsinfo3_resfail {
+    post_op_attr obj_attributes;
+};
+
+union fsinfo3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    fsinfo3_resok resok;
+default:
+    fsinfo3_resfail resfail;
+};
+
+/* PATHCONF
+ */
+struct pathconf3_args {
+    nfs_fh3     object;
+};
+
+struct pathconf3_resok {
+    post_op_attr obj_attributes;
+    uint32      linkmax;
+    uint32      name_max;
+    bool        no_trunc;
+    bool        chown_restricted;
+    bool        case_insensitive;
+    bool        case_preserving;
+};
+
+struct pathconf3_resfail {
+    post_op_attr obj_attributes;
+};
+
+union pathconf3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    pathconf3_resok resok;
+default:
+    pathconf3_resfail resfail;
+};
+
+/* COMMIT
+ */
+struct commit3_args {
+    nfs_fh3     file;
+    offset3     offset;
+    count3      count;
+};
+
+struct commit3_resok {
+    wcc_data    file_wcc;
+    writeverf3  verf;
+};
+
+struct commit3_resfail {
+    wcc_data    file_wcc;
+};
+
+union commit3_res switch (nfsstat3 status) {
+case NFS3_OK:
+    commit3_resok resok;
+default:
+    commit3_resfail resfail;
+};
+
+program NFS_PROGRAM {
+    version NFS_V3 {
+        void                NFS3_NULL(void)                     = 0;
+        getattr3_res        NFS3_GETATTR(getattr3_args)         = 1;
+        setattr3_res        NFS3_SETATTR(setattr3_args)         = 2;
+        lookup3_res         NFS3_LOOKUP(lookup3_args)           = 3;
+        access3_res         NFS3_ACCESS(access3_args)           = 4;
+        readlink3_res       NFS3_READLINK(readlink3_args)       = 5;
+        read3_res           NFS3_READ(read3_args)               = 6;
+        write3_res          NFS3_WRITE(write3_args)             = 7;
+        create3_res         NFS3_CREATE(create3_args)           = 8;
+        mkdir3_res          NFS3_MKDIR(mkdir3_args)             = 9;
+        symlink3_res        NFS3_SYMLINK(symlink3_args)         = 10;
+        mknod3_res          NFS3_MKNOD(mknod3_args)             = 11;
+        remove3_res         NFS3_REMOVE(remove3_args)           = 12;
+        rmdir3_res          NFS3_RMDIR(rmdir3_args)             = 13;
+        rename3_res         NFS3_RENAME(rename3_args)           = 14;
+        link3_res           NFS3_LINK(link3_args)               = 15;
+        readdir3_res        NFS3_READDIR(readdir3_args)         = 16;
+        readdirplus3_res    NFS3_READDIRPLUS(readdirplus3_args) = 17;
+        fsstat3_res         NFS3_FSSTAT(fsstat3_args)           = 18;
+        fsinfo3_res         NFS3_FSINFO(fsinfo3_args)           = 19;
+        pathconf3_res       NFS3_PATHCONF(pathconf3_args)       = 20;
+        commit3_res         NFS3_COMMIT(commit3_args)           = 21;
+    } = 3;
+} = 100003;
+
+
+/* MOUNTv3
+ */
+const MNTPATHLEN    = 1024;
+const MNTNAMLEN     = 255;
+const FHSIZE3       = 64;
+
+typedef opaque  fhandle3<FHSIZE3>;
+typedef string  dirpath<MNTPATHLEN>;
+typedef string  mntname3<MNTNAMLEN>;
+
+enum mountstat3 {
+    MNT3_OK             = 0,
+    MNT3ERR_PERM        = 1,
+    MNT3ERR_NOENT       = 2,
+    MNT3ERR_IO          = 5,
+    MNT3ERR_ACCES       = 13,
+    MNT3ERR_NOTDIR      = 20,
+    MNT3ERR_INVAL       = 22,
+    MNT3ERR_NAMETOOLONG = 63,
+    MNT3ERR_NOTSUPP     = 10004,
+    MNT3ERR_SERVERFAULT = 10006
+};
+
+struct mountres3_ok {
+    fhandle3    fhandle;
+    int         auth_flavors<>;
+};
+
+union mountres3 switch (mountstat3 fhs_status) {
+case MNT3_OK:
+    mountres3_ok mountinfo;
+default:
+    void;
+};
+
+typedef struct mountbody *mountlist;
+
+struct mountbody {
+    mntname3    ml_hostname;
+    dirpath     ml_directory;
+    mountlist   ml_next;
+};
+
+typedef struct groupnode *groups;
+
+struct groupnode {
+    mntname3    gr_name;
+    groups      gr_next;
+};
+
+typedef struct exportnode *exports;
+
+struct exportnode {
+    dirpath     ex_dir;
+    groups      ex_groups;
+    exports     ex_next;
+};
+
+program MOUNT_PROGRAM {
+    version MOUNT_V3 {
+        void        MOUNT3_NULL(void)       = 0;
+        mountres3   MOUNT3_MNT(dirpath)     = 1;
+        mountlist   MOUNT3_DUMP(void)       = 2;
+        void        MOUNT3_UMNT(dirpath)    = 3;
+        void        MOUNT3_UMNTALL(void)    = 4;
+        exports     MOUNT3_EXPORT(void)     = 5;
+    } = 3;
+} = 100005;
@@ -36,6 +36,8 @@
 #include <errno.h>
 #include <limits.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <sysexits.h>
 
 #include <rpc/types.h>
 #include <rpc/auth.h>
@@ -45,17 +47,29 @@
 #include "main.h"
 #include "nct.h"
 #include "nct_nfs.h"
+#include "nct_xdr.h"
 #include "nct_mount.h"
+#include "nct_offgen.h"
 #include "nct_read.h"
 
 typedef struct {
-    off_t   pr_offset;
-    size_t  pr_length;
-    int     pr_duration;
+    nct_offgen_t   *pr_offgen;
+    uint64_t        pr_wss;
+    size_t          pr_length;
+    int             pr_duration;
+    bool            pr_sink;
+    int             pr_sinkfd;
 } test_read_priv_t;
 
 static size_t length = 4096;
 static char *rhostpath;
+static bool sink;
+static char *sinkpath;
+static char *pattern = "seq";
+static char *layout = "shared";
+static u_long seed;
+static bool unaligned;
+static u_long wss;
 
 static struct clp_posparam posparamv[] = {
     CLP_POSPARAM("rhostpath", string, rhostpath, NULL, NULL, "[user@]rhost:path"),
@@ -64,6 +78,13 @@ static struct clp_posparam posparamv[] = {
 };
 
 static struct clp_option optionv[] = {
+    CLP_OPTION('f', string, sinkpath, NULL, "splice the data read into the given local file"),
+    CLP_OPTION('P', string, layout, NULL, "partitioning of the working set among the jobs [shared,region,stripe]"),
+    CLP_OPTION('p', string, pattern, NULL, "access pattern [seq,uniform,zipf[:theta],hotspot[:frac[:prob]],stride:bytes,streams:n]"),
+    CLP_OPTION('r', u_long, seed, NULL, "seed of the random access patterns"),
+    CLP_OPTION('s', bool, sink, NULL, "discard the data read without copying it"),
+    CLP_OPTION('u', bool, unaligned, NULL, "displace offsets randomly within the read length"),
+    CLP_OPTION('w', u_long, wss, NULL, "working set size (bytes from the start of the file)"),
     CLP_OPTION_VERBOSITY(verbosity),
     CLP_OPTION_HELP,
     CLP_OPTION_END
@@ -72,6 +93,23 @@ static struct clp_option optionv[] = {
 static int test_read_start(struct nct_req *req);
 static int test_read_cb(struct nct_req *req);
 
+/* Encode a read request, and arrange for the data read to be sunk
+ * by the receive path if so requested.
+ */
+static void
+test_read_encode(struct nct_req *req, off_t offset)
+{
+    test_read_priv_t *priv = req->req_priv;
+
+    nct_nfs_read3_encode(req, offset, priv->pr_length);
+
+    if (priv->pr_sink) {
+        req->req_sink = nct_nfs_read3_sink;
+        req->req_sinkfd = priv->pr_sinkfd;
+        req->req_sinkoff = offset;
+    }
+}
+
 static bool
 given(int c)
 {
@@ -79,7 +117,8 @@ given(int c)
 }
 
 void *
-test_read_init(int argc, char **argv, int duration, start_t **startp, char **rhostpathp)
+test_read_init(int argc, char **argv, int duration, start_t **startp,
+               char **rhostpathp, size_t *msgszp)
 {
     test_read_priv_t *priv;
     int rc;
@@ -100,52 +139,88 @@ test_read_init(int argc, char **argv, int duration, start_t **startp, char **rho
         abort();
     }
 
-    priv->pr_offset = 0;
+    priv->pr_offgen = nct_offgen_create(pattern, layout, seed, unaligned);
+    if (!priv->pr_offgen)
+        exit(EX_USAGE);
+
+    priv->pr_wss = wss;
     priv->pr_length = length;
     priv->pr_duration = duration;
+    priv->pr_sink = sink || sinkpath;
+    priv->pr_sinkfd = -1;
+
+    if (sinkpath) {
+        priv->pr_sinkfd = open(sinkpath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (priv->pr_sinkfd == -1) {
+            eprint("open(%s) failed: %s\n", sinkpath, strerror(errno));
+            exit(EX_CANTCREAT);
+        }
+    }
 
-    if (priv->pr_length < 512 || priv->pr_length > NCT_MSGSZ_MAX) {
+    if (priv->pr_length < 512 || priv->pr_length > NCT_MSGSZ_MAX - NCT_MSGSZ_MIN) {
         eprint("invalid read length %zu\n", priv->pr_length);
         abort();
     }
 
+    /* The reply must fit into a message buffer unless its data is
+     * sunk, in which case only the headers are retained.
+     */
+    *msgszp = priv->pr_sink ? NCT_MSGSZ_MIN : priv->pr_length + NCT_MSGSZ_MIN;
+
     *startp = test_read_start;
     *rhostpathp = rhostpath;
 
     return priv;
 }
 
+void
+test_read_fini(void *arg)
+{
+    test_read_priv_t *priv = arg;
+
+    if (priv->pr_sinkfd != -1)
+        close(priv->pr_sinkfd);
+
+    nct_offgen_destroy(priv->pr_offgen);
+    free(priv);
+}
+
 static int
 test_read_cb(struct nct_req *req)
 {
     test_read_priv_t *priv = req->req_priv;
-    nct_mnt_t *mnt = req->req_mnt;
-    nct_vn_t *vn = mnt->mnt_vn;
-    off_t offset;
-
-    XDR_DESTROY(&req->req_msg->msg_xdr);
+    nct_msg_t *msg = req->req_msg;
+    enum clnt_stat stat;
+    read3_res res;
 
-    if (req->req_msg->msg_stat != RPC_SUCCESS) {
-        eprint("read failed: %d %s\n",
-               req->req_msg->msg_stat, clnt_sperrno(req->req_msg->msg_stat));
+    stat = msg->msg_stat;
+    if (stat != RPC_SUCCESS) {
+        eprint("read failed: %d %s\n", stat, clnt_sperrno(stat));
         nct_req_free(req);
-        return req->req_msg->msg_stat;
+        return stat;
     }
 
-    if (req->req_tsc_stop >= req->req_tsc_finish) {
+    if (!nct_xdr_read3_res(msg->msg_data + msg->msg_resoff,
+                           msg->msg_len - msg->msg_resoff, &res)) {
+        eprint("read reply truncated: len=%zu\n", msg->msg_len);
         nct_req_free(req);
-        return ETIMEDOUT;
+        return EPROTO;
     }
 
-    offset = __sync_fetch_and_add(&priv->pr_offset, priv->pr_length);
+    if (res.status != NFS3_OK) {
+        eprint("read nfs failed: nfsstat3=%d %s\n",
+               res.status, strerror_nfsstat3(res.status));
+        nct_req_free(req);
+        return res.status;
+    }
 
-    if (offset + priv->pr_length > vn->xvn_fattr.size) {
-        offset = __sync_fetch_and_sub(&priv->pr_offset, priv->pr_offset);
+    if (req->req_tsc_stop >= req->req_tsc_finish) {
+        nct_req_free(req);
+        return ETIMEDOUT;
     }
 
-    req->req_tsc_start = rdtsc();
-    nct_nfs_read3_encode(req, offset, priv->pr_length);
-    nct_req_send(req);
+    test_read_encode(req, nct_offgen_next(priv->pr_offgen, req->req_job));
+    nct_req_issue(req);
 
     return 0;
 }
@@ -154,26 +229,43 @@ static int
 test_read_start(struct nct_req *req)
 {
     test_read_priv_t *priv = req->req_priv;
+    nct_offgen_t *og = priv->pr_offgen;
     nct_mnt_t *mnt = req->req_mnt;
-    nct_vn_t *vn = mnt->mnt_vn;
-    off_t offset;
+    uint64_t size;
+    int rc;
 
     req->req_tsc_finish = rdtsc() + (tsc_freq * priv->pr_duration);
     req->req_cb = test_read_cb;
 
-    offset = __sync_fetch_and_add(&priv->pr_offset, priv->pr_length);
-
-    if (offset + priv->pr_length > vn->xvn_fattr.size) {
-        eprint("file smaller than request length: size=%lu length=%zu\n",
-               vn->xvn_fattr.size, priv->pr_length);
-        return EINVAL;
+    /* Jobs are started one at a time, so the first one sizes the
+     * offset generator for all (offsets apply to every target file,
+     * so the smallest one bounds the working set).
+     */
+    if (!og->og_jobv) {
+        size = nct_mnt_size(mnt);
+        if (priv->pr_wss == 0 || priv->pr_wss > size)
+            priv->pr_wss = size;
+
+        if (priv->pr_length > priv->pr_wss) {
+            eprint("file smaller than request length: size=%lu length=%zu\n",
+                   priv->pr_wss, priv->pr_length);
+            return EINVAL;
+        }
+
+        rc = nct_offgen_setup(og, priv->pr_wss, priv->pr_length, req->req_jobs);
+        if (rc)
+            return rc;
+
+        if (mnt->mnt_rtmax > 0 && priv->pr_length > mnt->mnt_rtmax) {
+            eprint("read length %zu exceeds the server's rtmax %u, replies will be short\n",
+                   priv->pr_length, mnt->mnt_rtmax);
+        }
     }
 
     usleep(1000);
 
-    req->req_tsc_start = rdtsc();
-    nct_nfs_read3_encode(req, offset, priv->pr_length);
-    nct_req_send(req);
+    test_read_encode(req, nct_offgen_next(og, req->req_job));
+    nct_req_issue(req);
 
     return 0;
 }
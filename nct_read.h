@@ -4,6 +4,8 @@
 #ifndef NCT_READ_H
 #define NCT_READ_H
 
-extern void *test_read_init(int argc, char **argv, int duration, start_t **startp, char **rhostpathp);
+extern void *test_read_init(int argc, char **argv, int duration, start_t **startp,
+                            char **rhostpathp, size_t *msgszp);
+extern void test_read_fini(void *priv);
 
 #endif // NCT_READ_H
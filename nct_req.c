@@ -23,6 +23,10 @@
  * SUCH DAMAGE.
  */
 
+#if __linux__
+#define _GNU_SOURCE         // for splice(), pipe2(), and F_SETPIPE_SZ
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -37,10 +41,18 @@
 #include <sysexits.h>
 #include <sys/select.h>
 #include <sys/mman.h>
+#include <fcntl.h>
+#include <poll.h>
+#if __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/errqueue.h>
+#endif
 
 #include <limits.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -55,318 +67,2126 @@
 #include "nct.h"
 #include "nct_rpc.h"
 #include "nct_req.h"
+#include "nct_uring.h"
+#include "nct_pace.h"
+#include "nct_win.h"
 
-void *
-nct_req_recv_loop(void *arg)
+/* Each thread that completes requests does so into its own stats
+ * shard, which it creates and links onto the mount upon its first
+ * completion.
+ */
+static __thread struct {
+    nct_mnt_t   *shard_mnt;
+    nct_shard_t *shard;
+} nct_req_shard;
+
+static nct_shard_t *
+nct_req_shard_get(nct_mnt_t *mnt)
 {
-    struct nct_stats stats;
-    uint64_t tsc_stats, tsc_stop, tsc_diff;
-    nct_mnt_t *mnt = arg;
-    nct_req_t *req0;
-    uint32_t *markp;
-    nct_msg_t *msg;
-    int rc;
+    nct_shard_t *shard;
+    size_t sz;
+
+    if (likely(nct_req_shard.shard_mnt == mnt))
+        return nct_req_shard.shard;
 
-    req0 = nct_req_alloc(mnt);
-    if (!req0)
+    sz = sizeof(*shard) + sizeof(shard->shard_connv[0]) * mnt->mnt_conns_max;
+    sz = (sz + 63) & ~(size_t)63;
+
+    shard = aligned_alloc(64, sz);
+    if (!shard)
         abort();
 
-    msg = req0->req_msg;
-    assert(msg);
+    memset(shard, 0, sz);
+    shard->shard_latency_min = UINT64_MAX;
+    shard->shard_epoch = __atomic_load_n(&mnt->mnt_stats_epoch, __ATOMIC_RELAXED);
+    shard->shard_idx = __atomic_fetch_add(&mnt->mnt_shards_cnt, 1, __ATOMIC_RELAXED);
+    shard->shard_next = __atomic_load_n(&mnt->mnt_shard_head, __ATOMIC_RELAXED);
 
-    /* Don't wait for a subsequent RPC record mark if there isn't
-     * sufficient parallelism.
-     */
-    markp = (mnt->mnt_jobs_max > 3) ? &mnt->mnt_recv_mark : NULL;
+    while (!__atomic_compare_exchange_n(&mnt->mnt_shard_head, &shard->shard_next, shard,
+                                        false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        continue;
 
-    /* Update the mount stats record at most once per millisecond
-     * to reduce contention.
-     */
-    bzero(&stats, sizeof(stats));
-    tsc_stats = (rdtsc() % 777) * 1000;
-    tsc_stats = (tsc_stats * 1000000) / tsc_freq;
-    tsc_stats += rdtsc();
+    nct_req_shard.shard_mnt = mnt;
+    nct_req_shard.shard = shard;
 
-    while (1) {
-        const size_t rpcmin = BYTES_PER_XDR_UNIT * 6;
-        enum clnt_stat stat;
-        nct_req_t *req;
-        nct_msg_t *tmp;
-        ssize_t cc;
-        u_int idx;
-        int i;
-
-        pthread_mutex_lock(&mnt->mnt_recv_mtx);
-        cc = nct_rpc_recv(mnt->mnt_fd, msg->msg_data, NCT_MSGSZ_MAX, markp);
-
-        if (cc < rpcmin) {
-            mnt->mnt_recv_mark = 0;
-            pthread_mutex_unlock(&mnt->mnt_recv_mtx);
-
-            if (cc == 0)
-                break;
+    return shard;
+}
 
-            eprint("nct_rpc_recv() failed: %s\n", (cc == -1) ? strerror(errno) : "eof");
+/* Create the latency histogram of the given procedure in the given
+ * shard.  Called only by the owner of the shard.
+ */
+static nct_hist_t *
+nct_req_shard_hist(nct_shard_t *shard, u_int proc)
+{
+    nct_hist_t *hist;
 
-            /* TODO: Need to rework the reconnect logic now
-             * that we can have multiple recv threads...
-             */
-            rc = nct_connect(mnt);
-            if (rc)
-                abort();
+    hist = aligned_alloc(64, (sizeof(*hist) + 63) & ~(size_t)63);
+    if (!hist)
+        abort();
 
-            /* Re-send all the pending inflight requests.
-             */
-            for (i = 0; i < NCT_REQ_MAX; ++i) {
-                req = mnt->mnt_req_tbl[i];
-                if (req->req_tsc_start > req->req_tsc_stop) {
-                    req->req_tsc_stop = rdtsc();
-                    mnt->mnt_stats.latency_cum += req->req_tsc_stop - req->req_tsc_start;
-                    nct_req_send(req);
-                }
-            }
+    memset(hist, 0, sizeof(*hist));
+    __atomic_store_n(&shard->shard_histv[proc], hist, __ATOMIC_RELEASE);
+
+    return hist;
+}
+
+/* Fold the stats accumulated by the receive path of the given
+ * connection into the given shard, which must have been entered.
+ */
+static void
+nct_req_stats_fold(nct_shard_t *shard, nct_conn_t *conn, struct nct_stats *stats)
+{
+    struct nct_stats *cs = shard->shard_connv + conn->conn_idx;
 
+    cs->latency_cum += stats->latency_cum;
+    cs->thruput_send += stats->thruput_send;
+    cs->thruput_recv += stats->thruput_recv;
+    cs->recvs += stats->recvs;
+    cs->strays += stats->strays;
+    cs->updates++;
+
+    bzero(stats, sizeof(*stats));
+}
+
+/* Fold the given stats into the calling thread's stats shard.
+ */
+static void
+nct_req_stats_flush(nct_conn_t *conn, struct nct_stats *stats)
+{
+    nct_shard_t *shard = nct_req_shard_get(conn->conn_mnt);
+
+    nct_shard_enter(shard);
+    nct_req_stats_fold(shard, conn, stats);
+    nct_shard_leave(shard);
+}
+
+/* Resend the given list of requests collected by nct_req_reconnect(),
+ * each with a new xid.
+ */
+static void
+nct_req_resend(nct_req_t *head)
+{
+    nct_req_t *req;
+
+    while ((req = head)) {
+        head = req->req_next;
+        nct_req_send(req);
+    }
+}
+
+/* Shut down the socket of the given connection after a send on it
+ * failed with the given error, so that the receive side of the
+ * connection sees EOF and reconnects (see nct_req_reconnect()).  The
+ * requests of the failed send are in the connection's request table,
+ * and so are resent along with all the others in flight.  Called with
+ * conn_send_mtx held.
+ */
+static void
+nct_req_send_failed(nct_conn_t *conn, int err)
+{
+    if (conn->conn_broken)
+        return;
+
+    eprint("send on conn %u failed: %s\n", conn->conn_idx, strerror(err));
+
+    __atomic_store_n(&conn->conn_broken, true, __ATOMIC_SEQ_CST);
+    shutdown(conn->conn_fd, SHUT_RDWR);
+}
+
+/* Replace the socket of the given connection after a receive error (or
+ * EOF following a failed send), and take all the requests in flight on
+ * it out of its request table.  Returns the requests, which the caller
+ * must resend via nct_req_resend().  Called only by the receive side of
+ * the connection once it has discarded all partially received data.
+ * The requests are collected before any is resent, as a resent request
+ * might otherwise be found again further along in the table.  Requests
+ * queued for the io_uring engine are all in the table, so the queue is
+ * dropped lest they be queued twice.
+ */
+static nct_req_t *
+nct_req_reconnect(nct_conn_t *conn, struct nct_stats *stats)
+{
+    nct_req_t *head = NULL;
+    nct_req_t *req;
+    int rc, i;
+
+    pthread_mutex_lock(&conn->conn_send_mtx);
+    shutdown(conn->conn_fd, SHUT_RDWR);
+
+    rc = nct_connect(conn);
+    if (rc) {
+        eprint("nct_connect() failed: %s\n", strerror(rc));
+        abort();
+    }
+
+    conn->conn_txhead = NULL;
+    __atomic_store_n(&conn->conn_broken, false, __ATOMIC_SEQ_CST);
+    ++conn->conn_gen;
+
+    for (i = 0; i <= conn->conn_req_mask; ++i) {
+        req = __atomic_load_n(&conn->conn_req_tbl[i].slot_req, __ATOMIC_ACQUIRE);
+        if (!req)
             continue;
-        }
 
-        if (mnt->mnt_recv_mark)
-            ++stats.marks;
-        pthread_mutex_unlock(&mnt->mnt_recv_mtx);
+        req->req_tsc_stop = rdtsc();
+        stats->latency_cum += req->req_tsc_stop - req->req_tsc_start;
 
-        stat = nct_rpc_decode(&msg->msg_xdr, msg->msg_data, cc, &msg->msg_rpc, &msg->msg_err);
+        __atomic_store_n(&conn->conn_req_tbl[i].slot_req, NULL, __ATOMIC_RELEASE);
+        req->req_next = head;
+        head = req;
+    }
+    pthread_mutex_unlock(&conn->conn_send_mtx);
 
-        if (stat != RPC_SUCCESS) {
-            dprint(1, "nct_rpc_decode(%p, %ld) failed: %d %s\n",
-                   msg, cc, stat, clnt_sperrno(stat));
+    return head;
+}
 
-            /* TODO: For which errors is rm_xid not valid?
-             */
-            if (stat == RPC_CANTDECODERES)
-                abort();
+/* Advance the iovec of the given message header past the cc bytes
+ * of a short send, so as to continue where it left off.
+ */
+static void
+nct_req_iov_advance(struct msghdr *hdr, size_t cc)
+{
+    while (cc > 0 && hdr->msg_iovlen > 0) {
+        if (cc < hdr->msg_iov->iov_len) {
+            hdr->msg_iov->iov_base += cc;
+            hdr->msg_iov->iov_len -= cc;
+            break;
         }
 
-        idx = msg->msg_rpc.rm_xid % NCT_REQ_MAX;
-        req = mnt->mnt_req_tbl[idx];
-        mnt->mnt_req_tbl[idx] = NULL;
+        cc -= hdr->msg_iov->iov_len;
+        hdr->msg_iov++;
+        hdr->msg_iovlen--;
+    }
+}
 
-        if (req->req_xid != msg->msg_rpc.rm_xid)
-            abort();
+/* Fill in the record mark of the given request's call, and set up iov
+ * to send the call from its message buffer followed by its payload (if
+ * any) in place.  Returns the number of iovecs used (at most two).
+ */
+static int
+nct_req_txiov(nct_req_t *req, struct iovec *iov)
+{
+    nct_msg_t *msg = req->req_msg;
 
-        req->req_tsc_stop = rdtsc();
-        tsc_stop = req->req_tsc_stop;
+    nct_rpc_mark(msg->msg_data, msg->msg_len + req->req_paylen);
 
-        /* Update cumulative stats.
-         */
-        tsc_diff = tsc_stop - req->req_tsc_start;
-        stats.latency_cum += req->req_tsc_stop - req->req_tsc_start;
-        stats.thruput_send += req->req_msg->msg_len;
-        stats.thruput_recv += cc;
-        stats.requests++;
+    iov[0].iov_base = msg->msg_data;
+    iov[0].iov_len = msg->msg_len;
 
-        msg->msg_len = cc;
-        msg->msg_stat = stat;
+    if (req->req_paylen == 0)
+        return 1;
 
-        /* Exchange the message buffer.
-         */
-        tmp = req->req_msg;
-        req->req_msg = msg;
-        msg = tmp;
+    iov[1].iov_base = (void *)req->req_payload;
+    iov[1].iov_len = req->req_paylen;
 
-        req->req_done = true;
+    return 2;
+}
 
-        if (req->req_cb) {
-            rc = req->req_cb(req);
-            if (rc) {
-                int n;
+/* Reap the completion notifications of the given connection's zerocopy
+ * sends from its socket error queue, which would otherwise fill up and
+ * make further zerocopy sends fail with ENOBUFS.  The payloads are never
+ * modified, so the notifications are merely counted.  The message
+ * buffers might be reused for replies before their sends complete, but
+ * not before the server has received the calls in full.
+ */
+static void
+nct_req_zc_reap(nct_conn_t *conn)
+{
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    char cbuf[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+    struct sock_extended_err *serr;
+    struct cmsghdr *cmsg;
+    struct msghdr hdr;
+    uint32_t n;
 
-                n = __atomic_sub_fetch(&mnt->mnt_jobs_cnt, 1, __ATOMIC_SEQ_CST);
-                if (n == 0)
-                    shutdown(mnt->mnt_fd, SHUT_WR);
-            }
-        }
-        else {
-            pthread_mutex_lock(&mnt->mnt_wait_mtx);
-            if (mnt->mnt_wait_waiters > 0)
-                pthread_cond_broadcast(&mnt->mnt_wait_cv);
-            pthread_mutex_unlock(&mnt->mnt_wait_mtx);
-        }
+    while (1) {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_control = cbuf;
+        hdr.msg_controllen = sizeof(cbuf);
 
-        if (tsc_stop < tsc_stats)
-            continue;
+        if (recvmsg(conn->conn_fd, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+            break;
 
-        pthread_spin_lock(&mnt->mnt_stats_spin);
-        if (tsc_diff < mnt->mnt_stats.latency_min)
-            mnt->mnt_stats.latency_min = tsc_diff;
-        if (tsc_diff > mnt->mnt_stats.latency_max)
-            mnt->mnt_stats.latency_max = tsc_diff;
-        mnt->mnt_stats.latency_cum += stats.latency_cum;
-        mnt->mnt_stats.thruput_send += stats.thruput_send;
-        mnt->mnt_stats.thruput_recv += stats.thruput_recv;
-        mnt->mnt_stats.requests += stats.requests;
-        mnt->mnt_stats.marks += stats.marks;
-        mnt->mnt_stats.updates++;
-        pthread_spin_unlock(&mnt->mnt_stats_spin);
-
-        /* Extend the next stats update by 1000us.
-         */
-        tsc_stats += (1000 * 1000000) / tsc_freq;
-        bzero(&stats, sizeof(stats));
+        for (cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR)
+                continue;
+
+            serr = (void *)CMSG_DATA(cmsg);
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+
+            n = serr->ee_data - serr->ee_info + 1;
+
+            __atomic_add_fetch(&conn->conn_zc_sends, n, __ATOMIC_RELAXED);
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                __atomic_add_fetch(&conn->conn_zc_copied, n, __ATOMIC_RELAXED);
+        }
     }
+#endif
+}
 
-    pthread_exit(NULL);
+/* Return the flags with which to send a batch of calls carrying the
+ * given number of payload bytes.
+ */
+static int
+nct_req_txflags(nct_conn_t *conn, size_t paylen)
+{
+    int flags = MSG_NOSIGNAL;
+
+#ifdef MSG_ZEROCOPY
+    if (conn->conn_zerocopy && paylen >= NCT_ZEROCOPY_MIN)
+        flags |= MSG_ZEROCOPY;
+#endif
+
+    return flags;
 }
 
-/* Send a request.
+/* Send the records described by hdr in full, polling for writability
+ * if the socket is nonblocking.  Returns -1 (with errno set) on error.
  */
-void
-nct_req_send(nct_req_t *req)
+static int
+nct_req_sendmsg(nct_conn_t *conn, struct msghdr *hdr, int flags)
 {
-    nct_mnt_t *mnt = req->req_mnt;
-    struct rpc_msg *msg;
-    uint32_t xid;
     ssize_t cc;
 
-    msg = (void *)req->req_msg->msg_data + 4;
-    req->req_done = false;
+    while (hdr->msg_iovlen > 0) {
+        cc = sendmsg(conn->conn_fd, hdr, flags);
+        if (cc == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = { .fd = conn->conn_fd, .events = POLLOUT };
 
-    /* Increase the xid by a prime number to reduce cache line
-     * thrashing on mnt_req_tbl[] between send and recv threads.
-     */
-    pthread_mutex_lock(&mnt->mnt_send_mtx);
-    xid = mnt->mnt_send_xid;
-    mnt->mnt_send_xid += 11;
+                poll(&pfd, 1, -1);
+                continue;
+            }
 
-    msg->rm_xid = htonl(xid);
-    mnt->mnt_req_tbl[xid % NCT_REQ_MAX] = req;
-    req->req_xid = xid;
+            if (errno == ENOBUFS && flags != MSG_NOSIGNAL) {
+                nct_req_zc_reap(conn);
+                sched_yield();
+                continue;
+            }
 
-    cc = nct_rpc_send(mnt->mnt_fd, req->req_msg->msg_data, req->req_msg->msg_len);
-    pthread_mutex_unlock(&mnt->mnt_send_mtx);
+            if (errno == EINTR)
+                continue;
 
-    if (cc != req->req_msg->msg_len) {
-        // TODO...
-        abort();
+            return -1;
+        }
+
+        nct_req_iov_advance(hdr, cc);
+    }
+
+    if (flags != MSG_NOSIGNAL)
+        nct_req_zc_reap(conn);
+
+    return 0;
+}
+
+/* Retire a job, and shut down the connections once the last job of
+ * the mount has finished (unless the mount is to be reused).
+ */
+static void
+nct_req_jobs_dec(nct_mnt_t *mnt)
+{
+    int i;
+
+    if (__atomic_sub_fetch(&mnt->mnt_jobs_cnt, 1, __ATOMIC_SEQ_CST) == 0 &&
+        !(mnt->mnt_flags & NCT_MNT_REUSE)) {
+        for (i = 0; i < mnt->mnt_conns_max; ++i)
+            shutdown(mnt->mnt_connv[i].conn_fd, SHUT_WR);
     }
 }
 
-/* Wait for the reply to the specified request to arrive.
+/* Free the given request and retire its job (e.g., a request that the
+ * pacer parked past the end of the run).
  */
 void
-nct_req_wait(nct_req_t *req)
+nct_req_exit(nct_req_t *req)
 {
     nct_mnt_t *mnt = req->req_mnt;
 
-    pthread_mutex_lock(&mnt->mnt_wait_mtx);
-    while (!req->req_done) {
-        ++mnt->mnt_wait_waiters;
-        pthread_cond_wait(&mnt->mnt_wait_cv, &mnt->mnt_wait_mtx);
-        --mnt->mnt_wait_waiters;
-    }
-    pthread_mutex_unlock(&mnt->mnt_wait_mtx);
+    nct_req_free(req);
+    nct_req_jobs_dec(mnt);
 }
 
-/* Allocate a request object from the free pool.
+/* Complete the given request, whose reply has been placed into its
+ * message buffer by nct_req_rx_parse().  The request callback is
+ * called (or the waiter is awakened).
  */
-nct_req_t *
-nct_req_alloc(nct_mnt_t *mnt)
+static void
+nct_req_recv_done(nct_conn_t *conn, nct_req_t *req, uint64_t tsc_stop)
 {
-    nct_req_t *req;
+    nct_mnt_t *mnt = conn->conn_mnt;
+    nct_msg_t *msg = req->req_msg;
+    enum clnt_stat stat;
+    int rc;
 
-    pthread_mutex_lock(&mnt->mnt_req_mtx);
-    while (!mnt->mnt_req_head) {
-        ++mnt->mnt_req_waiters;
-        pthread_cond_wait(&mnt->mnt_req_cv, &mnt->mnt_req_mtx);
-        --mnt->mnt_req_waiters;
+    stat = nct_rpc_decode(&msg->msg_xdr, msg->msg_data, msg->msg_len, &msg->msg_rpc, &msg->msg_err);
+    msg->msg_resoff = XDR_GETPOS(&msg->msg_xdr);
+
+    if (stat != RPC_SUCCESS) {
+        dprint(1, "nct_rpc_decode(%p, %ld) failed: %d %s\n",
+               msg, msg->msg_len, stat, clnt_sperrno(stat));
+
+        if (stat == RPC_CANTDECODERES)
+            abort();
     }
 
-    req = mnt->mnt_req_head;
-    mnt->mnt_req_head = req->req_next;
-    pthread_mutex_unlock(&mnt->mnt_req_mtx);
+    req->req_tsc_stop = tsc_stop;
 
-    req->req_cb = NULL;
-    req->req_done = 0;
+    msg->msg_stat = stat;
 
-    return req;
+    req->req_done = true;
+
+    if (req->req_cb) {
+        rc = req->req_cb(req);
+        if (rc) {
+            if (mnt->mnt_win)
+                nct_win_exit(mnt->mnt_win);
+            nct_req_jobs_dec(mnt);
+        }
+    }
+    else {
+        pthread_mutex_lock(&mnt->mnt_wait_mtx);
+        if (mnt->mnt_wait_waiters > 0)
+            pthread_cond_broadcast(&mnt->mnt_wait_cv);
+        pthread_mutex_unlock(&mnt->mnt_wait_mtx);
+    }
 }
 
-/* Return a request object to the free pool.
+/* Sink n payload bytes of the reply being assembled that have already
+ * been received into memory at buf.
  */
-void
-nct_req_free(nct_req_t *req)
+static void
+nct_req_rx_sinkcopy(nct_conn_t *conn, const char *buf, size_t n)
 {
-    nct_mnt_t *mnt = req->req_mnt;
+    size_t len;
 
-    pthread_mutex_lock(&mnt->mnt_req_mtx);
-    req->req_next = mnt->mnt_req_head;
-    mnt->mnt_req_head = req;
-    if (mnt->mnt_req_waiters > 0) {
-        pthread_cond_signal(&mnt->mnt_req_cv);
+    len = (n < conn->conn_rxsinkdata) ? n : conn->conn_rxsinkdata;
+
+    if (len > 0 && conn->conn_rxsinkfd != -1) {
+        if (pwrite(conn->conn_rxsinkfd, buf, len, conn->conn_rxsinkoff) != len) {
+            eprint("pwrite() failed: %s\n", strerror(errno));
+            abort();
+        }
+
+        conn->conn_rxsinkoff += len;
     }
-    pthread_mutex_unlock(&mnt->mnt_req_mtx);
+
+    conn->conn_rxsinkdata -= len;
+    conn->conn_rxsink -= n;
+    conn->conn_rxskip += n;
 }
 
-/* Create a pool of request objects.
+#if __linux__
+/* Move n payload bytes that have been spliced from the socket into
+ * the connection's pipe on into the sink file.
  */
-void
-nct_req_create(nct_mnt_t *mnt)
+static void
+nct_req_rx_sinkpipe(nct_conn_t *conn, size_t n)
 {
-    void *msgbase, *reqbase;
-    size_t msgsz, tblsz, sz;
-    int flags, prot;
-    nct_req_t *req;
-    int super = 0;
-    int i;
+    loff_t off = conn->conn_rxsinkoff;
+    ssize_t cc;
+    size_t len;
 
-#if __FreeBSD__
-    super = MAP_ALIGNED_SUPER;
-#elif __linux__
-    super = MAP_HUGETLB;
+    for (len = n; len > 0; len -= cc) {
+        cc = splice(conn->conn_sinkpipe[0], NULL, conn->conn_rxsinkfd, &off, len, SPLICE_F_MOVE);
+        if (cc < 1) {
+            eprint("splice() failed: %s\n", (cc == -1) ? strerror(errno) : "eof");
+            abort();
+        }
+    }
+
+    conn->conn_rxsinkoff = off;
+    conn->conn_rxsinkdata -= n;
+    conn->conn_rxsink -= n;
+    conn->conn_rxskip += n;
+}
 #endif
 
-    flags = MAP_ANONYMOUS | MAP_PRIVATE;
-    prot = PROT_READ | PROT_WRITE;
+/* Determine whether the reply being assembled into conn_rxmsg has a
+ * payload that should be sunk rather than copied (see nct_req_sink_t).
+ */
+static void
+nct_req_rx_sinkchk(nct_conn_t *conn)
+{
+    char *data = conn->conn_rxmsg->msg_data;
+    size_t payload, excess, n;
+    ssize_t hdrlen;
+    nct_req_t *req;
+    uint32_t xid;
 
-    msgsz = sizeof(nct_msg_t) + NCT_MSGSZ_MAX;
-    sz = (NCT_REQ_MAX + 1) * msgsz;
-    sz = (sz + (2u << 20) - 1) & ~((2u << 20) - 1);
+    if (conn->conn_rxlen < sizeof(xid))
+        return;
 
-  again:
-    msgbase = mmap(NULL, sz, prot, flags | super, -1, 0);
-    if (msgbase == MAP_FAILED) {
-        if (super) {
-            super = 0;
-            goto again;
+    memcpy(&xid, data, sizeof(xid));
+    xid = ntohl(xid);
+
+    req = __atomic_load_n(&conn->conn_req_tbl[xid & conn->conn_req_mask].slot_req, __ATOMIC_ACQUIRE);
+    if (!req || req->req_xid != xid || !req->req_sink) {
+        conn->conn_rxsinkst = NCT_RX_SINK_NONE;
+        return;
+    }
+
+    hdrlen = req->req_sink(data, conn->conn_rxlen, &payload);
+    if (hdrlen == 0)
+        return;
+
+    if (hdrlen < 0 || hdrlen > conn->conn_rxlen) {
+        conn->conn_rxsinkst = NCT_RX_SINK_NONE;
+        return;
+    }
+
+    conn->conn_rxsinkst = NCT_RX_SINK_ACTIVE;
+    conn->conn_rxsink = (payload + BYTES_PER_XDR_UNIT - 1) & ~(BYTES_PER_XDR_UNIT - 1);
+    conn->conn_rxsinkdata = payload;
+    conn->conn_rxsinkfd = req->req_sinkfd;
+    conn->conn_rxsinkoff = req->req_sinkoff;
+
+#if __linux__
+    if (conn->conn_rxsinkfd != -1 && conn->conn_sinkpipe[0] == -1) {
+        if (pipe2(conn->conn_sinkpipe, O_CLOEXEC)) {
+            eprint("pipe2() failed: %s\n", strerror(errno));
+            abort();
         }
 
-        dprint(0, "mmap(%zu, %x, %x) failed: %s\n",
-               sz, prot, flags, strerror(errno));
-        abort();
+        fcntl(conn->conn_sinkpipe[1], F_SETPIPE_SZ, 1024 * 1024);
+        conn->conn_sinkpipesz = fcntl(conn->conn_sinkpipe[1], F_GETPIPE_SZ);
     }
+#endif
+
+    /* Sink the part of the payload that has already been copied,
+     * keeping anything that might follow it.
+     */
+    excess = conn->conn_rxlen - hdrlen;
+    n = (excess < conn->conn_rxsink) ? excess : conn->conn_rxsink;
 
-    tblsz = NCT_REQ_MAX * sizeof(req) * 2;
-    tblsz = (tblsz + 4096 - 1) & ~(4096 - 1);
+    nct_req_rx_sinkcopy(conn, data + hdrlen, n);
+    memmove(data + hdrlen, data + hdrlen + n, excess - n);
+    conn->conn_rxlen -= n;
+}
 
-    sz = NCT_REQ_MAX * sizeof(*req) + tblsz;
-    sz = (sz + (2 << 20) - 1) & ~((2 << 20) - 1);
+/* Return the buffer into which to receive next on the given connection,
+ * and in *lenp the number of bytes to receive.  Normally that is as
+ * much as fits in the receive buffer, but the remainder of a large
+ * fragment is received directly into the message buffer to avoid
+ * copying it, and a payload to be sunk is discarded (or spliced).
+ */
+static void *
+nct_req_rx_target(nct_conn_t *conn, size_t *lenp)
+{
+    size_t avail, len;
 
-    reqbase = mmap(NULL, sz, prot, flags | super, -1, 0);
-    if (reqbase == MAP_FAILED) {
-        abort();
+    conn->conn_rxmode = NCT_RX_BUF;
+    conn->conn_rxsplice = false;
+
+    if (conn->conn_rxfrag > 0 && conn->conn_rxhead == conn->conn_rxtail) {
+        if (conn->conn_rxsink > 0) {
+            len = (conn->conn_rxfrag < conn->conn_rxsink) ? conn->conn_rxfrag : conn->conn_rxsink;
+            conn->conn_rxmode = NCT_RX_SINK;
+            conn->conn_rxhead = conn->conn_rxtail = 0;
+
+#if __linux__
+            if (conn->conn_rxsinkfd != -1 && conn->conn_rxsinkdata > 0) {
+                conn->conn_rxsplice = true;
+                if (len > conn->conn_rxsinkdata)
+                    len = conn->conn_rxsinkdata;
+                if (len > conn->conn_sinkpipesz)
+                    len = conn->conn_sinkpipesz;
+            }
+#else
+            /* The payload is received into (and discarded from) the
+             * receive buffer where MSG_TRUNC does not discard TCP data.
+             */
+            if (len > NCT_RXBUF_SZ)
+                len = NCT_RXBUF_SZ;
+#endif
+
+            *lenp = len;
+            return conn->conn_rxbuf;
+        }
+
+        if (conn->conn_rxfrag >= NCT_RXDIRECT_MIN &&
+            conn->conn_rxsinkst != NCT_RX_SINK_UNKNOWN) {
+            if (conn->conn_rxlen + conn->conn_rxfrag > conn->conn_mnt->mnt_msgsz) {
+                eprint("reply on conn %u exceeds message size %zu\n",
+                       conn->conn_idx, conn->conn_mnt->mnt_msgsz);
+                abort();
+            }
+
+            conn->conn_rxmode = NCT_RX_DIRECT;
+            *lenp = conn->conn_rxfrag;
+            return conn->conn_rxmsg->msg_data + conn->conn_rxlen;
+        }
     }
 
-    mnt->mnt_req_tbl = reqbase;
-    reqbase += tblsz;
+    /* Move the remnant of a partially received record mark to the
+     * front of the buffer.
+     */
+    if (conn->conn_rxhead > 0) {
+        avail = conn->conn_rxtail - conn->conn_rxhead;
+        memmove(conn->conn_rxbuf, conn->conn_rxbuf + conn->conn_rxhead, avail);
+        conn->conn_rxhead = 0;
+        conn->conn_rxtail = avail;
+    }
 
-    for (i = 0; i < NCT_REQ_MAX; ++i) {
-        req = (nct_req_t *)reqbase + i;
+    *lenp = NCT_RXBUF_SZ - conn->conn_rxtail;
 
-        memset(req, 0, sizeof(*req));
-        req->req_mnt = mnt;
-        req->req_msg = msgbase + (i * msgsz);
+    return conn->conn_rxbuf + conn->conn_rxtail;
+}
 
-        pthread_mutex_lock(&mnt->mnt_send_mtx);
-        req->req_next = mnt->mnt_req_head;
-        mnt->mnt_req_head = req;
-        pthread_mutex_unlock(&mnt->mnt_send_mtx);
+/* Account for cc bytes received into the target given by the most
+ * recent call to nct_req_rx_target().
+ */
+static void
+nct_req_rx_fill(nct_conn_t *conn, size_t cc)
+{
+    switch (conn->conn_rxmode) {
+    case NCT_RX_DIRECT:
+        conn->conn_rxlen += cc;
+        conn->conn_rxfrag -= cc;
+        break;
+
+    case NCT_RX_SINK:
+        conn->conn_rxfrag -= cc;
+#if __linux__
+        if (conn->conn_rxsplice) {
+            nct_req_rx_sinkpipe(conn, cc);
+            break;
+        }
+#endif
+        nct_req_rx_sinkcopy(conn, conn->conn_rxbuf, cc);
+        break;
+
+    default:
+        conn->conn_rxtail += cc;
+        break;
     }
 }
+
+/* Receive (with the given recv flags) into the target chosen by
+ * nct_req_rx_target(), for the engines that receive synchronously.
+ */
+static ssize_t
+nct_req_rx_recv(nct_conn_t *conn, int flags)
+{
+    ssize_t cc;
+    size_t len;
+    void *buf;
+
+    buf = nct_req_rx_target(conn, &len);
+
+#if __linux__
+    if (conn->conn_rxsplice)
+        cc = splice(conn->conn_fd, NULL, conn->conn_sinkpipe[1], NULL, len, SPLICE_F_MOVE);
+    else if (conn->conn_rxmode == NCT_RX_SINK)
+        cc = recv(conn->conn_fd, buf, len, flags | MSG_TRUNC);
+    else
+#endif
+        cc = recv(conn->conn_fd, buf, len, flags);
+
+    if (cc > 0)
+        nct_req_rx_fill(conn, cc);
+
+    return cc;
+}
+
+/* Discard all partially received data, e.g., prior to a reconnect.
+ */
+static void
+nct_req_rx_reset(nct_conn_t *conn)
+{
+    conn->conn_rxhead = conn->conn_rxtail = 0;
+    conn->conn_rxlen = conn->conn_rxfrag = 0;
+    conn->conn_rxlast = false;
+
+    conn->conn_rxsinkst = NCT_RX_SINK_UNKNOWN;
+    conn->conn_rxsink = conn->conn_rxsinkdata = 0;
+    conn->conn_rxskip = 0;
+}
+
+/* Parse as many complete records (of one or more fragments) from the
+ * receive buffer as possible, up to reqmax.  Each record is assembled
+ * into the connection's spare message buffer, which is then exchanged
+ * with the message buffer of the request to which it is the reply
+ * (that buffer holds only the already sent call, so it becomes the
+ * new spare).  Returns the number of requests so completed, which
+ * are returned in reqv[].
+ */
+static int
+nct_req_rx_parse(nct_conn_t *conn, nct_req_t **reqv, int reqmax, struct nct_stats *stats)
+{
+    const size_t rpcmin = BYTES_PER_XDR_UNIT * 6;
+    size_t avail, n;
+    uint32_t mark, xid;
+    nct_msg_t *msg;
+    nct_req_t *req;
+    int nreqs = 0;
+    u_int idx;
+
+    while (nreqs < reqmax) {
+        avail = conn->conn_rxtail - conn->conn_rxhead;
+
+        if (conn->conn_rxfrag == 0) {
+            /* The last fragment of a record may have been finished by
+             * a direct or sink receive (see nct_req_rx_fill()), in which
+             * case the record is complete.
+             */
+            if (!conn->conn_rxlast) {
+                if (avail < sizeof(mark))
+                    break;
+
+                memcpy(&mark, conn->conn_rxbuf + conn->conn_rxhead, sizeof(mark));
+                conn->conn_rxhead += sizeof(mark);
+
+                mark = ntohl(mark);
+                conn->conn_rxlast = (mark & 0x80000000u);
+                conn->conn_rxfrag = mark & ~0x80000000u;
+            }
+        }
+        else if (conn->conn_rxsink > 0) {
+            n = (avail < conn->conn_rxfrag) ? avail : conn->conn_rxfrag;
+            if (n > conn->conn_rxsink)
+                n = conn->conn_rxsink;
+            if (n == 0)
+                break;
+
+            nct_req_rx_sinkcopy(conn, conn->conn_rxbuf + conn->conn_rxhead, n);
+            conn->conn_rxhead += n;
+            conn->conn_rxfrag -= n;
+        }
+        else {
+            n = (avail < conn->conn_rxfrag) ? avail : conn->conn_rxfrag;
+            if (n == 0)
+                break;
+
+            /* Copy the header of a reply a bit at a time until we
+             * know whether or not it has a payload to sink.
+             */
+            if (conn->conn_rxsinkst == NCT_RX_SINK_UNKNOWN && n > 128)
+                n = 128;
+
+            if (conn->conn_rxlen + n > conn->conn_mnt->mnt_msgsz) {
+                eprint("reply on conn %u exceeds message size %zu\n",
+                       conn->conn_idx, conn->conn_mnt->mnt_msgsz);
+                abort();
+            }
+
+            memcpy(conn->conn_rxmsg->msg_data + conn->conn_rxlen,
+                   conn->conn_rxbuf + conn->conn_rxhead, n);
+            conn->conn_rxhead += n;
+            conn->conn_rxlen += n;
+            conn->conn_rxfrag -= n;
+
+            if (conn->conn_rxsinkst == NCT_RX_SINK_UNKNOWN)
+                nct_req_rx_sinkchk(conn);
+        }
+
+        if (conn->conn_rxfrag > 0 || !conn->conn_rxlast)
+            continue;
+
+        msg = conn->conn_rxmsg;
+        msg->msg_len = conn->conn_rxlen;
+        conn->conn_rxlen = 0;
+        conn->conn_rxlast = false;
+
+        if (msg->msg_len < rpcmin) {
+            eprint("invalid %zu byte reply on conn %u\n", msg->msg_len, conn->conn_idx);
+            abort();
+        }
+
+        memcpy(&xid, msg->msg_data, sizeof(xid));
+        xid = ntohl(xid);
+
+        /* Drop a reply that does not match the request in its slot
+         * (e.g., a late reply to a request that has since been resent
+         * with a new xid).  Only the receiver clears a slot, so there
+         * is no need for a CAS here.
+         */
+        idx = xid & conn->conn_req_mask;
+        req = __atomic_load_n(&conn->conn_req_tbl[idx].slot_req, __ATOMIC_ACQUIRE);
+
+        if (!req || req->req_xid != xid) {
+            dprint(1, "dropped stray reply xid %u on conn %u\n", xid, conn->conn_idx);
+            stats->thruput_recv += msg->msg_len + conn->conn_rxskip;
+            stats->strays++;
+
+            conn->conn_rxsinkst = NCT_RX_SINK_UNKNOWN;
+            conn->conn_rxsink = conn->conn_rxsinkdata = 0;
+            conn->conn_rxskip = 0;
+            continue;
+        }
+
+        __atomic_store_n(&conn->conn_req_tbl[idx].slot_req, NULL, __ATOMIC_RELEASE);
+
+        req->req_txbytes = req->req_msg->msg_len + req->req_paylen;
+        req->req_rxbytes = msg->msg_len + conn->conn_rxskip;
+
+        conn->conn_rxsinkst = NCT_RX_SINK_UNKNOWN;
+        conn->conn_rxsink = conn->conn_rxsinkdata = 0;
+        conn->conn_rxskip = 0;
+
+        /* Exchange the message buffer.
+         */
+        conn->conn_rxmsg = req->req_msg;
+        req->req_msg = msg;
+
+        reqv[nreqs++] = req;
+    }
+
+    return nreqs;
+}
+
+/* Complete a batch of requests returned by nct_req_rx_parse(), having
+ * first accounted for them (along with the given stats) in the calling
+ * thread's stats shard.  The shard is left before the requests are
+ * completed so that the stats thread never has to wait on a callback.
+ */
+static void
+nct_req_rx_done(nct_conn_t *conn, nct_req_t **reqv, int nreqs,
+                struct nct_stats *stats)
+{
+    struct nct_stats *cs, *ps;
+    nct_shard_t *shard;
+    uint64_t tsc_stop;
+    uint64_t tsc_diff;
+    nct_hist_t *hist;
+    nct_req_t *req;
+    u_int epoch;
+    int i;
+
+    shard = nct_req_shard_get(conn->conn_mnt);
+    cs = shard->shard_connv + conn->conn_idx;
+    tsc_stop = rdtsc();
+
+    nct_shard_enter(shard);
+
+    epoch = __atomic_load_n(&conn->conn_mnt->mnt_stats_epoch, __ATOMIC_RELAXED);
+    if (shard->shard_epoch != epoch) {
+        shard->shard_epoch = epoch;
+        shard->shard_latency_min = UINT64_MAX;
+        shard->shard_latency_max = 0;
+    }
+
+    for (i = 0; i < nreqs; ++i) {
+        req = reqv[i];
+
+        hist = shard->shard_histv[req->req_proc];
+        if (!hist)
+            hist = nct_req_shard_hist(shard, req->req_proc);
+
+        tsc_diff = tsc_stop - req->req_tsc_start;
+        if (tsc_diff < shard->shard_latency_min)
+            shard->shard_latency_min = tsc_diff;
+        if (tsc_diff > shard->shard_latency_max)
+            shard->shard_latency_max = tsc_diff;
+        nct_hist_record(hist, tsc_diff);
+
+        cs->latency_cum += tsc_diff;
+        cs->thruput_send += req->req_txbytes;
+        cs->thruput_recv += req->req_rxbytes;
+
+        ps = shard->shard_procv + req->req_proc;
+        ps->latency_cum += tsc_diff;
+        ps->thruput_send += req->req_txbytes;
+        ps->thruput_recv += req->req_rxbytes;
+        ps->requests++;
+    }
+
+    cs->requests += nreqs;
+    nct_req_stats_fold(shard, conn, stats);
+
+    nct_shard_leave(shard);
+
+    for (i = 0; i < nreqs; ++i)
+        nct_req_recv_done(conn, reqv[i], tsc_stop);
+}
+
+/* Initialize the receive state of the given connection, which is given
+ * its own receive buffer and spare message buffer.
+ */
+static void
+nct_req_rx_init(nct_conn_t *conn, void *rxbuf, nct_msg_t *rxmsg)
+{
+    conn->conn_rxbuf = rxbuf;
+    conn->conn_rxmsg = rxmsg;
+    conn->conn_rxsinkfd = -1;
+    nct_req_rx_reset(conn);
+}
+
+/* Each connection has mnt_tds_max of these threads which take turns
+ * receiving on the connection.  The thread that holds conn_recv_mtx
+ * receives and parses as many replies as are available, and then
+ * completes them after having released the lock.
+ */
+void *
+nct_req_recv_loop(void *arg)
+{
+    nct_req_t *reqv[NCT_RX_BATCH];
+    struct nct_stats stats;
+    nct_conn_t *conn = arg;
+    nct_req_t *resend;
+    ssize_t cc = 0;
+    int n;
+
+    bzero(&stats, sizeof(stats));
+
+    while (1) {
+        pthread_mutex_lock(&conn->conn_recv_mtx);
+        while ((n = nct_req_rx_parse(conn, reqv, NELEM(reqv), &stats)) == 0) {
+            cc = nct_req_rx_recv(conn, 0);
+            if (cc < 1)
+                break;
+
+            ++stats.recvs;
+        }
+
+        if (n == 0) {
+            nct_req_rx_reset(conn);
+
+            if (cc == 0 && !__atomic_load_n(&conn->conn_broken, __ATOMIC_SEQ_CST)) {
+                pthread_mutex_unlock(&conn->conn_recv_mtx);
+                break;
+            }
+
+            if (cc == -1)
+                eprint("recv() failed: %s\n", strerror(errno));
+
+            /* Reconnect before releasing the lock so that the other
+             * recv threads of the connection see only the new socket.
+             */
+            resend = nct_req_reconnect(conn, &stats);
+            pthread_mutex_unlock(&conn->conn_recv_mtx);
+
+            nct_req_resend(resend);
+            continue;
+        }
+        pthread_mutex_unlock(&conn->conn_recv_mtx);
+
+        nct_req_rx_done(conn, reqv, n, &stats);
+    }
+
+    nct_req_stats_flush(conn, &stats);
+
+    pthread_exit(NULL);
+}
+
+#if __linux__
+/* Receive and process as many replies as are available on the
+ * given connection without blocking.  Called only by the epoll
+ * thread that currently owns the connection (i.e., the thread
+ * that retrieved the EPOLLONESHOT event), so the receive state
+ * needs no lock.  Returns false if the connection reached EOF.
+ */
+static bool
+nct_req_epoll_recv(nct_conn_t *conn)
+{
+    nct_req_t *reqv[NCT_RX_BATCH];
+    ssize_t cc;
+    int n;
+
+    while (1) {
+        n = nct_req_rx_parse(conn, reqv, NELEM(reqv), &conn->conn_rxstats);
+        if (n > 0) {
+            nct_req_rx_done(conn, reqv, n, &conn->conn_rxstats);
+            continue;
+        }
+
+        cc = nct_req_rx_recv(conn, MSG_DONTWAIT);
+        if (cc < 1)
+            break;
+
+        ++conn->conn_rxstats.recvs;
+    }
+
+    if (cc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+
+    nct_req_stats_flush(conn, &conn->conn_rxstats);
+
+    if (cc == 0 && !__atomic_load_n(&conn->conn_broken, __ATOMIC_SEQ_CST))
+        return false;
+
+    if (cc == -1)
+        eprint("recv() failed: %s\n", strerror(errno));
+
+    nct_req_rx_reset(conn);
+
+    /* The new socket will be added to the epoll set when the
+     * caller tries to rearm it.
+     */
+    nct_req_resend(nct_req_reconnect(conn, &conn->conn_rxstats));
+
+    return true;
+}
+
+/* The epoll engine runs mnt_tds_max of these threads to service
+ * all the connections of a mount.  Each connection is registered
+ * with EPOLLONESHOT so that at most one thread at a time receives
+ * on any given connection.
+ */
+void *
+nct_req_epoll_loop(void *arg)
+{
+    struct epoll_event eventv[16], event;
+    nct_mnt_t *mnt = arg;
+    nct_conn_t *conn;
+    int n, i, rc;
+
+    while (1) {
+        n = epoll_wait(mnt->mnt_epfd, eventv, NELEM(eventv), -1);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+
+            eprint("epoll_wait() failed: %s\n", strerror(errno));
+            abort();
+        }
+
+        for (i = 0; i < n; ++i) {
+            conn = eventv[i].data.ptr;
+
+            if (!conn)
+                goto done;  // Eventfd signaled, all connections closed
+
+            /* Zerocopy completions make the socket report an error,
+             * which would keep waking us up until reaped.
+             */
+            if (eventv[i].events & EPOLLERR)
+                nct_req_zc_reap(conn);
+
+            if (!nct_req_epoll_recv(conn)) {
+                if (__atomic_sub_fetch(&mnt->mnt_conns_live, 1, __ATOMIC_SEQ_CST) == 0) {
+                    uint64_t one = 1;
+
+                    if (write(mnt->mnt_efd, &one, sizeof(one)) != sizeof(one))
+                        abort();
+                }
+                continue;
+            }
+
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.ptr = conn;
+
+            rc = epoll_ctl(mnt->mnt_epfd, EPOLL_CTL_MOD, conn->conn_fd, &event);
+            if (rc && errno == ENOENT)
+                rc = epoll_ctl(mnt->mnt_epfd, EPOLL_CTL_ADD, conn->conn_fd, &event);
+            if (rc) {
+                eprint("epoll_ctl() failed: %s\n", strerror(errno));
+                abort();
+            }
+        }
+    }
+
+  done:
+    pthread_exit(NULL);
+}
+
+/* Initialize the given connection for use by the epoll engine.
+ */
+void
+nct_req_epoll_add(nct_conn_t *conn)
+{
+    nct_mnt_t *mnt = conn->conn_mnt;
+    struct epoll_event event;
+    int rc;
+
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = conn;
+
+    rc = epoll_ctl(mnt->mnt_epfd, EPOLL_CTL_ADD, conn->conn_fd, &event);
+    if (rc) {
+        eprint("epoll_ctl() failed: %s\n", strerror(errno));
+        abort();
+    }
+}
+#if HAVE_IO_URING
+/* The io_uring engine runs mnt_tds_max of these threads, each of
+ * which owns its own ring and every mnt_tds_max'th connection.  All
+ * receives and sends for a connection are issued by its owner, so
+ * the completions from all its connections are reaped and the work
+ * they generate (the next receive, and the sends issued by request
+ * callbacks) is submitted in a single io_uring_enter() call.
+ */
+typedef struct {
+    __aligned(64)
+    nct_uring_t         td_ring;
+    nct_mnt_t          *td_mnt;
+    u_int               td_idx;
+    u_int               td_stride;              // Number of engine threads
+    u_int               td_conns_live;          // Owned conns not yet at EOF
+    bool                td_fixed;               // mnt_msgbase is registered
+    bool                td_wakeup;              // td_efd has been signaled
+    int                 td_efd;                 // Wakes td for sends by other threads
+    uint64_t            td_efdval;
+} nct_uring_td_t;
+
+/* SQE user_data tags (conns and tds are 64-byte aligned).
+ */
+#define NCT_URING_RECV      (1u)
+#define NCT_URING_SEND      (2u)
+#define NCT_URING_WAKE      (3u)
+#define NCT_URING_TAGMASK   (63u)
+
+static __thread nct_uring_td_t *nct_uring_self;
+
+static struct io_uring_sqe *
+nct_req_uring_sqe(nct_uring_td_t *td)
+{
+    struct io_uring_sqe *sqe;
+
+    /* The ring is sized such that it can hold all the operations
+     * that can be outstanding at any one time.
+     */
+    sqe = nct_uring_sqe(&td->td_ring);
+    if (!sqe)
+        abort();
+
+    return sqe;
+}
+
+/* Start a receive on the given connection.  Both the receive buffers
+ * (mnt_rxbase) and the initial message buffers (mnt_msgbase) into which
+ * large fragments are received directly are registered whenever
+ * possible, but buffers added as the request pool grows are not.
+ */
+static void
+nct_req_uring_recv(nct_uring_td_t *td, nct_conn_t *conn)
+{
+    nct_mnt_t *mnt = td->td_mnt;
+    struct io_uring_sqe *sqe;
+    bool fixed;
+    size_t len;
+    void *buf;
+
+    buf = nct_req_rx_target(conn, &len);
+
+    fixed = td->td_fixed;
+    if (conn->conn_rxmode == NCT_RX_DIRECT &&
+        (buf < mnt->mnt_msgbase || buf >= mnt->mnt_msgbase + mnt->mnt_msgbasesz))
+        fixed = false;
+
+    sqe = nct_req_uring_sqe(td);
+    sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_RECV;
+    sqe->fd = conn->conn_fd;
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = len;
+    sqe->buf_index = (conn->conn_rxmode == NCT_RX_DIRECT) ? 0 : 1;
+    sqe->user_data = (uintptr_t)conn | NCT_URING_RECV;
+
+    if (conn->conn_rxsplice) {
+        sqe->opcode = IORING_OP_SPLICE;
+        sqe->fd = conn->conn_sinkpipe[1];
+        sqe->addr = 0;
+        sqe->buf_index = 0;
+        sqe->off = -1;
+        sqe->splice_fd_in = conn->conn_fd;
+        sqe->splice_off_in = -1;
+        sqe->splice_flags = SPLICE_F_MOVE;
+    }
+    else if (conn->conn_rxmode == NCT_RX_SINK) {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->buf_index = 0;
+        sqe->msg_flags = MSG_TRUNC;
+    }
+}
+
+/* Start (or continue) sending the records described by conn_txhdr.
+ */
+static void
+nct_req_uring_sendmsg(nct_uring_td_t *td, nct_conn_t *conn)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = nct_req_uring_sqe(td);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->conn_fd;
+    sqe->addr = (uintptr_t)&conn->conn_txhdr;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_WAITALL | conn->conn_txflags;
+    sqe->user_data = (uintptr_t)conn | NCT_URING_SEND;
+
+    conn->conn_txbusy = true;
+}
+
+/* Coalesce the requests queued on the given connection into a single
+ * sendmsg.  Each request is referenced in place, which is safe as a
+ * request cannot be reused until its reply has been received, which
+ * in turn cannot happen until the request has been sent.
+ */
+static void
+nct_req_uring_send(nct_uring_td_t *td, nct_conn_t *conn)
+{
+    size_t paylen = 0;
+    nct_req_t *req;
+    int n = 0;
+
+    pthread_mutex_lock(&conn->conn_send_mtx);
+    while ((req = conn->conn_txhead) && n < NELEM(conn->conn_txiov) - 1) {
+        conn->conn_txhead = req->req_next;
+        n += nct_req_txiov(req, conn->conn_txiov + n);
+        paylen += req->req_paylen;
+    }
+    pthread_mutex_unlock(&conn->conn_send_mtx);
+
+    if (n > 0) {
+        conn->conn_txhdr.msg_iov = conn->conn_txiov;
+        conn->conn_txhdr.msg_iovlen = n;
+        conn->conn_txflags = nct_req_txflags(conn, paylen);
+        conn->conn_txgen = conn->conn_gen;
+
+        nct_req_uring_sendmsg(td, conn);
+    }
+}
+
+static void
+nct_req_uring_sent(nct_uring_td_t *td, nct_conn_t *conn, int res)
+{
+    struct msghdr *hdr = &conn->conn_txhdr;
+
+    conn->conn_txbusy = false;
+
+    /* The rest of a send to a socket since replaced is dropped, as
+     * its requests have been resent.
+     */
+    if (conn->conn_txgen != conn->conn_gen)
+        return;
+
+    if (res < 0) {
+        if (res == -EINTR || res == -EAGAIN) {
+            nct_req_uring_sendmsg(td, conn);
+            return;
+        }
+
+        if (res == -ENOBUFS && conn->conn_txflags != MSG_NOSIGNAL) {
+            nct_req_zc_reap(conn);
+            nct_req_uring_sendmsg(td, conn);
+            return;
+        }
+
+        if (conn->conn_eof)
+            return;
+
+        pthread_mutex_lock(&conn->conn_send_mtx);
+        nct_req_send_failed(conn, -res);
+        pthread_mutex_unlock(&conn->conn_send_mtx);
+        return;
+    }
+
+    nct_req_iov_advance(hdr, res);
+
+    if (hdr->msg_iovlen > 0)
+        nct_req_uring_sendmsg(td, conn);
+    else if (conn->conn_txflags != MSG_NOSIGNAL)
+        nct_req_zc_reap(conn);
+}
+
+static void
+nct_req_uring_recvd(nct_uring_td_t *td, nct_conn_t *conn, int res)
+{
+    nct_req_t *reqv[NCT_RX_BATCH];
+    int n;
+
+    if (res == 0 && !__atomic_load_n(&conn->conn_broken, __ATOMIC_SEQ_CST)) {
+        nct_req_stats_flush(conn, &conn->conn_rxstats);
+        conn->conn_eof = true;
+        --td->td_conns_live;
+        return;
+    }
+
+    if (res <= 0) {
+        if (res != -EINTR && res != -EAGAIN) {
+            if (res < 0)
+                eprint("recv() failed: %s\n", strerror(-res));
+
+            /* Requests resent to a connection owned by this thread
+             * are queued, and sent once the completions are reaped.
+             */
+            nct_req_rx_reset(conn);
+            nct_req_resend(nct_req_reconnect(conn, &conn->conn_rxstats));
+        }
+    }
+    else {
+        nct_req_rx_fill(conn, res);
+        ++conn->conn_rxstats.recvs;
+
+        while ((n = nct_req_rx_parse(conn, reqv, NELEM(reqv), &conn->conn_rxstats)) > 0)
+            nct_req_rx_done(conn, reqv, n, &conn->conn_rxstats);
+    }
+
+    nct_req_uring_recv(td, conn);
+}
+
+static void
+nct_req_uring_wake(nct_uring_td_t *td)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = nct_req_uring_sqe(td);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = td->td_efd;
+    sqe->addr = (uintptr_t)&td->td_efdval;
+    sqe->len = sizeof(td->td_efdval);
+    sqe->user_data = (uintptr_t)td | NCT_URING_WAKE;
+}
+
+static void *
+nct_req_uring_loop(void *arg)
+{
+    nct_uring_td_t *td = arg;
+    nct_mnt_t *mnt = td->td_mnt;
+    struct io_uring_cqe *cqe;
+    nct_conn_t *conn;
+    uintptr_t udata;
+    int rc, res, i;
+
+    nct_uring_self = td;
+
+    rc = nct_uring_enable(&td->td_ring);
+    if (rc) {
+        eprint("nct_uring_enable() failed: %s\n", strerror(rc));
+        abort();
+    }
+
+    nct_req_uring_wake(td);
+
+    for (i = td->td_idx; i < mnt->mnt_conns_max; i += td->td_stride)
+        nct_req_uring_recv(td, mnt->mnt_connv + i);
+
+    while (td->td_conns_live > 0) {
+        rc = nct_uring_submit(&td->td_ring, 1);
+        if (rc < 0) {
+            if (rc == -EINTR || rc == -EAGAIN || rc == -EBUSY)
+                continue;
+
+            eprint("io_uring_enter() failed: %s\n", strerror(-rc));
+            abort();
+        }
+
+        /* Reap all available completions before submitting the
+         * work they generate.
+         */
+        while ((cqe = nct_uring_cqe(&td->td_ring))) {
+            udata = cqe->user_data;
+            res = cqe->res;
+            nct_uring_cqe_seen(&td->td_ring);
+
+            conn = (void *)(udata & ~(uintptr_t)NCT_URING_TAGMASK);
+
+            switch (udata & NCT_URING_TAGMASK) {
+            case NCT_URING_RECV:
+                nct_req_uring_recvd(td, conn, res);
+                break;
+
+            case NCT_URING_SEND:
+                nct_req_uring_sent(td, conn, res);
+                break;
+
+            case NCT_URING_WAKE:
+                __atomic_store_n(&td->td_wakeup, false, __ATOMIC_SEQ_CST);
+                nct_req_uring_wake(td);
+                break;
+            }
+        }
+
+        /* Send the requests queued by the callbacks run above and
+         * by other threads.
+         */
+        for (i = td->td_idx; i < mnt->mnt_conns_max; i += td->td_stride) {
+            conn = mnt->mnt_connv + i;
+
+            if (!conn->conn_txbusy && __atomic_load_n(&conn->conn_txhead, __ATOMIC_RELAXED))
+                nct_req_uring_send(td, conn);
+        }
+    }
+
+    pthread_exit(NULL);
+}
+
+/* Queue a request on a connection serviced by the io_uring engine.
+ * Called with conn_send_mtx held, which it releases.
+ */
+static void
+nct_req_uring_queue(nct_conn_t *conn, nct_req_t *req)
+{
+    nct_uring_td_t *td = conn->conn_uring;
+
+    req->req_next = NULL;
+    if (conn->conn_txhead)
+        conn->conn_txtail->req_next = req;
+    else
+        conn->conn_txhead = req;
+    conn->conn_txtail = req;
+    pthread_mutex_unlock(&conn->conn_send_mtx);
+
+    /* The owner sends whatever has been queued before it next waits
+     * for completions, so only other threads need to wake it.
+     */
+    if (td != nct_uring_self && !__atomic_exchange_n(&td->td_wakeup, true, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+
+        if (write(td->td_efd, &one, sizeof(one)) != sizeof(one))
+            abort();
+    }
+}
+
+/* Create a ring for each of the io_uring engine threads, distribute
+ * the connections among them, and start them.  Returns zero on
+ * success, otherwise an errno.
+ */
+int
+nct_req_uring_start(nct_mnt_t *mnt)
+{
+    nct_uring_td_t *tdv, *td;
+    struct iovec iov[2];
+    u_int tds, i;
+    int rc;
+
+    tds = mnt->mnt_tds_max;
+    if (tds > mnt->mnt_conns_max)
+        tds = mnt->mnt_conns_max;
+    if (tds < 1)
+        tds = 1;
+
+    tdv = aligned_alloc(__alignof(*tdv), sizeof(*tdv) * tds);
+    if (!tdv)
+        return ENOMEM;
+
+    memset(tdv, 0, sizeof(*tdv) * tds);
+    for (i = 0; i < tds; ++i)
+        tdv[i].td_efd = -1;
+
+    mnt->mnt_uringv = tdv;
+    mnt->mnt_tds_max = tds;
+
+    /* Fixed buffer indices as used by nct_req_uring_recv().
+     */
+    iov[0].iov_base = mnt->mnt_msgbase;
+    iov[0].iov_len = mnt->mnt_msgbasesz;
+    iov[1].iov_base = mnt->mnt_rxbase;
+    iov[1].iov_len = mnt->mnt_rxbasesz;
+
+    for (i = 0; i < tds; ++i) {
+        td = tdv + i;
+
+        td->td_mnt = mnt;
+        td->td_idx = i;
+        td->td_stride = tds;
+        td->td_conns_live = (mnt->mnt_conns_max - i + tds - 1) / tds;
+
+        /* Each connection has at most one receive and one send
+         * outstanding, plus there's the eventfd read.
+         */
+        rc = nct_uring_init(&td->td_ring, td->td_conns_live * 2 + 1);
+        if (rc) {
+            nct_req_uring_destroy(mnt);
+            return rc;
+        }
+
+        td->td_efd = eventfd(0, EFD_CLOEXEC);
+        if (td->td_efd == -1) {
+            rc = errno;
+            nct_req_uring_destroy(mnt);
+            return rc;
+        }
+
+        rc = nct_uring_register(&td->td_ring, iov, NELEM(iov));
+        if (rc)
+            dprint(1, "unable to register message buffers: %s\n", strerror(rc));
+        td->td_fixed = !rc;
+    }
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i)
+        mnt->mnt_connv[i].conn_uring = tdv + (i % tds);
+
+    for (i = 0; i < tds; ++i) {
+        rc = pthread_create(&mnt->mnt_tdv[i], NULL, nct_req_uring_loop, tdv + i);
+        if (rc) {
+            eprint("pthread_create() failed: %s\n", strerror(rc));
+            abort();
+        }
+    }
+
+    return 0;
+}
+
+/* Release the rings of the io_uring engine threads once they have
+ * been joined.
+ */
+void
+nct_req_uring_destroy(nct_mnt_t *mnt)
+{
+    nct_uring_td_t *tdv = mnt->mnt_uringv;
+    int i;
+
+    if (!tdv)
+        return;
+
+    for (i = 0; i < mnt->mnt_tds_max; ++i) {
+        if (tdv[i].td_ring.ring_sqmap)
+            nct_uring_fini(&tdv[i].td_ring);
+        if (tdv[i].td_efd != -1)
+            close(tdv[i].td_efd);
+    }
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i)
+        mnt->mnt_connv[i].conn_uring = NULL;
+
+    mnt->mnt_uringv = NULL;
+    free(tdv);
+}
+#endif /* HAVE_IO_URING */
+#endif /* __linux__ */
+
+/* Push the given request onto its connection's send queue, and wake
+ * the sender thread if it might be waiting for work.
+ */
+static void
+nct_req_sendq_push(nct_conn_t *conn, nct_req_t *req)
+{
+    nct_req_t *head;
+
+    head = __atomic_load_n(&conn->conn_sq_head, __ATOMIC_RELAXED);
+    do {
+        req->req_next = head;
+    } while (!__atomic_compare_exchange_n(&conn->conn_sq_head, &head, req, true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    if (__atomic_load_n(&conn->conn_sq_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&conn->conn_sq_mtx);
+        pthread_cond_signal(&conn->conn_sq_cv);
+        pthread_mutex_unlock(&conn->conn_sq_mtx);
+    }
+}
+
+/* Take all the requests off the given connection's send queue, waiting
+ * for at least one if the queue is empty.  Returns the requests in the
+ * order in which they were queued, or NULL if the sender should exit.
+ */
+static nct_req_t *
+nct_req_sendq_take(nct_conn_t *conn)
+{
+    nct_req_t *head, *next, *prev;
+
+    head = __atomic_exchange_n(&conn->conn_sq_head, NULL, __ATOMIC_ACQUIRE);
+
+    if (!head) {
+        pthread_mutex_lock(&conn->conn_sq_mtx);
+        while (!conn->conn_sq_stop) {
+            __atomic_store_n(&conn->conn_sq_sleeping, true, __ATOMIC_SEQ_CST);
+
+            head = __atomic_exchange_n(&conn->conn_sq_head, NULL, __ATOMIC_SEQ_CST);
+            if (head)
+                break;
+
+            pthread_cond_wait(&conn->conn_sq_cv, &conn->conn_sq_mtx);
+        }
+        __atomic_store_n(&conn->conn_sq_sleeping, false, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&conn->conn_sq_mtx);
+    }
+
+    for (prev = NULL; head; head = next) {
+        next = head->req_next;
+        head->req_next = prev;
+        prev = head;
+    }
+
+    return prev;
+}
+
+/* Assign the next xid of the given connection to the given request
+ * and enter it into the connection's request table.  An xid whose slot
+ * is still occupied (by a request that has been in flight for more
+ * than a table's worth of xids) is skipped rather than clobbering the slot.
+ */
+static void
+nct_req_xid(nct_conn_t *conn, nct_req_t *req)
+{
+    struct rpc_msg *msg;
+    nct_req_t *busy;
+    uint32_t xid;
+
+    msg = (void *)req->req_msg->msg_data + 4;
+
+    while (1) {
+        xid = __atomic_fetch_add(&conn->conn_send_xid, 1, __ATOMIC_RELAXED);
+
+        req->req_xid = xid;
+        busy = NULL;
+
+        if (__atomic_compare_exchange_n(&conn->conn_req_tbl[xid & conn->conn_req_mask].slot_req,
+                                        &busy, req, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            break;
+
+        __atomic_add_fetch(&conn->conn_send_collisions, 1, __ATOMIC_RELAXED);
+    }
+
+    msg->rm_xid = htonl(xid);
+}
+
+/* Each connection has one of these threads when the mount is created
+ * with NCT_MNT_SENDQ.  nct_req_send() merely pushes the request onto
+ * the connection's send queue, and the sender thread sends everything
+ * it finds there with as few sendmsg() calls as possible.  This keeps
+ * the completion callbacks that send the next request (i.e., the recv
+ * threads) from ever blocking on a full socket buffer.
+ */
+void *
+nct_req_send_loop(void *arg)
+{
+    nct_conn_t *conn = arg;
+    struct msghdr *hdr = &conn->conn_txhdr;
+    nct_req_t *head = NULL;
+    nct_req_t *req;
+    size_t paylen;
+    int n;
+
+    while (1) {
+        if (!head) {
+            head = nct_req_sendq_take(conn);
+            if (!head)
+                break;
+        }
+
+        for (n = 0, paylen = 0; head && n < NELEM(conn->conn_txiov) - 1; ) {
+            req = head;
+            head = req->req_next;
+
+            nct_req_xid(conn, req);
+
+            n += nct_req_txiov(req, conn->conn_txiov + n);
+            paylen += req->req_paylen;
+        }
+
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_iov = conn->conn_txiov;
+        hdr->msg_iovlen = n;
+
+        /* The requests of a failed send are in the request table, and
+         * so are resent once the receive side has reconnected.  The
+         * send lock keeps the socket from being replaced mid-send.
+         */
+        pthread_mutex_lock(&conn->conn_send_mtx);
+        if (nct_req_sendmsg(conn, hdr, nct_req_txflags(conn, paylen))) {
+            if (__atomic_load_n(&conn->conn_sq_stop, __ATOMIC_RELAXED)) {
+                pthread_mutex_unlock(&conn->conn_send_mtx);
+                return NULL;
+            }
+
+            nct_req_send_failed(conn, errno);
+        }
+        pthread_mutex_unlock(&conn->conn_send_mtx);
+    }
+
+    return NULL;
+}
+
+/* Send a request.  Should the send fail the request is resent once
+ * the receive side of the connection has reconnected.
+ */
+void
+nct_req_send(nct_req_t *req)
+{
+    nct_conn_t *conn = req->req_conn;
+    struct iovec iov[2];
+    struct msghdr hdr;
+    size_t len;
+    ssize_t cc;
+
+    req->req_done = false;
+
+    if (conn->conn_mnt->mnt_flags & NCT_MNT_SENDQ) {
+        nct_req_sendq_push(conn, req);
+        return;
+    }
+
+    nct_req_xid(conn, req);
+
+    pthread_mutex_lock(&conn->conn_send_mtx);
+
+    /* A request taken out of the table by a reconnect since it was
+     * assigned its xid is resent by the reconnect.
+     */
+    if (__atomic_load_n(&conn->conn_req_tbl[req->req_xid & conn->conn_req_mask].slot_req,
+                        __ATOMIC_RELAXED) != req) {
+        pthread_mutex_unlock(&conn->conn_send_mtx);
+        return;
+    }
+
+#if HAVE_IO_URING
+    if (conn->conn_uring) {
+        nct_req_uring_queue(conn, req);
+        return;
+    }
+#endif
+
+    /* Calls with a payload are gathered from the message buffer and
+     * the payload.
+     */
+    if (req->req_paylen > 0) {
+        len = req->req_paylen;
+
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = iov;
+        hdr.msg_iovlen = nct_req_txiov(req, iov);
+
+        if (nct_req_sendmsg(conn, &hdr, nct_req_txflags(conn, len)))
+            nct_req_send_failed(conn, errno);
+        pthread_mutex_unlock(&conn->conn_send_mtx);
+        return;
+    }
+
+    /* The reply may arrive and be exchanged into req_msg before we
+     * return from nct_rpc_send(), so capture the length up front.
+     */
+    len = req->req_msg->msg_len;
+
+    cc = nct_rpc_send(conn->conn_fd, req->req_msg->msg_data, len);
+    if (cc != len)
+        nct_req_send_failed(conn, (cc == -1) ? errno : EPIPE);
+    pthread_mutex_unlock(&conn->conn_send_mtx);
+}
+
+/* Start the given (encoded) request of a job, either right away or,
+ * in open-loop mode, at the next arrival time of the mount's pacer.
+ * Given a window controller the request instead waits for room in
+ * the window if the window is full.
+ */
+void
+nct_req_issue(nct_req_t *req)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+
+    if (mnt->mnt_pace) {
+        nct_pace_park(mnt->mnt_pace, req);
+        return;
+    }
+
+    if (mnt->mnt_win && nct_win_park(mnt->mnt_win, req))
+        return;
+
+    req->req_tsc_start = rdtsc();
+    nct_req_send(req);
+}
+
+/* Wait for the reply to the specified request to arrive.
+ */
+void
+nct_req_wait(nct_req_t *req)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+
+    pthread_mutex_lock(&mnt->mnt_wait_mtx);
+    while (!req->req_done) {
+        ++mnt->mnt_wait_waiters;
+        pthread_cond_wait(&mnt->mnt_wait_cv, &mnt->mnt_wait_mtx);
+        --mnt->mnt_wait_waiters;
+    }
+    pthread_mutex_unlock(&mnt->mnt_wait_mtx);
+}
+
+/* Map sz bytes of zeroed memory, backed by superpages if possible.
+ */
+static void *
+nct_req_mmap(size_t sz)
+{
+    int flags, prot;
+    int super = 0;
+    void *base;
+
+#if __FreeBSD__
+    super = MAP_ALIGNED_SUPER;
+#elif __linux__
+    super = MAP_HUGETLB;
+#endif
+
+    flags = MAP_ANONYMOUS | MAP_PRIVATE;
+    prot = PROT_READ | PROT_WRITE;
+
+  again:
+    base = mmap(NULL, sz, prot, flags | super, -1, 0);
+    if (base == MAP_FAILED) {
+        if (super) {
+            super = 0;
+            goto again;
+        }
+
+        dprint(0, "mmap(%zu, %x, %x) failed: %s\n",
+               sz, prot, flags, strerror(errno));
+        abort();
+    }
+
+    return base;
+}
+
+/* Map sz bytes and return a region record for them that the caller
+ * must link onto mnt_region_head.
+ */
+static nct_region_t *
+nct_req_region_map(size_t sz)
+{
+    nct_region_t *rgn;
+
+    rgn = malloc(sizeof(*rgn));
+    if (!rgn)
+        abort();
+
+    rgn->rgn_base = nct_req_mmap(sz);
+    rgn->rgn_sz = sz;
+
+    return rgn;
+}
+
+/* Map sz bytes for the given mount and record the region on the mount
+ * so that nct_req_destroy() can unmap it.
+ */
+static void *
+nct_req_region(nct_mnt_t *mnt, size_t sz)
+{
+    nct_region_t *rgn;
+
+    rgn = nct_req_region_map(sz);
+    rgn->rgn_next = mnt->mnt_region_head;
+    mnt->mnt_region_head = rgn;
+
+    return rgn->rgn_base;
+}
+
+/* Return the size of the region that holds a pattern of len bytes.
+ */
+static size_t
+nct_req_pattern_sz(size_t len)
+{
+    return (nct_xdr_pad(len) + (2u << 20) - 1) & ~((2u << 20) - 1);
+}
+
+/* Return a read-only region holding a pattern of len bytes followed by
+ * zeroes up to the next XDR unit, from which the payloads of all write
+ * calls are sent in place (see req_payload).
+ */
+const char *
+nct_req_pattern(size_t len)
+{
+    size_t sz, i;
+    char *base;
+
+    sz = nct_req_pattern_sz(len);
+
+    base = nct_req_mmap(sz);
+
+#if __linux__
+    madvise(base, sz, MADV_HUGEPAGE);
+#endif
+
+    for (i = 0; i < len; ++i)
+        base[i] = i;
+
+    if (mprotect(base, sz, PROT_READ)) {
+        eprint("mprotect(%p, %zu) failed: %s\n", base, sz, strerror(errno));
+        abort();
+    }
+
+    return base;
+}
+
+/* Unmap a region returned by nct_req_pattern(len).
+ */
+void
+nct_req_pattern_free(const char *pattern, size_t len)
+{
+    if (!pattern)
+        return;
+
+    if (munmap((void *)pattern, nct_req_pattern_sz(len))) {
+        eprint("munmap(%p) failed: %s\n", pattern, strerror(errno));
+        abort();
+    }
+}
+
+/* Add n requests to the free pool, along with a message buffer for
+ * each and the given number of spare message buffers, which are
+ * returned.  The first such chunk becomes mnt_msgbase (which the
+ * io_uring engine registers).  Caller must hold mnt_req_mtx, which is
+ * dropped while the chunk is mapped and initialized, and retaken only
+ * to link it into the region list and the free pool.
+ */
+static void *
+nct_req_grow(nct_mnt_t *mnt, u_int n, u_int spares)
+{
+    nct_req_t *req, *head, *tail;
+    nct_region_t *rgn;
+    size_t msgsz, sz;
+    void *msgbase;
+    u_int i;
+
+    mnt->mnt_req_growing = true;
+    pthread_mutex_unlock(&mnt->mnt_req_mtx);
+
+    msgsz = sizeof(nct_msg_t) + mnt->mnt_msgsz;
+
+    sz = (n + spares) * msgsz + n * sizeof(*req);
+    sz = (sz + (2u << 20) - 1) & ~((2u << 20) - 1);
+
+    rgn = nct_req_region_map(sz);
+    msgbase = rgn->rgn_base;
+
+    req = msgbase + (n + spares) * msgsz;
+    head = NULL;
+    tail = req;
+
+    for (i = 0; i < n; ++i, ++req) {
+        req->req_mnt = mnt;
+        req->req_msg = msgbase + i * msgsz;
+
+        req->req_next = head;
+        head = req;
+    }
+
+    pthread_mutex_lock(&mnt->mnt_req_mtx);
+    rgn->rgn_next = mnt->mnt_region_head;
+    mnt->mnt_region_head = rgn;
+
+    if (!mnt->mnt_msgbase) {
+        mnt->mnt_msgbase = msgbase;
+        mnt->mnt_msgbasesz = (n + spares) * msgsz;
+    }
+
+    if (n > 0) {
+        tail->req_next = mnt->mnt_req_head;
+        mnt->mnt_req_head = head;
+    }
+
+    mnt->mnt_reqs_cnt += n;
+    mnt->mnt_req_growing = false;
+
+    if (mnt->mnt_req_waiters > 0)
+        pthread_cond_broadcast(&mnt->mnt_req_cv);
+
+    dprint(1, "request pool grew by %u to %u (max %u)\n",
+           n, mnt->mnt_reqs_cnt, mnt->mnt_reqs_max);
+
+    return msgbase + n * msgsz;
+}
+
+/* Each thread keeps a small cache (magazine) of free requests so that
+ * the free pool and its lock are visited only once per NCT_REQ_MAG
+ * allocations or frees.  A thread's cache belongs to at most one mount
+ * at a time.  Frees go straight back to the pool while anyone waits
+ * on it, so cached requests cannot starve a waiter for long.
+ */
+#define NCT_REQ_MAG         (16)
+
+static __thread struct {
+    nct_mnt_t  *mag_mnt;
+    nct_req_t  *mag_head;
+    u_int       mag_cnt;
+} nct_req_mag;
+
+/* Return up to n requests from the calling thread's cache to the pool.
+ */
+static void
+nct_req_mag_spill(nct_mnt_t *mnt, u_int n)
+{
+    nct_req_t *req;
+
+    pthread_mutex_lock(&mnt->mnt_req_mtx);
+    while (n-- > 0 && (req = nct_req_mag.mag_head)) {
+        nct_req_mag.mag_head = req->req_next;
+        nct_req_mag.mag_cnt--;
+
+        req->req_next = mnt->mnt_req_head;
+        mnt->mnt_req_head = req;
+    }
+
+    if (mnt->mnt_req_waiters > 0)
+        pthread_cond_broadcast(&mnt->mnt_req_cv);
+    pthread_mutex_unlock(&mnt->mnt_req_mtx);
+}
+
+/* Return all the requests cached by the calling thread to the pool of
+ * the given mount (e.g., prior to unmounting it).
+ */
+void
+nct_req_mag_flush(nct_mnt_t *mnt)
+{
+    if (!mnt || nct_req_mag.mag_mnt != mnt)
+        return;
+
+    nct_req_mag_spill(mnt, UINT_MAX);
+    nct_req_mag.mag_mnt = NULL;
+}
+
+/* Allocate a request object from the calling thread's cache, refilling
+ * the cache from the free pool as needed.  Blocks only if the free pool
+ * is empty.
+ */
+nct_req_t *
+nct_req_alloc(nct_mnt_t *mnt)
+{
+    nct_req_t *req;
+    u_int n;
+
+    if (nct_req_mag.mag_mnt != mnt)
+        nct_req_mag_flush(nct_req_mag.mag_mnt);
+
+    req = nct_req_mag.mag_head;
+    if (req) {
+        nct_req_mag.mag_head = req->req_next;
+        nct_req_mag.mag_cnt--;
+    }
+    else {
+        pthread_mutex_lock(&mnt->mnt_req_mtx);
+        while (!mnt->mnt_req_head) {
+            /* Double the pool (within limits) rather than wait,
+             * unless another thread is already growing it.
+             */
+            if (!mnt->mnt_req_growing && mnt->mnt_reqs_cnt < mnt->mnt_reqs_max) {
+                n = mnt->mnt_reqs_cnt;
+                if (n < NCT_REQ_CHUNK)
+                    n = NCT_REQ_CHUNK;
+                if (n > mnt->mnt_reqs_max - mnt->mnt_reqs_cnt)
+                    n = mnt->mnt_reqs_max - mnt->mnt_reqs_cnt;
+
+                nct_req_grow(mnt, n, 0);
+                continue;
+            }
+
+            ++mnt->mnt_req_waiters;
+            pthread_cond_wait(&mnt->mnt_req_cv, &mnt->mnt_req_mtx);
+            --mnt->mnt_req_waiters;
+        }
+
+        req = mnt->mnt_req_head;
+        mnt->mnt_req_head = req->req_next;
+
+        /* Refill the cache, but leave the rest for any waiters.
+         */
+        for (n = 1; n < NCT_REQ_MAG && mnt->mnt_req_head && !mnt->mnt_req_waiters; ++n) {
+            nct_req_t *next = mnt->mnt_req_head;
+
+            mnt->mnt_req_head = next->req_next;
+            next->req_next = nct_req_mag.mag_head;
+            nct_req_mag.mag_head = next;
+            nct_req_mag.mag_cnt++;
+        }
+        pthread_mutex_unlock(&mnt->mnt_req_mtx);
+
+        nct_req_mag.mag_mnt = mnt;
+    }
+
+    /* Spread requests (and hence jobs) across the connections in use.
+     */
+    n = __atomic_fetch_add(&mnt->mnt_conn_next, 1, __ATOMIC_RELAXED);
+    req->req_conn = mnt->mnt_connv + (n % mnt->mnt_conns_used);
+
+    req->req_cb = NULL;
+    req->req_done = 0;
+    req->req_sink = NULL;
+    req->req_sinkfd = -1;
+    req->req_vn = mnt->mnt_vn;
+
+    return req;
+}
+
+/* Return a request object to the calling thread's cache, spilling half
+ * the cache back to the free pool when it is full.
+ */
+void
+nct_req_free(nct_req_t *req)
+{
+    nct_mnt_t *mnt = req->req_mnt;
+
+    if (nct_req_mag.mag_mnt != mnt) {
+        nct_req_mag_flush(nct_req_mag.mag_mnt);
+        nct_req_mag.mag_mnt = mnt;
+    }
+
+    req->req_next = nct_req_mag.mag_head;
+    nct_req_mag.mag_head = req;
+    nct_req_mag.mag_cnt++;
+
+    if (__atomic_load_n(&mnt->mnt_req_waiters, __ATOMIC_RELAXED) > 0)
+        nct_req_mag_spill(mnt, UINT_MAX);
+    else if (nct_req_mag.mag_cnt >= NCT_REQ_MAG * 2)
+        nct_req_mag_spill(mnt, NCT_REQ_MAG);
+}
+
+/* Create the request pool, the in-flight request tables, and the
+ * per-connection receive buffers.  The pool starts out large enough
+ * for all the jobs and grows on demand up to mnt_reqs_max requests.
+ */
+void
+nct_req_create(nct_mnt_t *mnt)
+{
+    size_t msgsz, tblsz, sz;
+    nct_msg_t *spares;
+    u_int tblmax, n;
+    void *tblbase;
+    int i;
+
+    /* Each message buffer is rounded up to a whole number of pages,
+     * the slack going to mnt_msgsz.
+     */
+    msgsz = sizeof(nct_msg_t) + mnt->mnt_msgsz;
+    msgsz = (msgsz + 4096 - 1) & ~(4096 - 1);
+    mnt->mnt_msgsz = msgsz - sizeof(nct_msg_t);
+
+    /* Each connection's table has a slot for every request that
+     * could possibly be in flight.
+     */
+    for (tblmax = 1; tblmax < mnt->mnt_reqs_max; tblmax <<= 1)
+        continue;
+
+    tblsz = tblmax * sizeof(nct_slot_t) * mnt->mnt_conns_max;
+    tblsz = (tblsz + (2u << 20) - 1) & ~((2u << 20) - 1);
+
+    tblbase = nct_req_region(mnt, tblsz);
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i) {
+        mnt->mnt_connv[i].conn_req_tbl = (nct_slot_t *)tblbase + i * tblmax;
+        mnt->mnt_connv[i].conn_req_mask = tblmax - 1;
+    }
+
+    n = mnt->mnt_jobs_max + NCT_REQ_CHUNK;
+    if (n > mnt->mnt_reqs_max)
+        n = mnt->mnt_reqs_max;
+
+    pthread_mutex_lock(&mnt->mnt_req_mtx);
+    spares = nct_req_grow(mnt, n, mnt->mnt_conns_max);
+    pthread_mutex_unlock(&mnt->mnt_req_mtx);
+
+    /* Create the per-connection receive buffers.
+     */
+    sz = NCT_RXBUF_SZ * mnt->mnt_conns_max;
+    sz = (sz + (2u << 20) - 1) & ~((2u << 20) - 1);
+
+    mnt->mnt_rxbase = nct_req_region(mnt, sz);
+    mnt->mnt_rxbasesz = sz;
+
+    for (i = 0; i < mnt->mnt_conns_max; ++i)
+        nct_req_rx_init(mnt->mnt_connv + i, mnt->mnt_rxbase + i * NCT_RXBUF_SZ,
+                        (void *)spares + i * (sizeof(nct_msg_t) + mnt->mnt_msgsz));
+}
+
+/* Unmap all the regions created for the given mount, which must no
+ * longer have any requests in use (i.e., all its threads have been
+ * joined and the caller's request cache has been flushed).
+ */
+void
+nct_req_destroy(nct_mnt_t *mnt)
+{
+    nct_region_t *rgn;
+
+    while ((rgn = mnt->mnt_region_head)) {
+        mnt->mnt_region_head = rgn->rgn_next;
+
+        if (munmap(rgn->rgn_base, rgn->rgn_sz)) {
+            eprint("munmap(%p, %zu) failed: %s\n",
+                   rgn->rgn_base, rgn->rgn_sz, strerror(errno));
+            abort();
+        }
+        free(rgn);
+    }
+
+    mnt->mnt_msgbase = mnt->mnt_rxbase = NULL;
+    mnt->mnt_req_head = NULL;
+}
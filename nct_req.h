@@ -26,40 +26,114 @@
 #define NCT_REQ_H
 
 #include "nct.h"
+#include "nct_nfstypes.h"
 
-/* Max number of NFS requests
+/* Default max number of NFS requests (see nct_mount()), and the min
+ * number by which the request pool grows.
  */
-#define NCT_REQ_SHIFT      (10)
-#define NCT_REQ_MAX        (1u << NCT_REQ_SHIFT)
+#define NCT_REQ_MAX        (1024)
+#define NCT_REQ_CHUNK      (256)
+
+/* Each message buffer holds both the call and (after the exchange in
+ * nct_req_rx_parse()) the reply of a request, so its size is given by
+ * the largest reply of the workload (see nct_mount()).  NCT_MSGSZ_MIN
+ * suffices for all replies but those with a data payload, and is also
+ * the room left for the RPC and NFS headers of such replies.
+ */
+#define NCT_MSGSZ_MIN      (1024 * 4 - sizeof(struct nct_msg_s))
+#define NCT_MSGSZ_MAX      (1024 * 1024 * 64)
+
+/* Size of each connection's receive buffer, and the minimum remaining
+ * fragment size that is received directly into the message buffer
+ * rather than being copied through the receive buffer.
+ */
+#define NCT_RXBUF_SZ       (1024 * 64)
+#define NCT_RXDIRECT_MIN   (1024 * 4)
+
+/* Max number of replies parsed from the receive buffer per batch.
+ */
+#define NCT_RX_BATCH       (32)
+
+/* Max size of an encoded call that can serve as a request's template
+ * (see req_tmpl).  Calls with large AUTH_UNIX credentials might not fit,
+ * in which case they are simply encoded in full each time.
+ */
+#define NCT_TMPL_MAX       (512)
 
-/* TODO: Make this setable via the command line
+/* Min payload of a batch of calls sent with MSG_ZEROCOPY (if enabled),
+ * below which the page pinning and completion notifications cost more
+ * than the copy would.
  */
-#define NCT_MSGSZ_MAX      (1024 * 256 - sizeof(struct nct_msg_s))
+#define NCT_ZEROCOPY_MIN   (1024 * 16)
 
 struct nct_mnt_s;
+struct nct_conn_s;
 struct nct_req;
 
 typedef int nct_req_cb_t(struct nct_req *req);
 
+/* A sink function examines the first len bytes of a reply and returns
+ * the length of its header if it is followed by a bulk payload of
+ * *payloadp bytes (which the receive path then discards or splices
+ * into req_sinkfd rather than copying it into the message buffer).
+ * Returns zero if more bytes are needed, or -1 if there's no payload.
+ */
+typedef ssize_t nct_req_sink_t(const void *buf, size_t len, size_t *payloadp);
+
 typedef struct nct_msg_s {
     XDR                 msg_xdr;            // RPC reply xdr
     struct rpc_msg      msg_rpc;            // RPC reply message
     struct rpc_err      msg_err;            // RPC reply error
     enum clnt_stat      msg_stat;           // RPC reply status code
     size_t              msg_len;            // TX/RX message length
+    u_int               msg_resoff;         // Offset of the reply's results
 
     __aligned(64)
-    char                msg_data[];         // TX/RX message buffer (NCT_MSGSZ_MAX)
+    char                msg_data[];         // TX/RX message buffer (mnt_msgsz)
 } nct_msg_t;
 
+/* Set up xb to decode the results of the reply in msg (decoded opaque
+ * data refers to the message buffer).
+ */
+static inline void
+nct_msg_results(nct_msg_t *msg, nct_xbuf_t *xb, void *heap, size_t heapsz)
+{
+    nct_xbuf_init(xb, msg->msg_data + msg->msg_resoff,
+                  msg->msg_len - msg->msg_resoff, heap, heapsz);
+}
+
 typedef struct nct_req {
     nct_msg_t          *req_msg;
     void               *req_mnt;
+    void               *req_conn;
     uint32_t            req_xid;
     nct_req_cb_t       *req_cb;
     int                 req_done;
 
+    nct_req_sink_t     *req_sink;           // Reply payload sink (may be NULL)
+    int                 req_sinkfd;         // Write the payload here if not -1
+    off_t               req_sinkoff;        // ... at this offset
+
+    u_int               req_proc;           // Stats key (see NCT_PROC_MAX)
+    const char         *req_payload;        // Sent in place after the call
+    size_t              req_paylen;         // Its length (incl. pad, may be 0)
+    size_t              req_txbytes;        // Size of the call (for stats)
+    size_t              req_rxbytes;        // Size of the reply (for stats)
+
+    /* The most recent call encoded for this request, from which the
+     * next call of the same procedure and arguments is copied (with
+     * only its variable fields patched) rather than encoded anew.
+     */
+    u_int               req_tmpl_proc;      // Procedure of the template
+    const void         *req_tmpl_key;       // Its arguments (e.g., file handle)
+    uint32_t            req_tmpl_count;     // Its count (READ)
+    u_short             req_tmpl_len;       // Length (zero if none)
+    u_short             req_tmpl_offset;    // Offset of the offset field (READ)
+
     void               *req_priv;
+    u_int               req_job;            // Index of the job (< req_jobs)
+    u_int               req_jobs;           // Number of jobs started together
+    struct nct_vn_s    *req_vn;             // Target of the job (see mnt_vnv)
     int                 req_argc;
     char              **req_argv;
 
@@ -72,11 +146,30 @@ typedef struct nct_req {
     struct nct_req     *req_next;
     struct nct_req    **req_prev;
 
+    char                req_tmpl[NCT_TMPL_MAX];
+
 } nct_req_t;
 
+/* A slot in a connection's in-flight request table, which is indexed
+ * by xid & conn_req_mask.  Each slot has a cache line to itself so that
+ * the threads sending and completing consecutive xids never contend
+ * on the same line.
+ */
+typedef struct nct_slot_s {
+    __aligned(64)
+    nct_req_t          *slot_req;           // In-flight request (or NULL)
+} nct_slot_t;
+
 extern void *nct_req_send_loop(void *arg);
 extern void *nct_req_recv_loop(void *arg);
+extern void *nct_req_epoll_loop(void *arg);
+extern void nct_req_epoll_add(struct nct_conn_s *conn);
+extern int nct_req_uring_start(struct nct_mnt_s *mnt);
+extern void nct_req_uring_destroy(struct nct_mnt_s *mnt);
 
 extern void nct_req_create(struct nct_mnt_s *mnt);
+extern void nct_req_destroy(struct nct_mnt_s *mnt);
+extern const char *nct_req_pattern(size_t len);
+extern void nct_req_pattern_free(const char *pattern, size_t len);
 
 #endif // NCT_REQ_H
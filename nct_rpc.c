@@ -39,6 +39,7 @@
 #include <unistd.h>
 #include <pthread.h>
 
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -51,21 +52,38 @@
 #include "main.h"
 #include "nct_rpc.h"
 
+/* Fill in the record mark at the front of the given single-fragment
+ * RPC record.
+ */
+void
+nct_rpc_mark(void *buf, size_t bufsz)
+{
+    uint32_t mark;
+
+    mark = htonl((bufsz - sizeof(mark)) | 0x80000000u);
+    memcpy(buf, &mark, sizeof(mark));
+}
+
 ssize_t
 nct_rpc_send(int fd, void *buf, size_t bufsz)
 {
-    uint32_t mark;
     size_t nleft;
     ssize_t cc;
 
-    mark = htonl((bufsz - sizeof(mark)) | 0x80000000u);
-    memcpy(buf, &mark, sizeof(mark));
+    nct_rpc_mark(buf, bufsz);
 
     nleft = bufsz;
 
     while (nleft > 0) {
-        cc = send(fd, buf, nleft, 0);
+        cc = send(fd, buf, nleft, MSG_NOSIGNAL);
         if (cc < 1) {
+            if (cc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+
+                if (poll(&pfd, 1, -1) > 0 || errno == EINTR)
+                    continue;
+            }
+
             return (cc == -1) ? -1 : 0;
         }
 
@@ -81,10 +99,12 @@ nct_rpc_recv(int fd, void *buf, size_t bufsz, uint32_t *markp)
 {
     const size_t marksz = sizeof(*markp);
     uint32_t mark, recsz;
-    size_t nleft;
+    size_t nleft, len;
     ssize_t cc;
     bool last;
 
+    len = 0;
+
   again:
     mark = markp ? *markp : 0;
 
@@ -115,10 +135,9 @@ nct_rpc_recv(int fd, void *buf, size_t bufsz, uint32_t *markp)
         bufsz -= cc;
         buf += cc;
 
-        if (last && nleft == marksz) {
-            if (markp)
-                *markp = 0;
-            return recsz;
+        if (markp && last && nleft == marksz) {
+            *markp = 0;
+            return len + recsz;
         }
     }
 
@@ -128,16 +147,23 @@ nct_rpc_recv(int fd, void *buf, size_t bufsz, uint32_t *markp)
         memcpy(markp, buf, marksz);
     }
 
+    /* The record length is the sum of its fragment lengths.
+     */
+    len += recsz;
+
     if (!last)
         goto again;
 
-    return recsz;
+    return len;
 }
 
+/* Encode the header of an RPC call into buf, leaving room at the front
+ * for the record mark.  Returns the length of the header including the
+ * record mark (i.e., the offset in buf at which the caller encodes the
+ * call's arguments), or -1 if it doesn't fit.
+ */
 int
-nct_rpc_encode(struct rpc_msg *msg, AUTH *auth,
-               xdrproc_t xdrproc, void *args,
-               char *buf, int bufsz)
+nct_rpc_encode(struct rpc_msg *msg, AUTH *auth, char *buf, int bufsz)
 {
     int len = -1;
     XDR xdr;
@@ -158,7 +184,7 @@ nct_rpc_encode(struct rpc_msg *msg, AUTH *auth,
      */
     xdrmem_create(&xdr, buf + 4, bufsz - 4, XDR_ENCODE);
 
-    if (xdr_callmsg(&xdr, msg) && (*xdrproc)(&xdr, args))
+    if (xdr_callmsg(&xdr, msg))
         len = xdr_getpos(&xdr) + 4;
 
     xdr_destroy(&xdr);
@@ -166,12 +192,40 @@ nct_rpc_encode(struct rpc_msg *msg, AUTH *auth,
     return len;
 }
 
+/* Decode the header of an RPC reply, leaving the XDR stream positioned
+ * at the results.  The common case of an accepted and successful reply
+ * is validated with straight loads (without the verifier body), while
+ * all others (e.g., denied or auth errors) are left to libtirpc.
+ */
 enum clnt_stat
 nct_rpc_decode(XDR *xdr, char *buf, int len,
                struct rpc_msg *rpc_msg, struct rpc_err *rpc_err)
 {
+    const uint32_t *p = (const void *)buf;
+    u_int n = len / BYTES_PER_XDR_UNIT;
+    u_int verflen, i;
+
     xdrmem_create(xdr, buf, len, XDR_DECODE);
 
+    if (n >= 6 && p[1] == htonl(REPLY) && p[2] == htonl(MSG_ACCEPTED)) {
+        verflen = ntohl(p[4]);
+        i = 5 + (verflen + BYTES_PER_XDR_UNIT - 1) / BYTES_PER_XDR_UNIT;
+
+        if (verflen <= MAX_AUTH_BYTES && i < n && p[i] == htonl(SUCCESS)) {
+            rpc_msg->rm_xid = ntohl(p[0]);
+            rpc_msg->rm_direction = REPLY;
+            rpc_msg->rm_reply.rp_stat = MSG_ACCEPTED;
+            rpc_msg->acpted_rply.ar_verf = _null_auth;
+            rpc_msg->acpted_rply.ar_verf.oa_flavor = ntohl(p[3]);
+            rpc_msg->acpted_rply.ar_stat = SUCCESS;
+            rpc_err->re_status = RPC_SUCCESS;
+
+            XDR_SETPOS(xdr, (i + 1) * BYTES_PER_XDR_UNIT);
+
+            return RPC_SUCCESS;
+        }
+    }
+
     rpc_msg->acpted_rply.ar_verf = _null_auth;
     rpc_msg->acpted_rply.ar_results.where = NULL;
     rpc_msg->acpted_rply.ar_results.proc = (xdrproc_t)xdr_void;
@@ -29,54 +29,9 @@
 
 #include "nct_nfstypes.h"
 
-#define MOUNT_PROGRAM       (100005)
-#define MOUNT_V3            (3)
-#define MOUNT3_MNT          (1)
-
-#define MNTPATHLEN          (1024)
-#define FHSIZE3             (64)
-
-#define NFS_PROGRAM         (100003)
-#define NFS_V3              (3)
-
-enum mountstat3 {
-    MNT3_OK = 0,
-    MNT3ERR_PERM = 1,
-    MNT3ERR_NOENT = 2,
-    MNT3ERR_IO = 5,
-    MNT3ERR_ACCES = 13,
-    MNT3ERR_NOTDIR = 20,
-    MNT3ERR_INVAL = 22,
-    MNT3ERR_NAMETOOLONG = 63,
-    MNT3ERR_NOTSUPP = 10004,
-    MNT3ERR_SERVERFAULT = 10006,
-};
-
-typedef enum mountstat3 mountstat3;
-
-struct mountres3_ok {
-    fhandle3 fhandle;
-    struct {
-        u_int auth_flavors_len;
-        int *auth_flavors_val;
-    } auth_flavors;
-};
-
-typedef struct mountres3_ok mountres3_ok;
-
-struct mountres3 {
-    mountstat3 fhs_status;
-    union {
-        mountres3_ok mountinfo;
-    } mountres3_u;
-};
-
-typedef struct mountres3 mountres3;
-
-extern int nct_rpc_encode(struct rpc_msg *msg, AUTH *auth,
-                          xdrproc_t xdrproc, void *args,
-                          char *buf, int bufsz);
+extern int nct_rpc_encode(struct rpc_msg *msg, AUTH *auth, char *buf, int bufsz);
 
+extern void nct_rpc_mark(void *buf, size_t len);
 extern ssize_t nct_rpc_send(int fd, void *buf, size_t len);
 extern ssize_t nct_rpc_recv(int fd, void *buf, size_t len, uint32_t *markp);
 
@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sysexits.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#include <rpc/types.h>
+#include <rpc/auth.h>
+#include <rpc/rpc.h>
+
+#include "clp.h"
+#include "main.h"
+#include "nct.h"
+#include "nct_sweep.h"
+
+/* Max number of values per axis of the grid.
+ */
+#define NCT_SWEEP_VALS      (32)
+
+/* The results of one point of the grid.
+ */
+typedef struct {
+    u_int       pt_tds;
+    u_int       pt_conns;
+    u_long      pt_length;
+    u_int       pt_jobs;
+    double      pt_ops;                 // Requests per second
+    double      pt_txmbs;               // MiB per second sent
+    double      pt_rxmbs;               // MiB per second received
+    double      pt_latavg;              // Latencies in usecs
+    double      pt_latp50;
+    double      pt_latp99;
+    double      pt_latp999;
+    bool        pt_knee;
+} nct_sweep_pt_t;
+
+static char *jobs_list;
+static char *tds_list;
+static char *conns_list;
+static char *length_list;
+static char *csvpath = "sweep.csv";
+static time_t warmup = 1;
+static char *test;
+static char *args;
+
+static struct clp_posparam posparamv[] = {
+    CLP_POSPARAM("test", string, test, NULL, NULL, "test to sweep [getattr,read,write,null]"),
+    CLP_POSPARAM("[args...]", string, args, NULL, NULL, "test arguments"),
+    CLP_POSPARAM_END
+};
+
+static struct clp_option optionv[] = {
+    CLP_OPTION('c', string, conns_list, NULL, "list of connection counts (e.g., 1,2,4)"),
+    CLP_OPTION('f', string, csvpath, NULL, "file into which to write the CSV results"),
+    CLP_OPTION('j', string, jobs_list, NULL, "list of job counts (e.g., 1,2,4,8)"),
+    CLP_OPTION('l', string, length_list, NULL, "list of read lengths (read test only)"),
+    CLP_OPTION('t', string, tds_list, NULL, "list of recv thread counts"),
+    CLP_OPTION('w', time_t, warmup, NULL, "warmup of each point (in seconds)"),
+    CLP_OPTION_VERBOSITY(verbosity),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+static bool
+given(int c)
+{
+    return !!clp_given(c, optionv, NULL);
+}
+
+static int
+nct_sweep_cmp(const void *lhs, const void *rhs)
+{
+    u_long l = *(const u_long *)lhs;
+    u_long r = *(const u_long *)rhs;
+
+    return (l > r) - (l < r);
+}
+
+/* Parse a comma separated list of positive integers into valv (sorted
+ * in ascending order without duplicates, as nct_sweep_knee() compares
+ * neighbors), or use the given default if the list is nil.
+ */
+static int
+nct_sweep_list(const char *list, u_long dflt, u_long *valv, const char *what)
+{
+    const char *pc;
+    char *end;
+    int valc, i, n;
+
+    if (!list) {
+        valv[0] = dflt;
+        return 1;
+    }
+
+    for (valc = 0, pc = list; valc < NCT_SWEEP_VALS; pc = end + 1) {
+        errno = 0;
+        valv[valc] = strtoul(pc, &end, 0);
+        if (errno || end == pc || valv[valc] == 0)
+            break;
+
+        ++valc;
+
+        if (!*end) {
+            qsort(valv, valc, sizeof(*valv), nct_sweep_cmp);
+
+            for (i = n = 1; i < valc; ++i) {
+                if (valv[i] != valv[n - 1])
+                    valv[n++] = valv[i];
+            }
+
+            return n;
+        }
+        if (*end != ',')
+            break;
+    }
+
+    eprint("invalid %s list [%s], use -h for help\n", what, list);
+
+    return -1;
+}
+
+/* Sleep until the given time (in cycles).
+ */
+static void
+nct_sweep_sleep(uint64_t tsc)
+{
+    uint64_t now;
+
+    while ((now = rdtsc()) < tsc)
+        usleep(((tsc - now) * 1000000) / tsc_freq);
+}
+
+/* Run the jobs of one point of the grid on the given mount, and measure
+ * the interval between the end of the warmup and the end of the run.
+ * The jobs are expected to run for the warmup plus the duration of the
+ * point, after which we wait for the last of them to finish.
+ */
+static void
+nct_sweep_run(nct_mnt_t *mnt, void *priv, start_t *start, int argc, char **argv,
+              time_t duration, nct_hist_t *histv, nct_sweep_pt_t *pt)
+{
+    struct nct_stats s0, s1;
+    uint64_t tsc_begin, tsc0, tsc1;
+    nct_req_t *req;
+    double secs;
+    u_int i;
+
+    mnt->mnt_conns_used = pt->pt_conns;
+    mnt->mnt_conn_next = 0;
+
+    tsc_begin = rdtsc();
+
+    for (i = 0; i < pt->pt_jobs; ++i) {
+        __atomic_add_fetch(&mnt->mnt_jobs_cnt, 1, __ATOMIC_SEQ_CST);
+
+        req = nct_req_alloc(mnt);
+        req->req_priv = priv;
+        req->req_job = i;
+        req->req_jobs = pt->pt_jobs;
+        req->req_vn = mnt->mnt_vnv[i % mnt->mnt_vnc];
+        req->req_argc = argc;
+        req->req_argv = argv;
+
+        start(req);
+    }
+
+    nct_sweep_sleep(tsc_begin + tsc_freq * warmup);
+
+    tsc0 = rdtsc();
+    nct_mnt_stats(mnt, &s0, false);
+    nct_mnt_hist(mnt, -1, histv);
+
+    nct_sweep_sleep(tsc_begin + tsc_freq * (warmup + duration));
+
+    tsc1 = rdtsc();
+    nct_mnt_stats(mnt, &s1, false);
+    nct_mnt_hist(mnt, -1, histv + 1);
+
+    while (__atomic_load_n(&mnt->mnt_jobs_cnt, __ATOMIC_SEQ_CST) > 0)
+        usleep(10 * 1000);
+
+    secs = (double)(tsc1 - tsc0) / tsc_freq;
+
+    pt->pt_ops = (s1.requests - s0.requests) / secs;
+    pt->pt_txmbs = (s1.thruput_send - s0.thruput_send) / (secs * 1024 * 1024);
+    pt->pt_rxmbs = (s1.thruput_recv - s0.thruput_recv) / (secs * 1024 * 1024);
+
+    pt->pt_latavg = 0;
+    if (s1.requests > s0.requests)
+        pt->pt_latavg = ((s1.latency_cum - s0.latency_cum) * 1000000.0) /
+            (tsc_freq * (s1.requests - s0.requests));
+
+    pt->pt_latp50 = (nct_hist_pct(histv + 1, histv, 50) * 1000000.0) / tsc_freq;
+    pt->pt_latp99 = (nct_hist_pct(histv + 1, histv, 99) * 1000000.0) / tsc_freq;
+    pt->pt_latp999 = (nct_hist_pct(histv + 1, histv, 99.9) * 1000000.0) / tsc_freq;
+}
+
+/* Initialize the given test for a point of the sweep.  Given a read
+ * length the test's arguments are extended by it (i.e., the test must
+ * not have been given one).
+ */
+static void *
+nct_sweep_init(test_init_t *test_init, int argc, char **argv, u_long length, int duration,
+               start_t **startp, char **rhostpathp, size_t *msgszp)
+{
+    char lenbuf[32], *argvbuf[argc + 2];
+    int i;
+
+    for (i = 0; i < argc; ++i)
+        argvbuf[i] = argv[i];
+
+    if (length > 0) {
+        snprintf(lenbuf, sizeof(lenbuf), "%lu", length);
+        argvbuf[argc++] = lenbuf;
+    }
+
+    argvbuf[argc] = NULL;
+
+    return test_init(argc, argvbuf, duration, startp, rhostpathp, msgszp);
+}
+
+/* Mark the knee of each series of points that differ only by jobs,
+ * i.e., the last point before the gain in throughput from deeper
+ * concurrency drops below NCT_SWEEP_KNEE_GAIN while latency grows.
+ */
+static void
+nct_sweep_knee(nct_sweep_pt_t *ptv, u_int ptc, u_int jobsc)
+{
+    u_int i, j;
+
+    for (i = 0; i + jobsc <= ptc; i += jobsc) {
+        nct_sweep_pt_t *pt = ptv + i;
+
+        for (j = 0; j + 1 < jobsc; ++j) {
+            if (pt[j + 1].pt_ops < pt[j].pt_ops * (1 + NCT_SWEEP_KNEE_GAIN) &&
+                pt[j + 1].pt_latavg > pt[j].pt_latavg) {
+                pt[j].pt_knee = true;
+                break;
+            }
+        }
+    }
+}
+
+static void
+nct_sweep_print(FILE *fp, nct_sweep_pt_t *pt, bool csv)
+{
+    const char *fmt;
+    char lenbuf[32];
+
+    if (csv)
+        fmt = "%u,%u,%lu,%u,%.1lf,%.2lf,%.2lf,%.1lf,%.1lf,%.1lf,%.1lf,%d\n";
+    else
+        fmt = "%5u %5u %8s %6u %10.1lf %8.2lf %8.2lf %9.1lf %9.1lf %9.1lf %9.1lf %5s\n";
+
+    if (csv) {
+        fprintf(fp, fmt, pt->pt_tds, pt->pt_conns, pt->pt_length, pt->pt_jobs,
+                pt->pt_ops, pt->pt_txmbs, pt->pt_rxmbs,
+                pt->pt_latavg, pt->pt_latp50, pt->pt_latp99, pt->pt_latp999,
+                pt->pt_knee);
+        return;
+    }
+
+    snprintf(lenbuf, sizeof(lenbuf), pt->pt_length ? "%lu" : "-", pt->pt_length);
+
+    fprintf(fp, fmt, pt->pt_tds, pt->pt_conns, lenbuf, pt->pt_jobs,
+            pt->pt_ops, pt->pt_txmbs, pt->pt_rxmbs,
+            pt->pt_latavg, pt->pt_latp50, pt->pt_latp99, pt->pt_latp999,
+            pt->pt_knee ? "<--" : "");
+}
+
+/* Run the given test over the grid given by the lists of recv threads,
+ * connections, read lengths, and jobs (in that order of nesting).
+ * Each point runs for the warmup plus the main duration (-d) and is
+ * measured over the latter.  All the points with the same number of
+ * recv threads share one mount (and hence request pool), which is
+ * sized for the largest of the other axes.
+ */
+int
+nct_sweep(int argc, char **argv, const nct_sweep_parms_t *parms)
+{
+    u_long jobsv[NCT_SWEEP_VALS], tdsv[NCT_SWEEP_VALS];
+    u_long connsv[NCT_SWEEP_VALS], lengthv[NCT_SWEEP_VALS];
+    int jobsc, tdsc, connsc, lengthc;
+    u_long jobs_max, conns_max;
+    nct_sweep_pt_t *ptv, *pt;
+    char *rhostpath = NULL;
+    test_init_t *test_init;
+    test_fini_t *test_fini;
+    size_t msgsz, msgsz_max;
+    nct_hist_t *histv;
+    start_t *start;
+    u_int ptc, i;
+    void *priv;
+    int t, c, l, j;
+    FILE *fp;
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+    if (rc)
+        return rc;
+
+    if (given('h') || given('V'))
+        return 0;
+
+    argc -= optind;
+    argv += optind;
+
+    jobsc = nct_sweep_list(jobs_list, parms->sp_jobs, jobsv, "jobs");
+    tdsc = nct_sweep_list(tds_list, parms->sp_tds, tdsv, "threads");
+    connsc = nct_sweep_list(conns_list, parms->sp_conns, connsv, "connections");
+    lengthc = nct_sweep_list(length_list, 0, lengthv, "length");
+
+    if (jobsc < 1 || tdsc < 1 || connsc < 1 || lengthc < 1)
+        return EX_USAGE;
+
+    test_init = test_lookup(argv[0], &test_fini);
+    if (!test_init) {
+        eprint("invalid test [%s], use -h for help\n", argv[0]);
+        return EX_USAGE;
+    }
+
+    if (length_list && 0 != strcmp(argv[0], "read")) {
+        eprint("-l applies only to the read test\n");
+        return EX_USAGE;
+    }
+
+    /* Size the mount for the most demanding point...
+     */
+    jobs_max = conns_max = msgsz_max = 0;
+
+    for (j = 0; j < jobsc; ++j) {
+        if (jobsv[j] > jobs_max)
+            jobs_max = jobsv[j];
+    }
+
+    for (c = 0; c < connsc; ++c) {
+        if (connsv[c] > conns_max)
+            conns_max = connsv[c];
+    }
+
+    for (l = 0; l < lengthc; ++l) {
+        msgsz = 0;
+        priv = nct_sweep_init(test_init, argc, argv, lengthv[l], parms->sp_duration,
+                              &start, &rhostpath, &msgsz);
+        if (!priv || !start || !rhostpath)
+            abort();
+
+        if (msgsz > msgsz_max)
+            msgsz_max = msgsz;
+        test_fini(priv);
+    }
+
+    ptc = jobsc * tdsc * connsc * lengthc;
+
+    ptv = calloc(ptc, sizeof(*ptv));
+    histv = malloc(sizeof(*histv) * 2);
+    if (!ptv || !histv)
+        abort();
+
+    printf("sweeping %u points of %ld+%ld seconds each\n\n",
+           ptc, (long)warmup, (long)parms->sp_duration);
+
+    printf("%5s %5s %8s %6s %10s %8s %8s %9s %9s %9s %9s %5s\n",
+           "TDS", "CONNS", "LENGTH", "JOBS", "OPS", "TXMB/s", "RXMB/s",
+           "LATAVG", "LATP50", "LATP99", "LATP999", "KNEE");
+
+    pt = ptv;
+
+    for (t = 0; t < tdsc; ++t) {
+        nct_mnt_t *mnt;
+
+        mnt = nct_mount(rhostpath, parms->sp_port, conns_max, tdsv[t], jobs_max,
+                        parms->sp_reqs_max, msgsz_max, parms->sp_flags | NCT_MNT_REUSE);
+        if (!mnt) {
+            eprint("mount %s failed\n", rhostpath);
+            abort();
+        }
+
+        for (c = 0; c < connsc; ++c) {
+            for (l = 0; l < lengthc; ++l) {
+                for (j = 0; j < jobsc; ++j, ++pt) {
+                    priv = nct_sweep_init(test_init, argc, argv, lengthv[l],
+                                          warmup + parms->sp_duration,
+                                          &start, &rhostpath, &msgsz);
+
+                    pt->pt_tds = tdsv[t];
+                    pt->pt_conns = connsv[c];
+                    pt->pt_length = lengthv[l];
+                    pt->pt_jobs = jobsv[j];
+
+                    nct_sweep_run(mnt, priv, start, argc, argv,
+                                  parms->sp_duration, histv, pt);
+
+                    nct_sweep_print(stdout, pt, false);
+                    fflush(stdout);
+                    test_fini(priv);
+                }
+            }
+        }
+
+        nct_umount(mnt);
+    }
+
+    nct_sweep_knee(ptv, ptc, jobsc);
+
+    printf("\n");
+
+    for (i = 0, pt = ptv; i < ptc; ++i, ++pt) {
+        if (!pt->pt_knee)
+            continue;
+
+        printf("knee: ");
+        nct_sweep_print(stdout, pt, false);
+    }
+
+    fp = fopen(csvpath, "w");
+    if (fp) {
+        fprintf(fp, "tds,conns,length,jobs,ops,txmbs,rxmbs,latavg,latp50,latp99,latp999,knee\n");
+
+        for (i = 0; i < ptc; ++i)
+            nct_sweep_print(fp, ptv + i, true);
+
+        fclose(fp);
+    }
+    else {
+        eprint("unable to open [%s]: %s\n", csvpath, strerror(errno));
+    }
+
+    free(histv);
+    free(ptv);
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NCT_SWEEP_H
+#define NCT_SWEEP_H
+
+/* Min relative gain in throughput from one point of a sweep to the next
+ * (i.e., of deeper concurrency) below which the former is deemed the
+ * knee of the response curve.
+ */
+#define NCT_SWEEP_KNEE_GAIN     (0.05)
+
+/* Settings from the main command line, which supply the defaults of
+ * the sweep's grid.
+ */
+typedef struct nct_sweep_parms_s {
+    in_port_t           sp_port;
+    u_int               sp_flags;               // nct_mount() flags
+    u_int               sp_reqs_max;
+    u_int               sp_jobs;
+    u_int               sp_tds;
+    u_int               sp_conns;
+    time_t              sp_duration;            // Measured duration of each point
+} nct_sweep_parms_t;
+
+extern int nct_sweep(int argc, char **argv, const nct_sweep_parms_t *parms);
+
+#endif // NCT_SWEEP_H
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#if HAVE_IO_URING
+#include <sys/syscall.h>
+
+#include "nct_uring.h"
+
+/* Create an io_uring with (at least) the given number of SQ entries.
+ * The ring is created disabled where possible so that the thread
+ * that eventually calls nct_uring_enable() becomes its sole issuer.
+ * Returns zero on success, otherwise an errno.
+ */
+int
+nct_uring_init(nct_uring_t *ring, u_int entries)
+{
+    const u_int flagv[] = {
+        IORING_SETUP_R_DISABLED | IORING_SETUP_SINGLE_ISSUER |
+        IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SUBMIT_ALL,
+        IORING_SETUP_R_DISABLED | IORING_SETUP_SUBMIT_ALL,
+        0,
+    };
+    struct io_uring_params params;
+    int fd, i;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+
+    for (i = 0; i < sizeof(flagv) / sizeof(flagv[0]); ++i) {
+        memset(&params, 0, sizeof(params));
+        params.flags = flagv[i];
+
+        fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (fd != -1 || errno != EINVAL)
+            break;
+    }
+
+    if (fd == -1)
+        return errno;
+
+    ring->ring_fd = fd;
+    ring->ring_flags = params.flags;
+    ring->ring_entries = params.sq_entries;
+
+    ring->ring_sqmapsz = params.sq_off.array + params.sq_entries * sizeof(u_int);
+    ring->ring_cqmapsz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->ring_cqmapsz > ring->ring_sqmapsz)
+            ring->ring_sqmapsz = ring->ring_cqmapsz;
+        ring->ring_cqmapsz = 0;
+    }
+
+    ring->ring_sqmap = mmap(NULL, ring->ring_sqmapsz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->ring_sqmap == MAP_FAILED)
+        goto errout;
+
+    ring->ring_cqmap = ring->ring_sqmap;
+    if (ring->ring_cqmapsz > 0) {
+        ring->ring_cqmap = mmap(NULL, ring->ring_cqmapsz, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->ring_cqmap == MAP_FAILED)
+            goto errout;
+    }
+
+    ring->ring_sqessz = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->ring_sqes = mmap(NULL, ring->ring_sqessz, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->ring_sqes == MAP_FAILED)
+        goto errout;
+
+    ring->ring_sqhead_p = ring->ring_sqmap + params.sq_off.head;
+    ring->ring_sqtail_p = ring->ring_sqmap + params.sq_off.tail;
+    ring->ring_sqmask = *(u_int *)(ring->ring_sqmap + params.sq_off.ring_mask);
+    ring->ring_sqarray = ring->ring_sqmap + params.sq_off.array;
+    ring->ring_sqtail = *ring->ring_sqtail_p;
+
+    ring->ring_cqhead_p = ring->ring_cqmap + params.cq_off.head;
+    ring->ring_cqtail_p = ring->ring_cqmap + params.cq_off.tail;
+    ring->ring_cqmask = *(u_int *)(ring->ring_cqmap + params.cq_off.ring_mask);
+    ring->ring_cqes = ring->ring_cqmap + params.cq_off.cqes;
+
+    return 0;
+
+  errout:
+    i = errno;
+    nct_uring_fini(ring);
+
+    return i;
+}
+
+void
+nct_uring_fini(nct_uring_t *ring)
+{
+    if (ring->ring_sqes && ring->ring_sqes != MAP_FAILED)
+        munmap(ring->ring_sqes, ring->ring_sqessz);
+    if (ring->ring_cqmapsz > 0 && ring->ring_cqmap && ring->ring_cqmap != MAP_FAILED)
+        munmap(ring->ring_cqmap, ring->ring_cqmapsz);
+    if (ring->ring_sqmap && ring->ring_sqmap != MAP_FAILED)
+        munmap(ring->ring_sqmap, ring->ring_sqmapsz);
+    if (ring->ring_fd != -1)
+        close(ring->ring_fd);
+
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+}
+
+/* Enable a ring that was created disabled.  Must be called by the
+ * thread that will submit to the ring.
+ */
+int
+nct_uring_enable(nct_uring_t *ring)
+{
+    if (!(ring->ring_flags & IORING_SETUP_R_DISABLED))
+        return 0;
+
+    if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0))
+        return errno;
+
+    return 0;
+}
+
+/* Register the given regions as fixed buffers (indexed by their
+ * position in iov[]) for use by IORING_OP_READ_FIXED.  Returns zero
+ * on success, otherwise an errno.
+ */
+int
+nct_uring_register(nct_uring_t *ring, const struct iovec *iov, u_int iovcnt)
+{
+    if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_BUFFERS, iov, iovcnt))
+        return errno;
+
+    return 0;
+}
+
+/* Get a zeroed SQE, or NULL if the submission queue is full.
+ */
+struct io_uring_sqe *
+nct_uring_sqe(nct_uring_t *ring)
+{
+    struct io_uring_sqe *sqe;
+    u_int head, idx;
+
+    head = __atomic_load_n(ring->ring_sqhead_p, __ATOMIC_ACQUIRE);
+    if (ring->ring_sqtail - head >= ring->ring_entries)
+        return NULL;
+
+    idx = ring->ring_sqtail++ & ring->ring_sqmask;
+    ring->ring_sqarray[idx] = idx;
+    ring->ring_sqpend++;
+
+    sqe = ring->ring_sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+
+    return sqe;
+}
+
+/* Submit all pending SQEs and wait for at least wait_nr completions,
+ * all in a single system call.  Returns the number of SQEs consumed
+ * on success, otherwise -errno.
+ */
+int
+nct_uring_submit(nct_uring_t *ring, u_int wait_nr)
+{
+    u_int flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    int rc;
+
+    __atomic_store_n(ring->ring_sqtail_p, ring->ring_sqtail, __ATOMIC_RELEASE);
+
+    rc = syscall(__NR_io_uring_enter, ring->ring_fd, ring->ring_sqpend,
+                 wait_nr, flags, NULL, 0);
+    if (rc == -1)
+        return -errno;
+
+    ring->ring_sqpend -= rc;
+
+    return rc;
+}
+
+/* Return the next completion, or NULL if there are none.
+ */
+struct io_uring_cqe *
+nct_uring_cqe(nct_uring_t *ring)
+{
+    u_int head;
+
+    head = *ring->ring_cqhead_p;
+    if (head == __atomic_load_n(ring->ring_cqtail_p, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return ring->ring_cqes + (head & ring->ring_cqmask);
+}
+
+/* Release the completion returned by nct_uring_cqe().
+ */
+void
+nct_uring_cqe_seen(nct_uring_t *ring)
+{
+    __atomic_store_n(ring->ring_cqhead_p, *ring->ring_cqhead_p + 1, __ATOMIC_RELEASE);
+}
+#endif /* HAVE_IO_URING */
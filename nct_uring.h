@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NCT_URING_H
+#define NCT_URING_H
+
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+
+/* A minimal io_uring built directly upon the io_uring system calls
+ * (so as to avoid a dependency upon liburing).  Each ring is meant
+ * to be used by exactly one thread.
+ */
+typedef struct nct_uring_s {
+    int                  ring_fd;
+    u_int                ring_flags;            // Flags given to io_uring_setup()
+    u_int                ring_entries;          // Number of SQ entries
+
+    u_int                ring_sqtail;           // Local copy of the SQ tail
+    u_int                ring_sqpend;           // SQEs not yet submitted
+    u_int                ring_sqmask;
+    u_int               *ring_sqhead_p;
+    u_int               *ring_sqtail_p;
+    u_int               *ring_sqarray;
+    struct io_uring_sqe *ring_sqes;
+
+    u_int                ring_cqmask;
+    u_int               *ring_cqhead_p;
+    u_int               *ring_cqtail_p;
+    struct io_uring_cqe *ring_cqes;
+
+    void                *ring_sqmap;
+    size_t               ring_sqmapsz;
+    void                *ring_cqmap;
+    size_t               ring_cqmapsz;
+    size_t               ring_sqessz;
+} nct_uring_t;
+
+extern int nct_uring_init(nct_uring_t *ring, u_int entries);
+extern void nct_uring_fini(nct_uring_t *ring);
+extern int nct_uring_enable(nct_uring_t *ring);
+extern int nct_uring_register(nct_uring_t *ring, const struct iovec *iov, u_int iovcnt);
+
+extern struct io_uring_sqe *nct_uring_sqe(nct_uring_t *ring);
+extern int nct_uring_submit(nct_uring_t *ring, u_int wait_nr);
+extern struct io_uring_cqe *nct_uring_cqe(nct_uring_t *ring);
+extern void nct_uring_cqe_seen(nct_uring_t *ring);
+
+#endif /* HAVE_IO_URING */
+
+#endif // NCT_URING_H
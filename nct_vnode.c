@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
@@ -37,31 +38,304 @@
 
 #include <limits.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <sys/types.h>
 
 #include "nct_nfstypes.h"
 #include "nct_vnode.h"
 
+#define NCT_VN_CHUNKSZ      (2u << 20)          // Size of each vnode chunk
+#define NCT_VNTAB_MIN       (1024)              // Initial slots per index
+
+static uint32_t
+nct_vn_hash(uint64_t seed, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    uint64_t h = 0xcbf29ce484222325ull ^ seed;
+
+    while (len-- > 0) {
+        h ^= *p++;
+        h *= 0x100000001b3ull;
+    }
+
+    /* Fold in the high bits, as the index uses only the low ones.
+     */
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+
+    return h;
+}
+
+static uint32_t
+nct_vn_namehash(const nct_vn_t *dvn, const char *name, size_t namelen)
+{
+    return nct_vn_hash((uintptr_t)dvn, name, namelen);
+}
+
+static nct_vntab_t *
+nct_vntab_alloc(size_t nslots)
+{
+    nct_vntab_t *tab;
+
+    tab = calloc(1, sizeof(*tab) + sizeof(tab->vt_slotv[0]) * nslots);
+    if (tab)
+        tab->vt_mask = nslots - 1;
+
+    return tab;
+}
+
+/* Put vn into the first free slot at or after the slot for hash.  The
+ * vnode and the slot's hash are set before the vnode is published, so
+ * the store is a release to pair with the acquire loads of the lookups.
+ */
+static void
+nct_vntab_put(nct_vntab_t *tab, nct_vn_t *vn, uint32_t hash)
+{
+    size_t i;
+
+    for (i = hash & tab->vt_mask; tab->vt_slotv[i].vs_vn; i = (i + 1) & tab->vt_mask)
+        continue;
+
+    tab->vt_slotv[i].vs_hash = hash;
+    __atomic_store_n(&tab->vt_slotv[i].vs_vn, vn, __ATOMIC_RELEASE);
+}
+
+/* Make room for one more entry in the given index (whose entry count
+ * is *cntp), keeping its load factor at or below 3/4.  Returns false
+ * if the index needs to grow but cannot.
+ */
+static bool
+nct_vntab_reserve(nct_vncache_t *vc, nct_vntab_t **tabp, size_t *cntp)
+{
+    nct_vntab_t *tab = *tabp;
+    nct_vntab_t *ntab;
+    nct_vn_t *vn;
+    size_t i;
+
+    if ((*cntp + 1) * 4 <= (tab->vt_mask + 1) * 3)
+        return true;
+
+    ntab = nct_vntab_alloc((tab->vt_mask + 1) * 2);
+    if (!ntab)
+        return false;
+
+    for (i = 0; i <= tab->vt_mask; ++i) {
+        vn = tab->vt_slotv[i].vs_vn;
+        if (vn)
+            nct_vntab_put(ntab, vn, tab->vt_slotv[i].vs_hash);
+    }
+
+    ntab->vt_next = tab;
+    vc->vc_bytes += sizeof(ntab->vt_slotv[0]) * (ntab->vt_mask + 1);
+    __atomic_store_n(tabp, ntab, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/* Allocate len bytes for a vnode from the current chunk.
+ */
+static void *
+nct_vncache_alloc(nct_vncache_t *vc, size_t len)
+{
+    void **chunk;
+    void *p;
+
+    len = (len + __alignof(nct_vn_t) - 1) & ~(__alignof(nct_vn_t) - 1);
+
+    if (!vc->vc_chunk || vc->vc_chunkoff + len > NCT_VN_CHUNKSZ) {
+        chunk = malloc(NCT_VN_CHUNKSZ);
+        if (!chunk)
+            return NULL;
+
+        *chunk = vc->vc_chunks;
+        vc->vc_chunks = chunk;
+        vc->vc_chunk = (char *)chunk;
+        vc->vc_chunkoff = sizeof(nct_vn_t *);
+        vc->vc_bytes += NCT_VN_CHUNKSZ;
+    }
+
+    p = vc->vc_chunk + vc->vc_chunkoff;
+    vc->vc_chunkoff += len;
+
+    return p;
+}
+
+nct_vncache_t *
+nct_vncache_create(void)
+{
+    nct_vncache_t *vc;
+
+    vc = calloc(1, sizeof(*vc));
+    if (!vc)
+        return NULL;
+
+    vc->vc_nametab = nct_vntab_alloc(NCT_VNTAB_MIN);
+    vc->vc_fhtab = nct_vntab_alloc(NCT_VNTAB_MIN);
+    if (!vc->vc_nametab || !vc->vc_fhtab) {
+        free(vc->vc_nametab);
+        free(vc->vc_fhtab);
+        free(vc);
+        return NULL;
+    }
+
+    vc->vc_bytes = sizeof(vc->vc_nametab->vt_slotv[0]) * NCT_VNTAB_MIN * 2;
+    pthread_mutex_init(&vc->vc_mtx, NULL);
+
+    return vc;
+}
+
+void
+nct_vncache_destroy(nct_vncache_t *vc)
+{
+    nct_vntab_t *tab;
+    void **chunk;
+
+    if (!vc)
+        return;
+
+    while ((tab = vc->vc_nametab)) {
+        vc->vc_nametab = tab->vt_next;
+        free(tab);
+    }
+
+    while ((tab = vc->vc_fhtab)) {
+        vc->vc_fhtab = tab->vt_next;
+        free(tab);
+    }
+
+    while ((chunk = vc->vc_chunks)) {
+        vc->vc_chunks = *chunk;
+        free(chunk);
+    }
+
+    pthread_mutex_destroy(&vc->vc_mtx);
+    free(vc);
+}
+
+/* Return the vnode for name in directory dvn (NULL for the root of the
+ * mount), or NULL if it is not cached.
+ */
+nct_vn_t *
+nct_vn_lookup(nct_vncache_t *vc, const nct_vn_t *dvn, const char *name)
+{
+    size_t namelen = strlen(name);
+    uint32_t hash = nct_vn_namehash(dvn, name, namelen);
+    nct_vntab_t *tab;
+    nct_vn_t *vn;
+    size_t i;
+
+    tab = __atomic_load_n(&vc->vc_nametab, __ATOMIC_ACQUIRE);
+
+    for (i = hash & tab->vt_mask;
+         (vn = __atomic_load_n(&tab->vt_slotv[i].vs_vn, __ATOMIC_ACQUIRE));
+         i = (i + 1) & tab->vt_mask) {
+        if (tab->vt_slotv[i].vs_hash == hash && vn->xvn_parent == dvn &&
+            vn->xvn_namelen == namelen && 0 == memcmp(vn->xvn_name, name, namelen))
+            return vn;
+    }
+
+    return NULL;
+}
+
+/* Return the vnode with the given file handle, or NULL if it is not
+ * cached.
+ */
 nct_vn_t *
-nct_vn_alloc(const fhandle3 *fh, const char *name, int namelen)
+nct_vn_find(nct_vncache_t *vc, const fhandle3 *fh)
 {
-    nct_vn_t *xvn;
-
-    xvn = malloc(sizeof(*xvn) + namelen + 1);
-    if (xvn) {
-        xvn->xvn_parent = NULL;
-        xvn->xvn_fh = *fh;
-        xvn->xvn_namelen = namelen;
-        memcpy(xvn->xvn_name, name, namelen + 1);
+    uint32_t hash = nct_vn_hash(0, fh->fhandle3_val, fh->fhandle3_len);
+    nct_vntab_t *tab;
+    fhandle3 vnfh;
+    nct_vn_t *vn;
+    size_t i;
+
+    tab = __atomic_load_n(&vc->vc_fhtab, __ATOMIC_ACQUIRE);
+
+    for (i = hash & tab->vt_mask;
+         (vn = __atomic_load_n(&tab->vt_slotv[i].vs_vn, __ATOMIC_ACQUIRE));
+         i = (i + 1) & tab->vt_mask) {
+        if (tab->vt_slotv[i].vs_hash != hash || vn->xvn_fhlen != fh->fhandle3_len)
+            continue;
+
+        nct_vn_fh(vn, &vnfh);
+        if (0 == memcmp(vnfh.fhandle3_val, fh->fhandle3_val, fh->fhandle3_len))
+            return vn;
     }
 
-    return xvn;
+    return NULL;
 }
 
+/* Retain the attributes of interest (attr may be NULL).
+ */
 void
-nct_vn_free(nct_vn_t *xvn)
+nct_vn_setattr(nct_vn_t *vn, const fattr3 *attr)
 {
-    free(xvn);
+    if (attr) {
+        vn->xvn_fileid = attr->fileid;
+        vn->xvn_size = attr->size;
+        vn->xvn_type = attr->type;
+    }
 }
 
+/* Insert a vnode for name in directory dvn (NULL for the root of the
+ * mount) with the given file handle and attributes (attr may be NULL),
+ * and return it.  If name is already cached in dvn the existing vnode
+ * is returned instead, with its attributes updated.  A file handle
+ * that is already cached (e.g., another link to the same file) is
+ * indexed by the vnode inserted first.  Returns NULL if the name or
+ * file handle is too long, or if out of memory.
+ */
+nct_vn_t *
+nct_vn_insert(nct_vncache_t *vc, nct_vn_t *dvn, const char *name,
+              const fhandle3 *fh, const fattr3 *attr)
+{
+    size_t namelen = strlen(name);
+    uint32_t namehash, fhhash;
+    nct_vn_t *vn;
+
+    if (namelen > UINT8_MAX || fh->fhandle3_len > NFS3_FHSIZE)
+        return NULL;
+
+    namehash = nct_vn_namehash(dvn, name, namelen);
+    fhhash = nct_vn_hash(0, fh->fhandle3_val, fh->fhandle3_len);
+
+    pthread_mutex_lock(&vc->vc_mtx);
+    vn = nct_vn_lookup(vc, dvn, name);
+    if (vn) {
+        nct_vn_setattr(vn, attr);
+        goto out;
+    }
+
+    if (!nct_vntab_reserve(vc, &vc->vc_nametab, &vc->vc_namecnt) ||
+        !nct_vntab_reserve(vc, &vc->vc_fhtab, &vc->vc_fhcnt))
+        goto out;
+
+    vn = nct_vncache_alloc(vc, offsetof(nct_vn_t, xvn_name) + namelen + 1 + fh->fhandle3_len);
+    if (!vn)
+        goto out;
+
+    vn->xvn_parent = dvn;
+    vn->xvn_fileid = 0;
+    vn->xvn_size = 0;
+    vn->xvn_type = 0;
+    vn->xvn_namelen = namelen;
+    vn->xvn_fhlen = fh->fhandle3_len;
+    memcpy(vn->xvn_name, name, namelen + 1);
+    memcpy(vn->xvn_name + namelen + 1, fh->fhandle3_val, fh->fhandle3_len);
+    nct_vn_setattr(vn, attr);
+
+    nct_vntab_put(vc->vc_nametab, vn, namehash);
+    ++vc->vc_namecnt;
+
+    if (!nct_vn_find(vc, fh)) {
+        nct_vntab_put(vc->vc_fhtab, vn, fhhash);
+        ++vc->vc_fhcnt;
+    }
+
+  out:
+    pthread_mutex_unlock(&vc->vc_mtx);
+
+    return vn;
+}
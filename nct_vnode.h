@@ -27,15 +27,70 @@
 #ifndef NCT_VNODE_H
 #define NCT_VNODE_H
 
+/* A vnode holds the file handle and name of a node inline, along with
+ * just the attributes the tests need.  Vnodes live in a vnode cache
+ * until it is destroyed, so they may be referenced without holding any
+ * lock, and each takes 32 bytes plus its name and file handle (rounded
+ * up to a multiple of 8 bytes), plus a slot in each of the cache's two
+ * indexes.
+ */
 typedef struct nct_vn_s {
-    struct nct_vn_s    *xvn_parent;
-    fhandle3            xvn_fh;
-    fattr3              xvn_fattr;
-    int                 xvn_namelen;
-    char                xvn_name[];
+    struct nct_vn_s    *xvn_parent;             // NULL for the root of the mount
+    uint64_t            xvn_fileid;
+    uint64_t            xvn_size;
+    uint8_t             xvn_type;               // ftype3 (zero if unknown)
+    uint8_t             xvn_namelen;
+    uint8_t             xvn_fhlen;
+    char                xvn_name[];             // Followed by the file handle
 } nct_vn_t;
 
-extern nct_vn_t *nct_vn_alloc(const fhandle3 *fh, const char *name, int namelen);
-extern void nct_vn_free(nct_vn_t *xvn);
+/* An open-addressed (linear probing) table of vnode pointers, each with
+ * the hash of its vnode alongside so that a probe touches just the one
+ * cache line unless the hash matches.  A table that grows is replaced
+ * rather than rehashed in place, and the old one is retained until the
+ * cache is destroyed, so that concurrent lookups always see a consistent
+ * (if possibly stale) table.
+ */
+typedef struct {
+    nct_vn_t           *vs_vn;
+    uint32_t            vs_hash;
+} nct_vnslot_t;
+
+typedef struct nct_vntab_s {
+    struct nct_vntab_s *vt_next;                // Retired tables
+    size_t              vt_mask;                // Number of slots - 1
+    nct_vnslot_t        vt_slotv[];
+} nct_vntab_t;
+
+/* The vnode cache indexes vnodes by (parent, name) and by file handle.
+ * Lookups take no locks, while insertions are serialized by vc_mtx.
+ * Vnodes are carved out of large chunks and never freed individually.
+ */
+typedef struct {
+    nct_vntab_t        *vc_nametab;             // Index by (parent, name)
+    nct_vntab_t        *vc_fhtab;               // Index by file handle
+    size_t              vc_namecnt;             // Entries in vc_nametab
+    size_t              vc_fhcnt;               // Entries in vc_fhtab
+    size_t              vc_bytes;               // Memory in use (incl. indexes)
+    pthread_mutex_t     vc_mtx;
+    char               *vc_chunk;               // Current chunk
+    size_t              vc_chunkoff;            // Offset of its free space
+    void               *vc_chunks;              // List of all chunks
+} nct_vncache_t;
+
+static inline void
+nct_vn_fh(const nct_vn_t *vn, fhandle3 *fh)
+{
+    fh->fhandle3_len = vn->xvn_fhlen;
+    fh->fhandle3_val = (char *)vn->xvn_name + vn->xvn_namelen + 1;
+}
+
+extern nct_vncache_t *nct_vncache_create(void);
+extern void nct_vncache_destroy(nct_vncache_t *vc);
+extern nct_vn_t *nct_vn_lookup(nct_vncache_t *vc, const nct_vn_t *dvn, const char *name);
+extern nct_vn_t *nct_vn_find(nct_vncache_t *vc, const fhandle3 *fh);
+extern nct_vn_t *nct_vn_insert(nct_vncache_t *vc, nct_vn_t *dvn, const char *name,
+                               const fhandle3 *fh, const fattr3 *attr);
+extern void nct_vn_setattr(nct_vn_t *vn, const fattr3 *attr);
 
 #endif // NCT_VNODE_H
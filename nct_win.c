@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <rpc/types.h>
+#include <rpc/auth.h>
+#include <rpc/rpc.h>
+
+#include "main.h"
+#include "nct.h"
+#include "nct_win.h"
+
+/* Park the given (encoded) request if the window is full, in which case
+ * its job becomes inactive.  Returns false if the caller should send
+ * the request.
+ */
+bool
+nct_win_park(nct_win_t *win, nct_req_t *req)
+{
+    nct_req_t *head;
+    u_int active;
+
+    active = __atomic_load_n(&win->win_active, __ATOMIC_RELAXED);
+
+    while (1) {
+        if (active <= __atomic_load_n(&win->win_size, __ATOMIC_RELAXED))
+            return false;
+
+        if (__atomic_compare_exchange_n(&win->win_active, &active, active - 1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+
+    head = __atomic_load_n(&win->win_head, __ATOMIC_RELAXED);
+    do {
+        req->req_next = head;
+    } while (!__atomic_compare_exchange_n(&win->win_head, &head, req, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return true;
+}
+
+/* Release the window slot of an active job that has retired (e.g., due
+ * to an RPC or NFS error), lest the window admit one job fewer for the
+ * rest of the run.
+ */
+void
+nct_win_exit(nct_win_t *win)
+{
+    __atomic_sub_fetch(&win->win_active, 1, __ATOMIC_RELAXED);
+}
+
+/* Take all the parked requests.  Only the stats thread takes requests
+ * off win_head, so it may push back those it doesn't use.
+ */
+static nct_req_t *
+nct_win_take(nct_win_t *win)
+{
+    return __atomic_exchange_n(&win->win_head, NULL, __ATOMIC_ACQUIRE);
+}
+
+static void
+nct_win_untake(nct_win_t *win, nct_req_t *req)
+{
+    nct_req_t *next, *head;
+
+    for (; req; req = next) {
+        next = req->req_next;
+
+        head = __atomic_load_n(&win->win_head, __ATOMIC_RELAXED);
+        do {
+            req->req_next = head;
+        } while (!__atomic_compare_exchange_n(&win->win_head, &head, req, true,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+}
+
+/* Called by the stats thread once per sample with the merged latency
+ * histogram of all the recv threads.  Adjusts the window once enough
+ * requests have completed since the last decision, and sends parked
+ * requests while the window has room for them.  Once the run is over
+ * the jobs of all parked requests are retired instead.
+ */
+void
+nct_win_update(nct_win_t *win, const nct_hist_t *hist)
+{
+    uint64_t now, cnt, p99;
+    nct_req_t *req;
+    u_int size;
+
+    now = rdtsc();
+
+    if (now >= win->win_tsc_end) {
+        nct_req_t *next;
+
+        for (req = nct_win_take(win); req; req = next) {
+            next = req->req_next;
+            nct_req_exit(req);
+        }
+        return;
+    }
+
+    cnt = nct_hist_count(hist, &win->win_base);
+    if (cnt == 0)
+        return;
+
+    if (cnt < NCT_WIN_MIN_REQS && now - win->win_tsc_last < tsc_freq)
+        return;
+
+    p99 = nct_hist_pct(hist, &win->win_base, 99);
+    size = win->win_size;
+
+    ++win->win_periods;
+    if (p99 <= win->win_target) {
+        ++win->win_periods_ok;
+        win->win_ok_reqs += cnt;
+        win->win_ok_tsc += now - win->win_tsc_last;
+    }
+
+    if (now - win->win_tsc_begin >= (win->win_tsc_end - win->win_tsc_begin) / 2) {
+        win->win_size_cum += size;
+        ++win->win_size_cnt;
+    }
+
+    if (p99 > win->win_target) {
+        win->win_slowstart = false;
+        size -= (size > 4) ? size / 4 : 1;
+    }
+    else {
+        size += win->win_slowstart ? size : 1;
+    }
+
+    if (size < 1)
+        size = 1;
+    else if (size > win->win_max)
+        size = win->win_max;
+
+    dprint(2, "p99 %lu cnt %lu window %u -> %u\n", p99, cnt, win->win_size, size);
+
+    __atomic_store_n(&win->win_size, size, __ATOMIC_RELAXED);
+    win->win_p99 = p99;
+    win->win_tsc_last = now;
+    win->win_base = *hist;
+
+    if (__atomic_load_n(&win->win_active, __ATOMIC_RELAXED) >= size)
+        return;
+
+    req = nct_win_take(win);
+
+    while (req && __atomic_load_n(&win->win_active, __ATOMIC_RELAXED) < size) {
+        nct_req_t *next = req->req_next;
+
+        __atomic_add_fetch(&win->win_active, 1, __ATOMIC_RELAXED);
+
+        req->req_tsc_start = rdtsc();
+        nct_req_send(req);
+        req = next;
+    }
+
+    nct_win_untake(win, req);
+}
+
+/* Print the outcome of the run, namely the window to which the controller
+ * converged (i.e., the mean window over the second half of the run) and
+ * the throughput sustained during the periods that met the target.
+ */
+void
+nct_win_report(nct_win_t *win)
+{
+    double window, ops;
+
+    window = win->win_size_cnt ? (double)win->win_size_cum / win->win_size_cnt : win->win_size;
+    ops = win->win_ok_tsc ? (win->win_ok_reqs * (double)tsc_freq) / win->win_ok_tsc : 0;
+
+    printf("\nadaptive window: p99 latency target %.1lf usecs\n",
+           (win->win_target * 1000000.0) / tsc_freq);
+    printf("%12.1lf  converged window (final %u, max %u)\n",
+           window, win->win_size, win->win_max);
+    printf("%12.1lf  requests per second at the target (%u of %u periods met it)\n",
+           ops, win->win_periods_ok, win->win_periods);
+
+    if (win->win_periods_ok == 0) {
+        eprint("the p99 latency target of %.1lf usecs was never met\n",
+               (win->win_target * 1000000.0) / tsc_freq);
+    }
+    else if (window + 1 > win->win_max) {
+        eprint("the window was limited by the number of jobs (%u), use -j to allow more\n",
+               win->win_max);
+    }
+}
+
+nct_win_t *
+nct_win_create(nct_mnt_t *mnt, u_int target_usecs, u_int jobs, long duration)
+{
+    nct_win_t *win;
+
+    win = aligned_alloc(64, sizeof(*win));
+    if (!win)
+        abort();
+
+    memset(win, 0, sizeof(*win));
+    win->win_mnt = mnt;
+    win->win_target = ((uint64_t)target_usecs * tsc_freq) / 1000000;
+    win->win_max = jobs;
+    win->win_active = jobs;
+    win->win_size = 1;
+    win->win_slowstart = true;
+
+    win->win_tsc_begin = win->win_tsc_last = rdtsc();
+    win->win_tsc_end = win->win_tsc_begin + tsc_freq * duration;
+
+    nct_mnt_hist(mnt, -1, &win->win_base);
+
+    return win;
+}
+
+void
+nct_win_destroy(nct_win_t *win)
+{
+    free(win);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef NCT_WIN_H
+#define NCT_WIN_H
+
+struct nct_mnt_s;
+struct nct_req;
+
+/* Min number of completions from which the window controller computes
+ * a p99 latency (it decides at least once per second regardless).
+ */
+#define NCT_WIN_MIN_REQS    (200)
+
+/* The window controller limits the number of jobs with a request in
+ * flight to win_size, which it adjusts once per decision period so
+ * as to keep the p99 latency of the period below win_target.  Like TCP
+ * it doubles the window until the first period that misses the target
+ * (slow start), after which it grows the window by one per period that
+ * meets the target and shrinks it by a quarter per period that misses.
+ *
+ * A job whose request completes while the window is full parks its
+ * next (encoded) request on win_head, from which the controller sends
+ * parked requests as the window opens up.
+ */
+typedef struct nct_win_s {
+    __aligned(64)
+    struct nct_req     *win_head;               // Parked requests, newest first
+    u_int               win_active;             // Jobs not parked (atomic)
+    u_int               win_size;               // Max active jobs (atomic)
+
+    __aligned(64)
+    struct nct_mnt_s   *win_mnt;
+    uint64_t            win_target;             // p99 latency target (in cycles)
+    u_int               win_max;                // Max window (i.e., jobs)
+    bool                win_slowstart;
+    uint64_t            win_tsc_begin;
+    uint64_t            win_tsc_end;
+    uint64_t            win_tsc_last;           // Time of the last decision
+    uint64_t            win_p99;                // p99 latency of the last period
+
+    /* Outcome of the decision periods.
+     */
+    u_int               win_periods;
+    u_int               win_periods_ok;         // Periods that met the target
+    uint64_t            win_ok_reqs;            // Requests completed therein
+    uint64_t            win_ok_tsc;             // Duration thereof
+    uint64_t            win_size_cum;           // Sum of windows in 2nd half of run
+    u_int               win_size_cnt;
+
+    nct_hist_t          win_base;               // Histogram at the last decision
+} nct_win_t;
+
+extern nct_win_t *nct_win_create(struct nct_mnt_s *mnt, u_int target_usecs,
+                                 u_int jobs, long duration);
+extern void nct_win_destroy(nct_win_t *win);
+extern bool nct_win_park(nct_win_t *win, struct nct_req *req);
+extern void nct_win_exit(nct_win_t *win);
+extern void nct_win_update(nct_win_t *win, const nct_hist_t *hist);
+extern void nct_win_report(nct_win_t *win);
+
+#endif // NCT_WIN_H
@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2015-2017,2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sysexits.h>
+
+#include <rpc/types.h>
+#include <rpc/auth.h>
+#include <rpc/rpc.h>
+
+#include "clp.h"
+#include "main.h"
+#include "nct.h"
+#include "nct_nfs.h"
+#include "nct_xdr.h"
+#include "nct_mount.h"
+#include "nct_write.h"
+
+/* Writes are issued at increasing logical positions, each of which maps
+ * to the file offset (position % pw_span).  Positions below pw_stable
+ * are known to be committed under the current verifier (pw_verf), so
+ * when the server's verifier changes (e.g., because it rebooted) the
+ * next position is rewound to pw_stable and the uncommitted writes are
+ * thereby resent.  Each verifier change starts a new epoch, and replies
+ * to calls issued in an earlier epoch are ignored.
+ */
+typedef struct {
+    volatile uint64_t   wj_pos;             // Position of the write in flight
+    volatile u_int      wj_epoch;           // Epoch in which it was issued
+} test_write_job_t;
+
+typedef struct {
+    volatile uint64_t   pw_pos;             // Next position to write
+    uint64_t            pw_span;            // Wrap offsets at this size
+    size_t              pw_length;
+    stable_how          pw_stable_how;
+    int                 pw_duration;
+    const char         *pw_data;            // Payload of every write
+
+    pthread_mutex_t     pw_mtx;             // Serializes verifier changes
+    volatile u_int      pw_epoch;           // Incremented on verifier change
+    volatile bool       pw_verf_valid;      // pw_verf is known
+    volatile uint64_t   pw_verf;            // Most recent write verifier
+    volatile uint64_t   pw_stable;          // Positions committed below this
+
+    size_t              pw_commit_bytes;    // Commit every this many bytes
+    uint64_t            pw_commit_cycles;   // ... or this many cycles
+    volatile uint64_t   pw_uncommitted;     // Bytes written since last commit
+    volatile uint64_t   pw_commit_tsc;      // Time of last commit
+    volatile bool       pw_committing;      // A commit is in flight
+    uint64_t            pw_commit_pos;      // ... covering positions below this
+    u_int               pw_commit_epoch;    // ... issued in this epoch
+
+    test_write_job_t   *pw_jobv;
+    u_int               pw_jobc;
+} test_write_priv_t;
+
+static size_t length = 4096;
+static char *rhostpath;
+static char *stablestr = "unstable";
+static u_long commit_bytes;
+static u_long commit_msecs;
+static u_long span;
+
+static struct clp_posparam posparamv[] = {
+    CLP_POSPARAM("rhostpath", string, rhostpath, NULL, NULL, "[user@]rhost:path"),
+    CLP_POSPARAM("[length]", u_long, length, NULL, NULL, "write length (bytes)"),
+    CLP_POSPARAM_END
+};
+
+static struct clp_option optionv[] = {
+    CLP_OPTION('b', u_long, commit_bytes, NULL, "commit after every given number of bytes written"),
+    CLP_OPTION('m', u_long, commit_msecs, NULL, "commit at most every given number of milliseconds"),
+    CLP_OPTION('s', string, stablestr, NULL, "stability of writes (unstable, datasync, filesync)"),
+    CLP_OPTION('z', u_long, span, NULL, "wrap offsets at the given size (default: file size)"),
+    CLP_OPTION_VERBOSITY(verbosity),
+    CLP_OPTION_HELP,
+    CLP_OPTION_END
+};
+
+static int test_write_start(struct nct_req *req);
+static int test_write_cb(struct nct_req *req);
+
+static bool
+given(int c)
+{
+    return !!clp_given(c, optionv, NULL);
+}
+
+void *
+test_write_init(int argc, char **argv, int duration, start_t **startp,
+                char **rhostpathp, size_t *msgszp)
+{
+    test_write_priv_t *priv;
+    int rc;
+
+    rc = clp_parsev(argc, argv, optionv, posparamv);
+    if (rc) {
+        exit(rc);
+    }
+
+    if (given('h') || given('V'))
+        exit(0);
+
+    argc -= optind;
+    argv += optind;
+
+    priv = calloc(1, sizeof(*priv));
+    if (!priv) {
+        abort();
+    }
+
+    priv->pw_length = length;
+    priv->pw_span = span;
+    priv->pw_duration = duration;
+    priv->pw_commit_bytes = commit_bytes;
+    priv->pw_commit_cycles = (tsc_freq * commit_msecs) / 1000;
+    pthread_mutex_init(&priv->pw_mtx, NULL);
+
+    if (0 == strcmp(stablestr, "unstable")) {
+        priv->pw_stable_how = UNSTABLE;
+    } else if (0 == strcmp(stablestr, "datasync")) {
+        priv->pw_stable_how = DATA_SYNC;
+    } else if (0 == strcmp(stablestr, "filesync")) {
+        priv->pw_stable_how = FILE_SYNC;
+    } else {
+        eprint("invalid stability %s, use unstable, datasync or filesync\n", stablestr);
+        exit(EX_USAGE);
+    }
+
+    if (priv->pw_length < 512 || priv->pw_length > NCT_MSGSZ_MAX - NCT_MSGSZ_MIN) {
+        eprint("invalid write length %zu\n", priv->pw_length);
+        abort();
+    }
+
+    if ((commit_bytes || commit_msecs) && priv->pw_stable_how != UNSTABLE) {
+        eprint("-b and -m apply only to unstable writes\n");
+        exit(EX_USAGE);
+    }
+
+    priv->pw_data = nct_req_pattern(priv->pw_length);
+
+    /* The payload is sent in place, and the reply is small, so message
+     * buffers need only hold the headers.
+     */
+    *msgszp = NCT_MSGSZ_MIN;
+
+    *startp = test_write_start;
+    *rhostpathp = rhostpath;
+
+    return priv;
+}
+
+void
+test_write_fini(void *arg)
+{
+    test_write_priv_t *priv = arg;
+
+    nct_req_pattern_free(priv->pw_data, priv->pw_length);
+    pthread_mutex_destroy(&priv->pw_mtx);
+    free(priv->pw_jobv);
+    free(priv);
+}
+
+/* Check the verifier of a reply to an unstable write or commit issued
+ * in the given epoch.  Returns false if the verifier changed, in which
+ * case all writes since the last successful commit will be resent.
+ * A reply with a different verifier to a call issued in an earlier
+ * epoch is merely ignored, as its data is being resent anyway.
+ */
+static bool
+test_write_verf(test_write_priv_t *priv, const writeverf3 verf, u_int epoch)
+{
+    uint64_t v = nct_xdr_ld64(verf);
+    bool valid = true;
+
+    if (__atomic_load_n(&priv->pw_verf_valid, __ATOMIC_ACQUIRE) && v == priv->pw_verf)
+        return true;
+
+    pthread_mutex_lock(&priv->pw_mtx);
+    if (epoch != priv->pw_epoch) {
+        valid = false;
+    }
+    else {
+        if (!priv->pw_verf_valid) {
+            priv->pw_verf = v;
+            __atomic_store_n(&priv->pw_verf_valid, true, __ATOMIC_RELEASE);
+        }
+        else if (v != priv->pw_verf) {
+            dprint(1, "write verifier changed (%lx -> %lx), resending from offset %lu\n",
+                   priv->pw_verf, v, priv->pw_stable % priv->pw_span);
+
+            priv->pw_verf = v;
+            __atomic_store_n(&priv->pw_pos, priv->pw_stable, __ATOMIC_SEQ_CST);
+            __atomic_add_fetch(&priv->pw_epoch, 1, __ATOMIC_SEQ_CST);
+            valid = false;
+        }
+    }
+    pthread_mutex_unlock(&priv->pw_mtx);
+
+    return valid;
+}
+
+/* Encode a write at the next position.  The job's slot is updated
+ * before the position is claimed so that test_write_commit() never
+ * misses a write in flight.
+ */
+static void
+test_write_encode(struct nct_req *req)
+{
+    test_write_priv_t *priv = req->req_priv;
+    test_write_job_t *job = priv->pw_jobv + req->req_job;
+    uint64_t pos;
+
+    job->wj_epoch = __atomic_load_n(&priv->pw_epoch, __ATOMIC_SEQ_CST);
+
+    pos = __atomic_load_n(&priv->pw_pos, __ATOMIC_SEQ_CST);
+    do {
+        __atomic_store_n(&job->wj_pos, pos, __ATOMIC_SEQ_CST);
+    } while (!__atomic_compare_exchange_n(&priv->pw_pos, &pos, pos + priv->pw_length,
+                                          false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    nct_nfs_write3_encode(req, pos % priv->pw_span, priv->pw_length,
+                          priv->pw_stable_how, priv->pw_data);
+}
+
+/* Encode a commit if one is due and none is in flight.  The commit
+ * covers every position below the lowest one still in flight (any of
+ * which might not yet have reached the server), and it is only
+ * trusted if no verifier change intervenes.
+ */
+static bool
+test_write_commit(struct nct_req *req)
+{
+    test_write_priv_t *priv = req->req_priv;
+    uint64_t now, pos, jpos;
+    u_int i;
+
+    if (priv->pw_uncommitted == 0)
+        return false;
+
+    now = rdtsc();
+
+    if (!(priv->pw_commit_bytes && priv->pw_uncommitted >= priv->pw_commit_bytes) &&
+        !(priv->pw_commit_cycles && now - priv->pw_commit_tsc >= priv->pw_commit_cycles))
+        return false;
+
+    if (!__sync_bool_compare_and_swap(&priv->pw_committing, false, true))
+        return false;
+
+    priv->pw_commit_epoch = __atomic_load_n(&priv->pw_epoch, __ATOMIC_SEQ_CST);
+    pos = __atomic_load_n(&priv->pw_pos, __ATOMIC_SEQ_CST);
+
+    for (i = 0; i < priv->pw_jobc; ++i) {
+        jpos = __atomic_load_n(&priv->pw_jobv[i].wj_pos, __ATOMIC_SEQ_CST);
+        if (jpos < pos)
+            pos = jpos;
+    }
+
+    priv->pw_commit_pos = pos;
+    priv->pw_commit_tsc = now;
+    __atomic_store_n(&priv->pw_uncommitted, 0, __ATOMIC_SEQ_CST);
+
+    nct_nfs_commit3_encode(req);
+
+    return true;
+}
+
+static int
+test_write_commit_done(struct nct_req *req)
+{
+    test_write_priv_t *priv = req->req_priv;
+    nct_msg_t *msg = req->req_msg;
+    commit3_res res;
+    nct_xbuf_t xb;
+    int rc = 0;
+
+    nct_msg_results(msg, &xb, NULL, 0);
+
+    if (!nct_xdr_decode_commit3_res(&xb, &res)) {
+        eprint("commit reply truncated: len=%zu\n", msg->msg_len);
+        rc = EPROTO;
+        goto out;
+    }
+
+    if (res.status != NFS3_OK) {
+        eprint("commit nfs failed: nfsstat3=%d %s\n",
+               res.status, strerror_nfsstat3(res.status));
+        rc = res.status;
+        goto out;
+    }
+
+    if (test_write_verf(priv, res.u.resok.verf, priv->pw_commit_epoch)) {
+        pthread_mutex_lock(&priv->pw_mtx);
+        if (priv->pw_commit_epoch == priv->pw_epoch)
+            priv->pw_stable = priv->pw_commit_pos;
+        pthread_mutex_unlock(&priv->pw_mtx);
+    }
+
+  out:
+    __atomic_store_n(&priv->pw_committing, false, __ATOMIC_SEQ_CST);
+
+    return rc;
+}
+
+static int
+test_write_done(struct nct_req *req)
+{
+    test_write_priv_t *priv = req->req_priv;
+    test_write_job_t *job = priv->pw_jobv + req->req_job;
+    nct_msg_t *msg = req->req_msg;
+    write3_res res;
+    nct_xbuf_t xb;
+
+    nct_msg_results(msg, &xb, NULL, 0);
+
+    if (!nct_xdr_decode_write3_res(&xb, &res)) {
+        eprint("write reply truncated: len=%zu\n", msg->msg_len);
+        return EPROTO;
+    }
+
+    if (res.status != NFS3_OK) {
+        eprint("write nfs failed: nfsstat3=%d %s\n",
+               res.status, strerror_nfsstat3(res.status));
+        return res.status;
+    }
+
+    if (res.u.resok.count != priv->pw_length) {
+        eprint("short write: count=%u length=%zu\n",
+               res.u.resok.count, priv->pw_length);
+        return EIO;
+    }
+
+    /* Only writes of the current epoch count toward the next commit,
+     * lest the replies to writes issued before a rewind trigger early
+     * commits.
+     */
+    if (res.u.resok.committed == UNSTABLE) {
+        if (test_write_verf(priv, res.u.resok.verf, job->wj_epoch) &&
+            job->wj_epoch == __atomic_load_n(&priv->pw_epoch, __ATOMIC_SEQ_CST))
+            __atomic_add_fetch(&priv->pw_uncommitted, priv->pw_length, __ATOMIC_SEQ_CST);
+    }
+
+    __atomic_store_n(&job->wj_pos, UINT64_MAX, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+static int
+test_write_cb(struct nct_req *req)
+{
+    test_write_priv_t *priv = req->req_priv;
+    nct_msg_t *msg = req->req_msg;
+    enum clnt_stat stat;
+    int rc;
+
+    stat = msg->msg_stat;
+    if (stat != RPC_SUCCESS) {
+        eprint("%s failed: %d %s\n", nct_nfs_procname(req->req_proc),
+               stat, clnt_sperrno(stat));
+        nct_req_free(req);
+        return stat;
+    }
+
+    if (req->req_proc == NFS3_COMMIT)
+        rc = test_write_commit_done(req);
+    else
+        rc = test_write_done(req);
+
+    if (rc) {
+        nct_req_free(req);
+        return rc;
+    }
+
+    if (req->req_tsc_stop >= req->req_tsc_finish) {
+        nct_req_free(req);
+        return ETIMEDOUT;
+    }
+
+    if (priv->pw_stable_how != UNSTABLE || !test_write_commit(req))
+        test_write_encode(req);
+
+    nct_req_issue(req);
+
+    return 0;
+}
+
+static int
+test_write_start(struct nct_req *req)
+{
+    test_write_priv_t *priv = req->req_priv;
+    nct_mnt_t *mnt = req->req_mnt;
+    u_int i;
+
+    req->req_tsc_finish = rdtsc() + (tsc_freq * priv->pw_duration);
+    req->req_cb = test_write_cb;
+
+    /* Jobs are started one at a time, so the first one sets up the
+     * state shared by all.
+     */
+    if (!priv->pw_jobv) {
+        /* A commit applies to the file of the job that sends it, while
+         * the commit position covers the writes to all the targets.
+         */
+        if ((priv->pw_commit_bytes || priv->pw_commit_cycles) && mnt->mnt_vnc > 1) {
+            eprint("-b and -m require a single target file\n");
+            exit(EX_USAGE);
+        }
+
+        priv->pw_jobv = malloc(sizeof(*priv->pw_jobv) * req->req_jobs);
+        if (!priv->pw_jobv) {
+            abort();
+        }
+
+        priv->pw_jobc = req->req_jobs;
+        for (i = 0; i < priv->pw_jobc; ++i) {
+            priv->pw_jobv[i].wj_pos = UINT64_MAX;
+            priv->pw_jobv[i].wj_epoch = 0;
+        }
+
+        if (priv->pw_span == 0)
+            priv->pw_span = nct_mnt_size(mnt);
+        priv->pw_span -= priv->pw_span % priv->pw_length;
+
+        if (mnt->mnt_wtmax > 0 && priv->pw_length > mnt->mnt_wtmax) {
+            eprint("write length %zu exceeds the server's wtmax %u, writes will be short\n",
+                   priv->pw_length, mnt->mnt_wtmax);
+        }
+
+        priv->pw_commit_tsc = rdtsc();
+    }
+
+    if (priv->pw_span == 0) {
+        eprint("file smaller than request length: size=%lu length=%zu (see -z)\n",
+               nct_mnt_size(mnt), priv->pw_length);
+        return EINVAL;
+    }
+
+    usleep(1000);
+
+    test_write_encode(req);
+    nct_req_issue(req);
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ */
+#ifndef NCT_WRITE_H
+#define NCT_WRITE_H
+
+extern void *test_write_init(int argc, char **argv, int duration, start_t **startp,
+                             char **rhostpathp, size_t *msgszp);
+extern void test_write_fini(void *priv);
+
+#endif // NCT_WRITE_H
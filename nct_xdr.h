@@ -42,16 +42,6 @@
 
 #include "nct_rpc.h"
 
-extern int nct_xdr_create(struct rpc_msg *rpc_msg, uint32_t proc, AUTH *auth,
-                           xdrproc_t xdrproc, void *args, char *buf, int bufsz);
-
-extern bool_t nct_xdr_dirpath(XDR *xdrs, char **dirpath);
-
-extern bool_t nct_xdr_mountres3_decode(char *msg, int len, mountres3 *mntres);
-
-extern bool_t nct_xdr_getattr3_encode(XDR *xdr, getattr3_args *args);
-extern bool_t nct_xdr_getattr3_decode(XDR *xdr, getattr3_res *res);
-
-extern bool_t nct_xdr_read3_encode(XDR *xdrs, read3_args *args);
+extern bool_t nct_xdr_read3_res(const char *buf, size_t len, read3_res *res);
 
 #endif /* NCT_XDR_H */
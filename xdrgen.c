@@ -0,0 +1,1841 @@
+/*
+ * Copyright (c) 2019 Greg Becker.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* xdrgen reads an rpcgen-style protocol specification (.x file) and
+ * emits a header with the C types it describes, along with inline
+ * encoders, decoders and size calculators that work directly on a
+ * buffer (see nct_xbuf_t) rather than on libtirpc XDR streams.
+ *
+ * Runs of fields whose encoding has a static size (e.g., all of
+ * fattr3) are bounds-checked once and then accessed at fixed offsets.
+ * Variable-length opaque data is decoded in place (i.e., the decoded
+ * pointer refers to the buffer), while strings, arrays and optional
+ * data are decoded into the caller's scratch heap.
+ *
+ * Supported: const, enum, struct, union (with bool, int or enum
+ * discriminants), typedef, and program (which yields only #defines
+ * for the program, version and procedure numbers).  Not supported:
+ * float, double, quadruple and nested type definitions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sysexits.h>
+
+#define XG_TOKEN_MAX    (128)
+
+typedef enum {
+    XG_VOID,            /* void */
+    XG_PLAIN,           /* type name */
+    XG_FIXED,           /* type name[size] */
+    XG_VAR,             /* type name<size> */
+    XG_OPT,             /* type *name */
+} xg_how_t;
+
+typedef struct {
+    xg_how_t    d_how;
+    char       *d_type;         /* Canonical type name (e.g., "u_int") */
+    char       *d_name;
+    char       *d_size;         /* Array bound, NULL if unbounded */
+} xg_decl_t;
+
+typedef struct {
+    char      **a_casev;
+    int         a_casec;        /* Zero for the default arm */
+    xg_decl_t   a_decl;
+} xg_arm_t;
+
+typedef enum {
+    XG_CONST,
+    XG_ENUM,
+    XG_STRUCT,
+    XG_UNION,
+    XG_TYPEDEF,
+    XG_PROGRAM,
+} xg_kind_t;
+
+typedef struct {
+    xg_kind_t   x_kind;
+    char       *x_name;
+    char       *x_value;        /* XG_CONST */
+    xg_decl_t  *x_declv;        /* Struct fields, typedef or union discriminant */
+    int         x_declc;
+    xg_arm_t   *x_armv;         /* XG_UNION */
+    int         x_armc;
+    char      **x_namev;        /* XG_ENUM and XG_PROGRAM names and values */
+    char      **x_valv;
+    int         x_namec;
+} xg_def_t;
+
+static const char *progname;
+static const char *specpath;
+static int lineno = 1;
+static char *text, *textp;
+static char token[XG_TOKEN_MAX];
+static bool pushed;
+
+static xg_def_t *defv;
+static int defc;
+
+static FILE *out;
+
+static void
+xg_err(const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "%s: %s:%d: ", progname, specpath, lineno);
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    fputc('\n', stderr);
+
+    exit(EX_DATAERR);
+}
+
+static void *
+xg_grow(void *ptr, int cnt, size_t elmsz)
+{
+    ptr = realloc(ptr, (cnt + 1) * elmsz);
+    if (!ptr) {
+        fprintf(stderr, "%s: out of memory\n", progname);
+        exit(EX_OSERR);
+    }
+
+    memset((char *)ptr + cnt * elmsz, 0, elmsz);
+
+    return ptr;
+}
+
+static char *
+xg_strdup(const char *str)
+{
+    char *dup = strdup(str);
+
+    if (!dup) {
+        fprintf(stderr, "%s: out of memory\n", progname);
+        exit(EX_OSERR);
+    }
+
+    return dup;
+}
+
+static void
+emit(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(out, fmt, ap);
+    va_end(ap);
+}
+
+
+/* Lexer.  Tokens are identifiers, numbers and single punctuation
+ * characters.  Comments and rpcgen pass-through lines ('%') are
+ * skipped.  Returns NULL at the end of the spec.
+ */
+static const char *
+xg_next(void)
+{
+    char *start;
+    size_t len;
+
+    if (pushed) {
+        pushed = false;
+        return token;
+    }
+
+    while (*textp) {
+        if (*textp == '\n') {
+            ++lineno;
+            ++textp;
+        }
+        else if (isspace((unsigned char)*textp)) {
+            ++textp;
+        }
+        else if (textp[0] == '/' && textp[1] == '*') {
+            for (textp += 2; *textp && !(textp[0] == '*' && textp[1] == '/'); ++textp) {
+                if (*textp == '\n')
+                    ++lineno;
+            }
+            if (!*textp)
+                xg_err("unterminated comment");
+            textp += 2;
+        }
+        else if (*textp == '%' && (textp == text || textp[-1] == '\n')) {
+            while (*textp && *textp != '\n')
+                ++textp;
+        }
+        else {
+            break;
+        }
+    }
+
+    if (!*textp)
+        return NULL;
+
+    start = textp;
+
+    if (isalnum((unsigned char)*textp) || *textp == '_' || *textp == '-') {
+        ++textp;
+        while (isalnum((unsigned char)*textp) || *textp == '_')
+            ++textp;
+    } else {
+        ++textp;
+    }
+
+    len = textp - start;
+    if (len >= sizeof(token))
+        xg_err("token too long");
+
+    memcpy(token, start, len);
+    token[len] = '\000';
+
+    return token;
+}
+
+static void
+xg_unget(void)
+{
+    pushed = true;
+}
+
+static char *
+xg_ident(void)
+{
+    const char *tok = xg_next();
+
+    if (!tok || !(isalpha((unsigned char)*tok) || *tok == '_'))
+        xg_err("expected an identifier near '%s'", tok ? tok : "EOF");
+
+    return xg_strdup(tok);
+}
+
+static char *
+xg_value(void)
+{
+    const char *tok = xg_next();
+
+    if (!tok || !(isalnum((unsigned char)*tok) || *tok == '_' || *tok == '-'))
+        xg_err("expected a value near '%s'", tok ? tok : "EOF");
+
+    return xg_strdup(tok);
+}
+
+static void
+xg_expect(const char *what)
+{
+    const char *tok = xg_next();
+
+    if (!tok || strcmp(tok, what))
+        xg_err("expected '%s' near '%s'", what, tok ? tok : "EOF");
+}
+
+static bool
+xg_accept(const char *what)
+{
+    const char *tok = xg_next();
+
+    if (tok && !strcmp(tok, what))
+        return true;
+
+    if (tok)
+        xg_unget();
+
+    return false;
+}
+
+static xg_def_t *
+xg_lookup(const char *name)
+{
+    int i;
+
+    for (i = 0; i < defc; ++i) {
+        if (defv[i].x_kind != XG_CONST && defv[i].x_kind != XG_PROGRAM &&
+            !strcmp(defv[i].x_name, name))
+            return defv + i;
+    }
+
+    return NULL;
+}
+
+static xg_def_t *
+xg_define(xg_kind_t kind, char *name)
+{
+    xg_def_t *def;
+
+    if (kind != XG_CONST && kind != XG_PROGRAM && xg_lookup(name))
+        xg_err("%s redefined", name);
+
+    defv = xg_grow(defv, defc, sizeof(*defv));
+    def = defv + defc++;
+    def->x_kind = kind;
+    def->x_name = name;
+
+    return def;
+}
+
+/* Parse a type specifier, returning its canonical name.
+ */
+static char *
+xg_typespec(void)
+{
+    const char *tok = xg_next();
+
+    if (!tok)
+        xg_err("expected a type near EOF");
+
+    if (!strcmp(tok, "unsigned")) {
+        if (xg_accept("int"))
+            return xg_strdup("u_int");
+        if (xg_accept("hyper"))
+            return xg_strdup("u_hyper");
+        return xg_strdup("u_int");
+    }
+
+    if (!strcmp(tok, "struct") || !strcmp(tok, "union") || !strcmp(tok, "enum"))
+        return xg_ident();
+
+    if (!strcmp(tok, "float") || !strcmp(tok, "double") || !strcmp(tok, "quadruple"))
+        xg_err("type %s is not supported", tok);
+
+    xg_unget();
+
+    return xg_ident();
+}
+
+static void
+xg_decl(xg_decl_t *decl)
+{
+    const char *tok;
+
+    memset(decl, 0, sizeof(*decl));
+
+    if (xg_accept("void")) {
+        decl->d_how = XG_VOID;
+        return;
+    }
+
+    decl->d_type = xg_typespec();
+    decl->d_how = XG_PLAIN;
+
+    if (xg_accept("*"))
+        decl->d_how = XG_OPT;
+
+    decl->d_name = xg_ident();
+
+    if (decl->d_how == XG_OPT)
+        return;
+
+    tok = xg_next();
+    if (tok && !strcmp(tok, "[")) {
+        decl->d_how = XG_FIXED;
+        decl->d_size = xg_value();
+        xg_expect("]");
+    }
+    else if (tok && !strcmp(tok, "<")) {
+        decl->d_how = XG_VAR;
+        if (!xg_accept(">")) {
+            decl->d_size = xg_value();
+            xg_expect(">");
+        }
+    }
+    else if (tok) {
+        xg_unget();
+    }
+
+    if (!strcmp(decl->d_type, "string") && decl->d_how != XG_VAR)
+        xg_err("string %s must be variable-length", decl->d_name);
+
+    if (!strcmp(decl->d_type, "opaque") &&
+        decl->d_how != XG_FIXED && decl->d_how != XG_VAR)
+        xg_err("opaque %s must be an array", decl->d_name);
+}
+
+static void
+xg_parse_enum(void)
+{
+    xg_def_t *def = xg_define(XG_ENUM, xg_ident());
+
+    xg_expect("{");
+
+    do {
+        def->x_namev = xg_grow(def->x_namev, def->x_namec, sizeof(char *));
+        def->x_valv = xg_grow(def->x_valv, def->x_namec, sizeof(char *));
+        def->x_namev[def->x_namec] = xg_ident();
+        xg_expect("=");
+        def->x_valv[def->x_namec++] = xg_value();
+    } while (xg_accept(","));
+
+    xg_expect("}");
+    xg_expect(";");
+}
+
+static void
+xg_parse_struct(void)
+{
+    xg_def_t *def = xg_define(XG_STRUCT, xg_ident());
+
+    xg_expect("{");
+
+    do {
+        def->x_declv = xg_grow(def->x_declv, def->x_declc, sizeof(xg_decl_t));
+        xg_decl(def->x_declv + def->x_declc);
+        if (def->x_declv[def->x_declc].d_how == XG_VOID)
+            xg_err("void member in struct %s", def->x_name);
+        ++def->x_declc;
+        xg_expect(";");
+    } while (!xg_accept("}"));
+
+    xg_expect(";");
+}
+
+static void
+xg_parse_union(void)
+{
+    xg_def_t *def = xg_define(XG_UNION, xg_ident());
+    xg_arm_t *arm;
+
+    xg_expect("switch");
+    xg_expect("(");
+    def->x_declv = xg_grow(NULL, 0, sizeof(xg_decl_t));
+    def->x_declc = 1;
+    xg_decl(def->x_declv);
+    if (def->x_declv->d_how != XG_PLAIN)
+        xg_err("invalid discriminant in union %s", def->x_name);
+    xg_expect(")");
+    xg_expect("{");
+
+    do {
+        def->x_armv = xg_grow(def->x_armv, def->x_armc, sizeof(xg_arm_t));
+        arm = def->x_armv + def->x_armc++;
+
+        if (xg_accept("default")) {
+            xg_expect(":");
+        } else {
+            while (xg_accept("case")) {
+                arm->a_casev = xg_grow(arm->a_casev, arm->a_casec, sizeof(char *));
+                arm->a_casev[arm->a_casec++] = xg_value();
+                xg_expect(":");
+            }
+            if (arm->a_casec == 0)
+                xg_err("expected case or default in union %s", def->x_name);
+        }
+
+        xg_decl(&arm->a_decl);
+        xg_expect(";");
+    } while (!xg_accept("}"));
+
+    xg_expect(";");
+}
+
+static void
+xg_parse_typedef(void)
+{
+    xg_decl_t decl;
+    xg_def_t *def;
+
+    xg_decl(&decl);
+    if (decl.d_how == XG_VOID)
+        xg_err("void typedef");
+    xg_expect(";");
+
+    def = xg_define(XG_TYPEDEF, decl.d_name);
+    def->x_declv = xg_grow(NULL, 0, sizeof(xg_decl_t));
+    def->x_declv[0] = decl;
+    def->x_declc = 1;
+}
+
+static void
+xg_program_add(xg_def_t *def, char *name, char *value)
+{
+    def->x_namev = xg_grow(def->x_namev, def->x_namec, sizeof(char *));
+    def->x_valv = xg_grow(def->x_valv, def->x_namec, sizeof(char *));
+    def->x_namev[def->x_namec] = name;
+    def->x_valv[def->x_namec++] = value;
+}
+
+/* A program yields the program, version and procedure numbers, the
+ * procedure argument and result types are only checked for syntax.
+ */
+static void
+xg_parse_program(void)
+{
+    xg_def_t *def = xg_define(XG_PROGRAM, xg_ident());
+    int prog, vers;
+
+    xg_program_add(def, def->x_name, NULL);
+    prog = def->x_namec - 1;
+
+    xg_expect("{");
+
+    do {
+        xg_expect("version");
+        xg_program_add(def, xg_ident(), NULL);
+        vers = def->x_namec - 1;
+        xg_expect("{");
+
+        do {
+            free(xg_typespec());
+            xg_program_add(def, xg_ident(), NULL);
+            xg_expect("(");
+            while (!xg_accept(")")) {
+                if (!xg_next())
+                    xg_err("unterminated procedure definition");
+            }
+            xg_expect("=");
+            def->x_valv[def->x_namec - 1] = xg_value();
+            xg_expect(";");
+        } while (!xg_accept("}"));
+
+        xg_expect("=");
+        def->x_valv[vers] = xg_value();
+        xg_expect(";");
+    } while (!xg_accept("}"));
+
+    xg_expect("=");
+    def->x_valv[prog] = xg_value();
+    xg_expect(";");
+}
+
+static void
+xg_parse(void)
+{
+    const char *tok;
+    xg_def_t *def;
+
+    while (( tok = xg_next() )) {
+        if (!strcmp(tok, "const")) {
+            def = xg_define(XG_CONST, xg_ident());
+            xg_expect("=");
+            def->x_value = xg_value();
+            xg_expect(";");
+        }
+        else if (!strcmp(tok, "enum")) {
+            xg_parse_enum();
+        }
+        else if (!strcmp(tok, "struct")) {
+            xg_parse_struct();
+        }
+        else if (!strcmp(tok, "union")) {
+            xg_parse_union();
+        }
+        else if (!strcmp(tok, "typedef")) {
+            xg_parse_typedef();
+        }
+        else if (!strcmp(tok, "program")) {
+            xg_parse_program();
+        }
+        else {
+            xg_err("unexpected '%s'", tok);
+        }
+    }
+}
+
+
+/* Type helpers.
+ */
+static bool
+xg_base(const char *type)
+{
+    return !strcmp(type, "int") || !strcmp(type, "u_int") ||
+        !strcmp(type, "hyper") || !strcmp(type, "u_hyper") ||
+        !strcmp(type, "bool");
+}
+
+static const char *
+xg_ctype(const char *type)
+{
+    if (!strcmp(type, "int"))
+        return "int32_t";
+    if (!strcmp(type, "u_int"))
+        return "uint32_t";
+    if (!strcmp(type, "hyper"))
+        return "int64_t";
+    if (!strcmp(type, "u_hyper"))
+        return "uint64_t";
+    if (!strcmp(type, "bool"))
+        return "int";
+    if (!strcmp(type, "opaque"))
+        return "char";
+    if (!strcmp(type, "string"))
+        return "char";
+
+    if (!xg_lookup(type))
+        xg_err("undefined type %s", type);
+
+    return type;
+}
+
+/* Evaluate a constant (a number, a const, or an enum value).
+ */
+static long
+xg_cval(const char *str)
+{
+    char *end;
+    long val;
+    int i, j;
+
+    if (isdigit((unsigned char)*str) || *str == '-') {
+        errno = 0;
+        val = strtol(str, &end, 0);
+        if (errno || *end)
+            xg_err("invalid number %s", str);
+        return val;
+    }
+
+    if (!strcmp(str, "TRUE"))
+        return 1;
+    if (!strcmp(str, "FALSE"))
+        return 0;
+
+    for (i = 0; i < defc; ++i) {
+        if (defv[i].x_kind == XG_CONST && !strcmp(defv[i].x_name, str))
+            return xg_cval(defv[i].x_value);
+
+        if (defv[i].x_kind == XG_ENUM) {
+            for (j = 0; j < defv[i].x_namec; ++j) {
+                if (!strcmp(defv[i].x_namev[j], str))
+                    return xg_cval(defv[i].x_valv[j]);
+            }
+        }
+    }
+
+    xg_err("undefined constant %s", str);
+
+    return 0;
+}
+
+/* A case label as it appears in the generated code.
+ */
+static const char *
+xg_case(const char *str)
+{
+    xg_cval(str);
+
+    if (!strcmp(str, "TRUE"))
+        return "1";
+    if (!strcmp(str, "FALSE"))
+        return "0";
+
+    return str;
+}
+
+static long xg_ssize_decl(const xg_decl_t *decl);
+
+/* Return the size of the encoding of the given type if static,
+ * otherwise -1.
+ */
+static long
+xg_ssize(const char *type)
+{
+    xg_def_t *def;
+    long sum, sz;
+    int i;
+
+    if (!strcmp(type, "hyper") || !strcmp(type, "u_hyper"))
+        return 8;
+    if (xg_base(type))
+        return 4;
+
+    def = xg_lookup(type);
+    if (!def)
+        xg_err("undefined type %s", type);
+
+    switch (def->x_kind) {
+    case XG_ENUM:
+        return 4;
+
+    case XG_STRUCT:
+        for (sum = i = 0; i < def->x_declc; ++i) {
+            sz = xg_ssize_decl(def->x_declv + i);
+            if (sz < 0)
+                return -1;
+            sum += sz;
+        }
+        return sum;
+
+    case XG_TYPEDEF:
+        return xg_ssize_decl(def->x_declv);
+
+    default:
+        return -1;
+    }
+}
+
+static long
+xg_ssize_decl(const xg_decl_t *decl)
+{
+    long sz;
+
+    switch (decl->d_how) {
+    case XG_VOID:
+        return 0;
+
+    case XG_PLAIN:
+        return xg_ssize(decl->d_type);
+
+    case XG_FIXED:
+        if (!strcmp(decl->d_type, "opaque"))
+            return (xg_cval(decl->d_size) + 3) & ~3l;
+
+        sz = xg_ssize(decl->d_type);
+        return (sz < 0) ? -1 : sz * xg_cval(decl->d_size);
+
+    default:
+        return -1;
+    }
+}
+
+/* Generated code refers to values through "lvalue" expressions, where
+ * "*v" is the object passed to the function being generated.
+ */
+static char *
+xg_member(const char *lv, const char *name, const char *suffix)
+{
+    static char bufv[8][256];
+    static int bufi;
+    char *buf = bufv[bufi++ % 8];
+
+    if (!strcmp(lv, "*v"))
+        snprintf(buf, sizeof(bufv[0]), "v->%s%s", name, suffix);
+    else
+        snprintf(buf, sizeof(bufv[0]), "%s.%s%s", lv, name, suffix);
+
+    return buf;
+}
+
+static char *
+xg_elem(const char *lv, const char *idx)
+{
+    static char bufv[8][256];
+    static int bufi;
+    char *buf = bufv[bufi++ % 8];
+
+    if (lv[0] == '*')
+        snprintf(buf, sizeof(bufv[0]), "(%s)[%s]", lv, idx);
+    else
+        snprintf(buf, sizeof(bufv[0]), "%s[%s]", lv, idx);
+
+    return buf;
+}
+
+static char *
+xg_addr(const char *lv)
+{
+    static char bufv[8][256];
+    static int bufi;
+    char *buf = bufv[bufi++ % 8];
+
+    if (lv[0] == '*')
+        snprintf(buf, sizeof(bufv[0]), "%s", lv + 1);
+    else
+        snprintf(buf, sizeof(bufv[0]), "&%s", lv);
+
+    return buf;
+}
+
+static char *
+xg_upper(const char *name)
+{
+    static char buf[256];
+    size_t i;
+
+    for (i = 0; name[i] && i < sizeof(buf) - 1; ++i)
+        buf[i] = toupper((unsigned char)name[i]);
+    buf[i] = '\000';
+
+    return buf;
+}
+
+static const char *
+xg_bound(const xg_decl_t *decl)
+{
+    return decl->d_size ? decl->d_size : "~0u";
+}
+
+static void
+emit_at(long off)
+{
+    if (off > 0)
+        emit("p + %ld", off);
+    else
+        emit("p");
+}
+
+
+/* Emit code to encode or decode a value of static size at the given
+ * offset from p, which has already been bounds checked.
+ */
+static void emit_static_decl(const xg_decl_t *decl, const char *lv, long off, bool enc);
+
+static void
+emit_static(const char *type, const char *lv, long off, bool enc)
+{
+    xg_def_t *def;
+    long sz;
+    int i;
+
+    sz = xg_ssize(type);
+
+    if (xg_base(type)) {
+        if (enc) {
+            emit("    nct_xdr_st%d(", (int)sz * 8);
+            emit_at(off);
+            emit(", %s);\n", lv);
+        } else {
+            emit("    %s = ", lv);
+            if (!strcmp(type, "int") || !strcmp(type, "hyper") || !strcmp(type, "bool"))
+                emit("(%s)", xg_ctype(type));
+            emit("nct_xdr_ld%d(", (int)sz * 8);
+            emit_at(off);
+            emit(");\n");
+        }
+        return;
+    }
+
+    def = xg_lookup(type);
+
+    switch (def->x_kind) {
+    case XG_ENUM:
+        if (enc) {
+            emit("    nct_xdr_st32(");
+            emit_at(off);
+            emit(", %s);\n", lv);
+        } else {
+            emit("    %s = (%s)nct_xdr_ld32(", lv, type);
+            emit_at(off);
+            emit(");\n");
+        }
+        break;
+
+    case XG_STRUCT:
+        for (i = 0; i < def->x_declc; ++i) {
+            const xg_decl_t *field = def->x_declv + i;
+            char member[256];
+
+            snprintf(member, sizeof(member), "%s", xg_member(lv, field->d_name, ""));
+            emit_static_decl(field, member, off, enc);
+            off += xg_ssize_decl(field);
+        }
+        break;
+
+    case XG_TYPEDEF:
+        emit_static_decl(def->x_declv, lv, off, enc);
+        break;
+
+    default:
+        xg_err("type %s is not static", type);
+    }
+}
+
+static void
+emit_static_decl(const xg_decl_t *decl, const char *lv, long off, bool enc)
+{
+    char idx[32], elem[256];
+    long n, sz, pad;
+    int i;
+
+    switch (decl->d_how) {
+    case XG_PLAIN:
+        emit_static(decl->d_type, lv, off, enc);
+        break;
+
+    case XG_FIXED:
+        n = xg_cval(decl->d_size);
+
+        if (!strcmp(decl->d_type, "opaque")) {
+            pad = ((n + 3) & ~3l) - n;
+            if (enc) {
+                emit("    memcpy(");
+                emit_at(off);
+                emit(", %s, %ld);\n", lv[0] == '*' ? lv + 1 : lv, n);
+                if (pad > 0) {
+                    emit("    memset(");
+                    emit_at(off + n);
+                    emit(", 0, %ld);\n", pad);
+                }
+            } else {
+                emit("    memcpy(%s, ", lv[0] == '*' ? lv + 1 : lv);
+                emit_at(off);
+                emit(", %ld);\n", n);
+            }
+            break;
+        }
+
+        sz = xg_ssize(decl->d_type);
+        if (n > 64)
+            xg_err("fixed array %s is too large to unroll", decl->d_name);
+
+        for (i = 0; i < n; ++i) {
+            snprintf(idx, sizeof(idx), "%d", i);
+            snprintf(elem, sizeof(elem), "%s", xg_elem(lv, idx));
+            emit_static(decl->d_type, elem, off + i * sz, enc);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* Emit code to encode or decode a declaration via the cursor.  This
+ * is used for all variable-size declarations, and for union arms.
+ */
+static void
+emit_decl(const xg_decl_t *decl, const char *lv, bool enc, const char *ind)
+{
+    const char *op = enc ? "encode" : "decode";
+    const char *len, *val;
+
+    switch (decl->d_how) {
+    case XG_VOID:
+        break;
+
+    case XG_PLAIN:
+        emit("%sif (!nct_xdr_%s_%s(xb, %s))\n", ind, op, decl->d_type, xg_addr(lv));
+        emit("%s    return false;\n", ind);
+        break;
+
+    case XG_FIXED:
+        if (!strcmp(decl->d_type, "opaque")) {
+            emit("%sif (!nct_xdr_%s_fixed(xb, %s, %s))\n",
+                 ind, op, lv[0] == '*' ? lv + 1 : lv, decl->d_size);
+            emit("%s    return false;\n", ind);
+            break;
+        }
+
+        emit("%sfor (i = 0; i < %s; ++i) {\n", ind, decl->d_size);
+        emit("%s    if (!nct_xdr_%s_%s(xb, &%s))\n", ind, op, decl->d_type, xg_elem(lv, "i"));
+        emit("%s        return false;\n", ind);
+        emit("%s}\n", ind);
+        break;
+
+    case XG_VAR:
+        if (!strcmp(decl->d_type, "string")) {
+            if (enc)
+                emit("%sif (!nct_xdr_encode_string(xb, %s, %s))\n", ind, lv, xg_bound(decl));
+            else
+                emit("%sif (!nct_xdr_decode_string(xb, %s, %s))\n", ind, xg_addr(lv), xg_bound(decl));
+            emit("%s    return false;\n", ind);
+            break;
+        }
+
+        len = xg_member(lv, decl->d_name, "_len");
+        val = xg_member(lv, decl->d_name, "_val");
+
+        if (!strcmp(decl->d_type, "opaque")) {
+            if (enc)
+                emit("%sif (!nct_xdr_encode_bytes(xb, %s, %s, %s))\n",
+                     ind, len, val, xg_bound(decl));
+            else
+                emit("%sif (!nct_xdr_decode_bytes(xb, &%s, &%s, %s))\n",
+                     ind, len, val, xg_bound(decl));
+            emit("%s    return false;\n", ind);
+            break;
+        }
+
+        if (enc && decl->d_size)
+            emit("%sif (%s > %s || !nct_xdr_encode_u_int(xb, &%s))\n",
+                 ind, len, decl->d_size, len);
+        else if (enc)
+            emit("%sif (!nct_xdr_encode_u_int(xb, &%s))\n", ind, len);
+        else
+            emit("%sif (!nct_xdr_decode_array(xb, &%s, (void **)&%s, sizeof(*%s), %s))\n",
+                 ind, len, val, val, xg_bound(decl));
+        emit("%s    return false;\n", ind);
+        emit("%sfor (i = 0; i < %s; ++i) {\n", ind, len);
+        emit("%s    if (!nct_xdr_%s_%s(xb, &%s[i]))\n", ind, op, decl->d_type, val);
+        emit("%s        return false;\n", ind);
+        emit("%s}\n", ind);
+        break;
+
+    case XG_OPT:
+        if (enc) {
+            emit("%sif (!nct_xdr_encode_pointer(xb, %s))\n", ind, lv);
+            emit("%s    return false;\n", ind);
+        } else {
+            emit("%sif (!nct_xdr_decode_pointer(xb, (void **)%s, sizeof(*%s)))\n",
+                 ind, xg_addr(lv), lv);
+            emit("%s    return false;\n", ind);
+        }
+        emit("%sif (%s && !nct_xdr_%s_%s(xb, %s))\n", ind, lv, op, decl->d_type, lv);
+        emit("%s    return false;\n", ind);
+        break;
+    }
+}
+
+/* Emit code to add the encoded size of a declaration to len.
+ */
+static void
+emit_sizeof_decl(const xg_decl_t *decl, const char *lv, const char *ind)
+{
+    const char *len, *val;
+    long sz;
+
+    sz = xg_ssize_decl(decl);
+    if (sz >= 0) {
+        if (sz > 0)
+            emit("%slen += %ld;\n", ind, sz);
+        return;
+    }
+
+    switch (decl->d_how) {
+    case XG_PLAIN:
+        emit("%slen += nct_xdr_sizeof_%s(%s);\n", ind, decl->d_type, xg_addr(lv));
+        break;
+
+    case XG_FIXED:
+        emit("%sfor (i = 0; i < %s; ++i)\n", ind, decl->d_size);
+        emit("%s    len += nct_xdr_sizeof_%s(&%s);\n", ind, decl->d_type, xg_elem(lv, "i"));
+        break;
+
+    case XG_VAR:
+        if (!strcmp(decl->d_type, "string")) {
+            emit("%slen += 4 + nct_xdr_pad(strlen(%s));\n", ind, lv);
+            break;
+        }
+
+        len = xg_member(lv, decl->d_name, "_len");
+        val = xg_member(lv, decl->d_name, "_val");
+
+        if (!strcmp(decl->d_type, "opaque")) {
+            emit("%slen += 4 + nct_xdr_pad(%s);\n", ind, len);
+            break;
+        }
+
+        sz = xg_ssize(decl->d_type);
+        if (sz >= 0) {
+            emit("%slen += 4 + (size_t)%s * %ld;\n", ind, len, sz);
+            break;
+        }
+
+        emit("%slen += 4;\n", ind);
+        emit("%sfor (i = 0; i < %s; ++i)\n", ind, len);
+        emit("%s    len += nct_xdr_sizeof_%s(&%s[i]);\n", ind, decl->d_type, val);
+        break;
+
+    case XG_OPT:
+        emit("%slen += 4;\n", ind);
+        emit("%sif (%s)\n", ind, lv);
+        emit("%s    len += nct_xdr_sizeof_%s(%s);\n", ind, decl->d_type, lv);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static bool
+xg_needs_index(const xg_decl_t *declv, int declc, bool sizing)
+{
+    int i;
+
+    for (i = 0; i < declc; ++i) {
+        const xg_decl_t *decl = declv + i;
+
+        if (xg_ssize_decl(decl) >= 0)
+            continue;
+
+        if (decl->d_how == XG_FIXED)
+            return true;
+
+        if (decl->d_how == XG_VAR && strcmp(decl->d_type, "opaque") &&
+            strcmp(decl->d_type, "string") &&
+            !(sizing && xg_ssize(decl->d_type) >= 0))
+            return true;
+    }
+
+    return false;
+}
+
+static void
+emit_proto(const char *name, const char *op)
+{
+    if (!strcmp(op, "sizeof"))
+        emit("static inline size_t nct_xdr_sizeof_%s(const %s *v);\n", name, name);
+    else
+        emit("static inline bool nct_xdr_%s_%s(nct_xbuf_t *xb, %s%s *v);\n",
+             op, name, strcmp(op, "encode") ? "" : "const ", name);
+}
+
+static void
+emit_head(const char *name, bool enc)
+{
+    emit("static inline bool\n");
+    emit("nct_xdr_%s_%s(nct_xbuf_t *xb, %s%s *v)\n",
+         enc ? "encode" : "decode", name, enc ? "const " : "", name);
+    emit("{\n");
+}
+
+/* Emit the encoder or decoder of a type with a static size, which
+ * requires only one bounds check.
+ */
+static void
+emit_codec_static(xg_def_t *def, long sz, bool enc)
+{
+    emit_head(def->x_name, enc);
+    emit("    char *p = xb->xb_cur;\n\n");
+    emit("    if (xb->xb_end - p < %ld)\n", sz);
+    emit("        return false;\n\n");
+
+    if (def->x_kind == XG_TYPEDEF)
+        emit_static_decl(def->x_declv, "*v", 0, enc);
+    else
+        emit_static(def->x_name, "*v", 0, enc);
+
+    emit("\n    xb->xb_cur = p + %ld;\n\n", sz);
+    emit("    return true;\n");
+    emit("}\n\n");
+}
+
+/* Emit the encoder or decoder of a struct, where each run of fields
+ * of static size is bounds checked once and accessed at fixed offsets.
+ */
+static void
+emit_codec_struct(xg_def_t *def, bool enc)
+{
+    bool locals;
+    long run, sz;
+    int i, j;
+
+    emit_head(def->x_name, enc);
+
+    locals = xg_needs_index(def->x_declv, def->x_declc, false);
+    if (locals)
+        emit("    u_int i;\n");
+
+    for (i = 0; i < def->x_declc; ++i) {
+        if (xg_ssize_decl(def->x_declv + i) >= 0) {
+            emit("    char *p;\n");
+            locals = true;
+            break;
+        }
+    }
+
+    if (locals)
+        emit("\n");
+
+    for (i = 0; i < def->x_declc; i = j) {
+        const xg_decl_t *decl = def->x_declv + i;
+
+        sz = xg_ssize_decl(decl);
+        if (sz < 0) {
+            emit_decl(decl, xg_member("*v", decl->d_name, ""), enc, "    ");
+            emit("\n");
+            j = i + 1;
+            continue;
+        }
+
+        for (run = 0, j = i; j < def->x_declc; ++j) {
+            sz = xg_ssize_decl(def->x_declv + j);
+            if (sz < 0)
+                break;
+            run += sz;
+        }
+
+        emit("    p = xb->xb_cur;\n");
+        emit("    if (xb->xb_end - p < %ld)\n", run);
+        emit("        return false;\n\n");
+
+        for (run = 0; i < j; ++i) {
+            decl = def->x_declv + i;
+            emit_static_decl(decl, xg_member("*v", decl->d_name, ""), run, enc);
+            run += xg_ssize_decl(decl);
+        }
+
+        emit("    xb->xb_cur = p + %ld;\n\n", run);
+    }
+
+    emit("    return true;\n");
+    emit("}\n\n");
+}
+
+static bool
+xg_has_default(const xg_def_t *def)
+{
+    int i;
+
+    for (i = 0; i < def->x_armc; ++i) {
+        if (def->x_armv[i].a_casec == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void
+emit_cases(const xg_arm_t *arm, int idx)
+{
+    int j;
+
+    if (idx > 0)
+        emit("\n");
+
+    if (arm->a_casec == 0)
+        emit("    default:\n");
+
+    for (j = 0; j < arm->a_casec; ++j)
+        emit("    case %s:\n", xg_case(arm->a_casev[j]));
+}
+
+static void
+emit_codec_union(xg_def_t *def, bool enc)
+{
+    const xg_decl_t *disc = def->x_declv;
+    char lv[256];
+    int i;
+
+    emit_head(def->x_name, enc);
+
+    for (i = 0; i < def->x_armc; ++i) {
+        if (xg_needs_index(&def->x_armv[i].a_decl, 1, false)) {
+            emit("    u_int i;\n\n");
+            break;
+        }
+    }
+
+    emit_decl(disc, xg_member("*v", disc->d_name, ""), enc, "    ");
+    emit("\n    switch (%s) {\n", xg_member("*v", disc->d_name, ""));
+
+    for (i = 0; i < def->x_armc; ++i) {
+        const xg_arm_t *arm = def->x_armv + i;
+
+        emit_cases(arm, i);
+
+        snprintf(lv, sizeof(lv), "v->u.%s", arm->a_decl.d_name);
+
+        if (arm->a_decl.d_how == XG_PLAIN) {
+            emit("        return nct_xdr_%s_%s(xb, &%s);\n",
+                 enc ? "encode" : "decode", arm->a_decl.d_type, lv);
+            continue;
+        }
+
+        emit_decl(&arm->a_decl, lv, enc, "        ");
+        emit("        return true;\n");
+    }
+
+    if (!xg_has_default(def)) {
+        emit("\n    default:\n");
+        emit("        break;\n");
+    }
+
+    emit("    }\n\n");
+    emit("    return false;\n");
+    emit("}\n\n");
+}
+
+static void
+emit_codec_typedef(xg_def_t *def, bool enc)
+{
+    emit_head(def->x_name, enc);
+
+    if (xg_needs_index(def->x_declv, 1, false))
+        emit("    u_int i;\n\n");
+
+    emit_decl(def->x_declv, "*v", enc, "    ");
+    emit("\n    return true;\n");
+    emit("}\n\n");
+}
+
+static void
+emit_sizeof(xg_def_t *def)
+{
+    char lv[256];
+    long sz;
+    int i;
+
+    emit("static inline size_t\n");
+    emit("nct_xdr_sizeof_%s(const %s *v)\n", def->x_name, def->x_name);
+    emit("{\n");
+
+    sz = xg_ssize(def->x_name);
+    if (sz >= 0) {
+        emit("    return %ld;\n", sz);
+        emit("}\n\n");
+        return;
+    }
+
+    switch (def->x_kind) {
+    case XG_STRUCT:
+        if (xg_needs_index(def->x_declv, def->x_declc, true))
+            emit("    u_int i;\n");
+        emit("    size_t len = 0;\n\n");
+
+        for (sz = i = 0; i < def->x_declc; ++i) {
+            const xg_decl_t *decl = def->x_declv + i;
+            long dsz = xg_ssize_decl(decl);
+
+            if (dsz >= 0)
+                sz += dsz;
+            else
+                emit_sizeof_decl(decl, xg_member("*v", decl->d_name, ""), "    ");
+        }
+        if (sz > 0)
+            emit("    len += %ld;\n", sz);
+        break;
+
+    case XG_TYPEDEF:
+        if (xg_needs_index(def->x_declv, 1, true))
+            emit("    u_int i;\n");
+        emit("    size_t len = 0;\n\n");
+        emit_sizeof_decl(def->x_declv, "*v", "    ");
+        break;
+
+    case XG_UNION:
+        for (i = 0; i < def->x_armc; ++i) {
+            if (xg_needs_index(&def->x_armv[i].a_decl, 1, true)) {
+                emit("    u_int i;\n");
+                break;
+            }
+        }
+        emit("    size_t len = %ld;\n\n", xg_ssize_decl(def->x_declv));
+        emit("    switch (%s) {\n", xg_member("*v", def->x_declv->d_name, ""));
+
+        for (i = 0; i < def->x_armc; ++i) {
+            const xg_arm_t *arm = def->x_armv + i;
+
+            emit_cases(arm, i);
+
+            if (arm->a_decl.d_how != XG_VOID) {
+                snprintf(lv, sizeof(lv), "v->u.%s", arm->a_decl.d_name);
+                emit_sizeof_decl(&arm->a_decl, lv, "        ");
+            }
+            emit("        break;\n");
+        }
+
+        if (!xg_has_default(def)) {
+            emit("\n    default:\n");
+            emit("        break;\n");
+        }
+
+        emit("    }\n");
+        break;
+
+    default:
+        break;
+    }
+
+    emit("\n    return len;\n");
+    emit("}\n\n");
+}
+
+
+/* Type definitions.
+ */
+static void
+emit_cdecl(const xg_decl_t *decl, const char *ind)
+{
+    switch (decl->d_how) {
+    case XG_VOID:
+        break;
+
+    case XG_PLAIN:
+        emit("%s%s %s;\n", ind, xg_ctype(decl->d_type), decl->d_name);
+        break;
+
+    case XG_FIXED:
+        emit("%s%s %s[%s];\n", ind, xg_ctype(decl->d_type), decl->d_name, decl->d_size);
+        break;
+
+    case XG_VAR:
+        if (!strcmp(decl->d_type, "string")) {
+            emit("%schar *%s;\n", ind, decl->d_name);
+            break;
+        }
+        emit("%sstruct {\n", ind);
+        emit("%s    u_int %s_len;\n", ind, decl->d_name);
+        emit("%s    %s *%s_val;\n", ind, xg_ctype(decl->d_type), decl->d_name);
+        emit("%s} %s;\n", ind, decl->d_name);
+        break;
+
+    case XG_OPT:
+        emit("%s%s *%s;\n", ind, xg_ctype(decl->d_type), decl->d_name);
+        break;
+    }
+}
+
+static void
+emit_types(void)
+{
+    xg_def_t *def;
+    int i, j;
+
+    for (i = 0; i < defc; ++i) {
+        def = defv + i;
+
+        switch (def->x_kind) {
+        case XG_CONST:
+            emit("#define %s (%s)\n", def->x_name, def->x_value);
+            if (i + 1 < defc && defv[i + 1].x_kind != XG_CONST)
+                emit("\n");
+            break;
+
+        case XG_PROGRAM:
+            for (j = 0; j < def->x_namec; ++j)
+                emit("#define %s (%s)\n", def->x_namev[j], def->x_valv[j]);
+            emit("\n");
+            break;
+
+        case XG_ENUM:
+            emit("enum %s {\n", def->x_name);
+            for (j = 0; j < def->x_namec; ++j)
+                emit("    %s = %s,\n", def->x_namev[j], def->x_valv[j]);
+            emit("};\n\n");
+            emit("typedef enum %s %s;\n\n", def->x_name, def->x_name);
+            break;
+
+        case XG_STRUCT:
+            emit("struct %s {\n", def->x_name);
+            for (j = 0; j < def->x_declc; ++j)
+                emit_cdecl(def->x_declv + j, "    ");
+            emit("};\n\n");
+            break;
+
+        case XG_UNION:
+            emit("struct %s {\n", def->x_name);
+            emit_cdecl(def->x_declv, "    ");
+            emit("    union {\n");
+            for (j = 0; j < def->x_armc; ++j)
+                emit_cdecl(&def->x_armv[j].a_decl, "        ");
+            emit("    } u;\n");
+            emit("};\n\n");
+            break;
+
+        case XG_TYPEDEF:
+            emit("typedef ");
+            emit_cdecl(def->x_declv, "");
+            emit("\n");
+            break;
+        }
+    }
+}
+
+static const char *prelude[] = {
+    "/* A buffer cursor.  Decoded strings, arrays and optional data are",
+    " * allocated from the heap (if any), which need not be freed.",
+    " */",
+    "typedef struct {",
+    "    char   *xb_base;",
+    "    char   *xb_cur;",
+    "    char   *xb_end;",
+    "    char   *xb_heap;",
+    "    char   *xb_heapend;",
+    "} nct_xbuf_t;",
+    "",
+    "static inline void",
+    "nct_xbuf_init(nct_xbuf_t *xb, void *buf, size_t len, void *heap, size_t heapsz)",
+    "{",
+    "    xb->xb_base = xb->xb_cur = buf;",
+    "    xb->xb_end = xb->xb_base + len;",
+    "    xb->xb_heap = heap;",
+    "    xb->xb_heapend = (char *)heap + heapsz;",
+    "}",
+    "",
+    "static inline size_t",
+    "nct_xbuf_len(const nct_xbuf_t *xb)",
+    "{",
+    "    return xb->xb_cur - xb->xb_base;",
+    "}",
+    "",
+    "static inline void *",
+    "nct_xbuf_alloc(nct_xbuf_t *xb, size_t len)",
+    "{",
+    "    char *ptr = xb->xb_heap;",
+    "",
+    "    len = (len + 7) & ~(size_t)7;",
+    "    if (!ptr || (size_t)(xb->xb_heapend - ptr) < len)",
+    "        return NULL;",
+    "",
+    "    xb->xb_heap += len;",
+    "",
+    "    return ptr;",
+    "}",
+    "",
+    "static inline size_t",
+    "nct_xdr_pad(size_t len)",
+    "{",
+    "    return (len + 3) & ~(size_t)3;",
+    "}",
+    "",
+    "static inline uint32_t",
+    "nct_xdr_ld32(const char *p)",
+    "{",
+    "    uint32_t val;",
+    "",
+    "    memcpy(&val, p, sizeof(val));",
+    "",
+    "    return ntohl(val);",
+    "}",
+    "",
+    "static inline uint64_t",
+    "nct_xdr_ld64(const char *p)",
+    "{",
+    "    return ((uint64_t)nct_xdr_ld32(p) << 32) | nct_xdr_ld32(p + 4);",
+    "}",
+    "",
+    "static inline void",
+    "nct_xdr_st32(char *p, uint32_t val)",
+    "{",
+    "    val = htonl(val);",
+    "    memcpy(p, &val, sizeof(val));",
+    "}",
+    "",
+    "static inline void",
+    "nct_xdr_st64(char *p, uint64_t val)",
+    "{",
+    "    nct_xdr_st32(p, val >> 32);",
+    "    nct_xdr_st32(p + 4, val & 0xffffffffu);",
+    "}",
+    "",
+    "#define NCT_XDR_BASE(_name, _type, _bits)                               \\",
+    "static inline bool                                                      \\",
+    "nct_xdr_encode_##_name(nct_xbuf_t *xb, const _type *v)                  \\",
+    "{                                                                       \\",
+    "    if (xb->xb_end - xb->xb_cur < (_bits) / 8)                          \\",
+    "        return false;                                                   \\",
+    "    nct_xdr_st##_bits(xb->xb_cur, *v);                                  \\",
+    "    xb->xb_cur += (_bits) / 8;                                          \\",
+    "    return true;                                                        \\",
+    "}                                                                       \\",
+    "                                                                        \\",
+    "static inline bool                                                      \\",
+    "nct_xdr_decode_##_name(nct_xbuf_t *xb, _type *v)                        \\",
+    "{                                                                       \\",
+    "    if (xb->xb_end - xb->xb_cur < (_bits) / 8)                          \\",
+    "        return false;                                                   \\",
+    "    *v = (_type)nct_xdr_ld##_bits(xb->xb_cur);                          \\",
+    "    xb->xb_cur += (_bits) / 8;                                          \\",
+    "    return true;                                                        \\",
+    "}                                                                       \\",
+    "                                                                        \\",
+    "static inline size_t                                                    \\",
+    "nct_xdr_sizeof_##_name(const _type *v)                                  \\",
+    "{                                                                       \\",
+    "    return (_bits) / 8;                                                 \\",
+    "}",
+    "",
+    "NCT_XDR_BASE(int, int32_t, 32)",
+    "NCT_XDR_BASE(u_int, uint32_t, 32)",
+    "NCT_XDR_BASE(hyper, int64_t, 64)",
+    "NCT_XDR_BASE(u_hyper, uint64_t, 64)",
+    "NCT_XDR_BASE(bool, int, 32)",
+    "",
+    "static inline bool",
+    "nct_xdr_encode_fixed(nct_xbuf_t *xb, const char *val, u_int len)",
+    "{",
+    "    size_t padded = nct_xdr_pad(len);",
+    "",
+    "    if ((size_t)(xb->xb_end - xb->xb_cur) < padded)",
+    "        return false;",
+    "",
+    "    memcpy(xb->xb_cur, val, len);",
+    "    memset(xb->xb_cur + len, 0, padded - len);",
+    "    xb->xb_cur += padded;",
+    "",
+    "    return true;",
+    "}",
+    "",
+    "static inline bool",
+    "nct_xdr_decode_fixed(nct_xbuf_t *xb, char *val, u_int len)",
+    "{",
+    "    size_t padded = nct_xdr_pad(len);",
+    "",
+    "    if ((size_t)(xb->xb_end - xb->xb_cur) < padded)",
+    "        return false;",
+    "",
+    "    memcpy(val, xb->xb_cur, len);",
+    "    xb->xb_cur += padded;",
+    "",
+    "    return true;",
+    "}",
+    "",
+    "static inline bool",
+    "nct_xdr_encode_bytes(nct_xbuf_t *xb, u_int len, const char *val, u_int max)",
+    "{",
+    "    if (len > max || !nct_xdr_encode_u_int(xb, &len))",
+    "        return false;",
+    "",
+    "    return nct_xdr_encode_fixed(xb, val, len);",
+    "}",
+    "",
+    "/* Variable-length opaque data is decoded in place, i.e., *valp",
+    " * refers to the data in the buffer.",
+    " */",
+    "static inline bool",
+    "nct_xdr_decode_bytes(nct_xbuf_t *xb, u_int *lenp, char **valp, u_int max)",
+    "{",
+    "    if (!nct_xdr_decode_u_int(xb, lenp) || *lenp > max)",
+    "        return false;",
+    "",
+    "    if ((size_t)(xb->xb_end - xb->xb_cur) < nct_xdr_pad(*lenp))",
+    "        return false;",
+    "",
+    "    *valp = xb->xb_cur;",
+    "    xb->xb_cur += nct_xdr_pad(*lenp);",
+    "",
+    "    return true;",
+    "}",
+    "",
+    "static inline bool",
+    "nct_xdr_encode_string(nct_xbuf_t *xb, const char *str, u_int max)",
+    "{",
+    "    return nct_xdr_encode_bytes(xb, str ? strlen(str) : 0, str, max);",
+    "}",
+    "",
+    "static inline bool",
+    "nct_xdr_decode_string(nct_xbuf_t *xb, char **strp, u_int max)",
+    "{",
+    "    char *val;",
+    "    u_int len;",
+    "",
+    "    if (!nct_xdr_decode_bytes(xb, &len, &val, max))",
+    "        return false;",
+    "",
+    "    *strp = nct_xbuf_alloc(xb, len + 1);",
+    "    if (!*strp)",
+    "        return false;",
+    "",
+    "    memcpy(*strp, val, len);",
+    "    (*strp)[len] = '\\000';",
+    "",
+    "    return true;",
+    "}",
+    "",
+    "static inline bool",
+    "nct_xdr_decode_array(nct_xbuf_t *xb, u_int *lenp, void **valp, size_t elmsz, u_int max)",
+    "{",
+    "    if (!nct_xdr_decode_u_int(xb, lenp) || *lenp > max)",
+    "        return false;",
+    "",
+    "    /* Each element takes at least one XDR unit.",
+    "     */",
+    "    if ((size_t)(xb->xb_end - xb->xb_cur) / 4 < *lenp)",
+    "        return false;",
+    "",
+    "    *valp = nct_xbuf_alloc(xb, *lenp * elmsz);",
+    "",
+    "    return *valp || *lenp == 0;",
+    "}",
+    "",
+    "static inline bool",
+    "nct_xdr_encode_pointer(nct_xbuf_t *xb, const void *ptr)",
+    "{",
+    "    int follows = (ptr != NULL);",
+    "",
+    "    return nct_xdr_encode_bool(xb, &follows);",
+    "}",
+    "",
+    "static inline bool",
+    "nct_xdr_decode_pointer(nct_xbuf_t *xb, void **ptrp, size_t size)",
+    "{",
+    "    int follows;",
+    "",
+    "    if (!nct_xdr_decode_bool(xb, &follows))",
+    "        return false;",
+    "",
+    "    *ptrp = NULL;",
+    "    if (follows) {",
+    "        *ptrp = nct_xbuf_alloc(xb, size);",
+    "        if (!*ptrp)",
+    "            return false;",
+    "    }",
+    "",
+    "    return true;",
+    "}",
+    NULL
+};
+
+static void
+emit_codecs(void)
+{
+    xg_def_t *def;
+    long sz;
+    int i;
+
+    for (i = 0; prelude[i]; ++i)
+        emit("%s\n", prelude[i]);
+    emit("\n");
+
+    for (i = 0; i < defc; ++i) {
+        def = defv + i;
+        if (def->x_kind == XG_CONST || def->x_kind == XG_PROGRAM)
+            continue;
+
+        emit_proto(def->x_name, "encode");
+        emit_proto(def->x_name, "decode");
+        emit_proto(def->x_name, "sizeof");
+    }
+    emit("\n");
+
+    for (i = 0; i < defc; ++i) {
+        def = defv + i;
+        if (def->x_kind == XG_CONST || def->x_kind == XG_PROGRAM)
+            continue;
+
+        emit("/* %s\n */\n", def->x_name);
+
+        sz = xg_ssize(def->x_name);
+        if (sz >= 0) {
+            emit("#define NCT_XDR_%s_SIZE (%ld)\n\n", xg_upper(def->x_name), sz);
+            emit_codec_static(def, sz, true);
+            emit_codec_static(def, sz, false);
+        }
+        else if (def->x_kind == XG_STRUCT) {
+            emit_codec_struct(def, true);
+            emit_codec_struct(def, false);
+        }
+        else if (def->x_kind == XG_UNION) {
+            emit_codec_union(def, true);
+            emit_codec_union(def, false);
+        }
+        else {
+            emit_codec_typedef(def, true);
+            emit_codec_typedef(def, false);
+        }
+
+        emit_sizeof(def);
+    }
+}
+
+static void
+emit_forward(void)
+{
+    int i;
+
+    for (i = 0; i < defc; ++i) {
+        if (defv[i].x_kind == XG_STRUCT || defv[i].x_kind == XG_UNION)
+            emit("typedef struct %s %s;\n", defv[i].x_name, defv[i].x_name);
+    }
+    emit("\n");
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "usage: %s [-o output] spec.x\n", progname);
+    exit(EX_USAGE);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *outpath = NULL;
+    char guard[256];
+    const char *base;
+    size_t len, i;
+    FILE *fp;
+    int c;
+
+    progname = strrchr(argv[0], '/');
+    progname = progname ? progname + 1 : argv[0];
+
+    while ((c = getopt(argc, argv, "o:")) != -1) {
+        switch (c) {
+        case 'o':
+            outpath = optarg;
+            break;
+
+        default:
+            usage();
+        }
+    }
+
+    if (argc - optind != 1)
+        usage();
+
+    specpath = argv[optind];
+
+    fp = fopen(specpath, "r");
+    if (!fp) {
+        fprintf(stderr, "%s: fopen(%s) failed: %s\n", progname, specpath, strerror(errno));
+        exit(EX_NOINPUT);
+    }
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+
+    text = malloc(len + 1);
+    if (!text || fread(text, 1, len, fp) != len) {
+        fprintf(stderr, "%s: unable to read %s\n", progname, specpath);
+        exit(EX_IOERR);
+    }
+    text[len] = '\000';
+    textp = text;
+    fclose(fp);
+
+    xg_parse();
+
+    out = stdout;
+    if (outpath) {
+        out = fopen(outpath, "w");
+        if (!out) {
+            fprintf(stderr, "%s: fopen(%s) failed: %s\n", progname, outpath, strerror(errno));
+            exit(EX_CANTCREAT);
+        }
+    }
+
+    base = strrchr(outpath ? outpath : specpath, '/');
+    base = base ? base + 1 : (outpath ? outpath : specpath);
+
+    for (i = 0; base[i] && i < sizeof(guard) - 1; ++i)
+        guard[i] = isalnum((unsigned char)base[i]) ? toupper((unsigned char)base[i]) : '_';
+    guard[i] = '\000';
+
+    emit("/* Generated by %s from %s, do not edit.\n */\n", progname, specpath);
+    emit("#ifndef %s\n", guard);
+    emit("#define %s\n\n", guard);
+
+    emit("#include <stdbool.h>\n");
+    emit("#include <stddef.h>\n");
+    emit("#include <stdint.h>\n");
+    emit("#include <string.h>\n");
+    emit("#include <sys/types.h>\n");
+    emit("#include <arpa/inet.h>\n\n");
+
+    emit_forward();
+    emit_types();
+    emit_codecs();
+
+    emit("#endif /* %s */\n", guard);
+
+    if (fflush(out) || (out != stdout && fclose(out))) {
+        fprintf(stderr, "%s: write failed: %s\n", progname, strerror(errno));
+        exit(EX_IOERR);
+    }
+
+    return 0;
+}